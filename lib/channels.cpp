@@ -47,9 +47,9 @@ void Channel::set_max_pulse_rate(float max_pulses_per_sec){
   // sets the maximum pulse rate permissible on a channel.
   const float tick_time_seconds = (float) CORE_FRAME_PERIOD_US / 1000000.0; //seconds per tick
   float pulses_per_tick = max_pulses_per_sec * tick_time_seconds; //steps per tick
-  if(pulses_per_tick>1.0){
-    //cap the velocity at 1 step per tick
-    pulses_per_tick = 1.0;
+  if(pulses_per_tick>OUTPUT_DRIVER_MAX_STEPS_PER_FRAME){
+    //cap the velocity at the most steps that any output port can make per tick. Run() applies the limit of the actual port.
+    pulses_per_tick = OUTPUT_DRIVER_MAX_STEPS_PER_FRAME;
   }
   accumulator_velocity = (float)((float)ACCUMULATOR_THRESHOLD * pulses_per_tick);
 }
@@ -158,8 +158,14 @@ void Channel::run(){
 
     // 1. Increment the accumulator. This is used to determine if generating a pulse
     //    signal would exceed the maximum pulse frequency on the channel. 
-    if(accumulator < 2*ACCUMULATOR_THRESHOLD){ //only bother incrementing if meaningful (avoids overruns)
-      accumulator += accumulator_velocity;
+    //    Ports in the stepdance format take one step per frame, while driver ports can take several.
+    uint8_t max_pulses_per_frame = target_output_port->read_max_steps_per_frame();
+    if(accumulator < 2*ACCUMULATOR_THRESHOLD*max_pulses_per_frame){ //only bother incrementing if meaningful (avoids overruns)
+      float accumulator_increment = accumulator_velocity;
+      if(accumulator_increment > ACCUMULATOR_THRESHOLD*max_pulses_per_frame){
+        accumulator_increment = ACCUMULATOR_THRESHOLD*max_pulses_per_frame;
+      }
+      accumulator += accumulator_increment;
     }
     
 
@@ -184,8 +190,11 @@ void Channel::run(){
       direction = last_direction;
     }
 
-    // 4. Try to close pulse distance
-    if(delta_position > 0.5 || delta_position < -0.5){
+    // 4. Try to close pulse distance, taking up to max_pulses_per_frame pulses
+    for(uint8_t pulse_count = 0; pulse_count < max_pulses_per_frame; pulse_count ++){
+      if(!(delta_position > 0.5 || delta_position < -0.5)){
+        break;
+      }
 
       // calculate active accumulator threshold. This catches the case where we reverse direction.
       float accumulator_active_threshold;
@@ -196,9 +205,19 @@ void Channel::run(){
       }
 
       // check if we're taking a pulse
-      if(accumulator >= accumulator_active_threshold){
-        pulse(direction);
+      if(accumulator < accumulator_active_threshold){
+        break;
+      }
+      pulse(direction);
+      if(max_pulses_per_frame == 1){
         accumulator = 0;
+      }else{
+        accumulator -= accumulator_active_threshold; // keep the remainder, so pulses stay evenly spread across frames
+      }
+      if(direction == DIRECTION_FORWARD){
+        delta_position -= 1;
+      }else{
+        delta_position += 1;
       }
     }
   }
@@ -76,6 +76,8 @@ class Channel : public Plugin{
     void begin(OutputPort* target_output_port, uint8_t output_signal);
       /**
    * @brief Sets the maxium allowable pulse rate for the channel.
+   * Channels on a port in the stepdance format are limited to one pulse per frame. Ports in OUTPUT_FORMAT_DRIVER
+   * can take several pulses per frame, so raise this limit to make use of them.
    * @param max_pulses_per_sec Maximum allowable pulse rate in pulses per second.
    */
     void set_max_pulse_rate(float max_pulses_per_sec); 
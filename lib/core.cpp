@@ -34,8 +34,11 @@ void add_function_to_frame(frame_function_pointer target_function){
   } // NOTE: should add a return value if it works
 }
 
+static volatile uint32_t stepdance_frame_count = 0; //incremented at the start of every frame
+
 void on_frame(){
   stepdance_interrupt_entry_cycle_count = ARM_DWT_CYCCNT;
+  stepdance_frame_count ++;
   for(uint8_t function_index = 0; function_index<num_registered_frame_functions; function_index++){
     frame_functions[function_index]();
   }
@@ -50,6 +53,8 @@ void on_frame(){
 // -- OVERALL SYSTEM --
 
 void dance_start(){
+  // release frames held in output port lookahead rings. This runs first so that transmit timing doesn't depend on plugins.
+  add_function_to_frame(release_frames_on_all_output_ports);
   // activate input port plugins
   add_function_to_frame(Plugin::run_input_port_frame_plugins);
   // activate all pre-channel frame plugins
@@ -74,6 +79,10 @@ float stepdance_get_cpu_usage(){
   return stepdance_max_cpu_usage;
 }
 
+uint32_t stepdance_get_frame_count(){
+  return stepdance_frame_count;
+}
+
 void stepdance_metrics_reset(){
   stepdance_max_cpu_usage = 0;
 }
@@ -93,6 +102,7 @@ uint8_t Plugin::num_registered_kilohertz_plugins = 0;
 Plugin* Plugin::registered_kilohertz_plugins[MAX_NUM_KILOHERTZ_PLUGINS];
 
 uint8_t Plugin::num_registered_loop_plugins = 0;
+bool Plugin::read_deep_warnings = true;
 Plugin* Plugin::registered_loop_plugins[MAX_NUM_LOOP_PLUGINS];
 
 void Plugin::register_plugin(){ //default to pre-channel frame plugin
@@ -197,7 +207,9 @@ void Plugin::push_deep(){};
 void Plugin::pull_deep(){};
 DecimalPosition Plugin::read_deep(BlockPort& in_blockport){
   // By default (if unimplemented) return the value of the input blockport
-  Serial.println("WARNING: this method is unimplemented for a plugin you're calling read_deep through, this is likely to give unexpected results.");
+  if(read_deep_warnings){
+    Serial.println("WARNING: this method is unimplemented for a plugin you're calling read_deep through, this is likely to give unexpected results.");
+  }
   return in_blockport.read_absolute();
 };
 
@@ -415,6 +427,22 @@ DecimalPosition BlockPort::read_deep(){
       return read(ABSOLUTE);
     }
 
+DecimalPosition BlockPort::read_deep_quiet(){
+  // A plugin along the chain that doesn't implement read_deep() is read at its input, as by read_deep(), but without the
+  // warning. Reading through an output, the result is converted from the block units of whatever the output is mapped to
+  // into world units, which are the units the output pushes in.
+  bool warnings = Plugin::read_deep_warnings;
+  Plugin::read_deep_warnings = false;
+  DecimalPosition read_value;
+  if((blockport_direction == BLOCKPORT_OUTPUT) && (target_BlockPort != nullptr)){
+    read_value = target_BlockPort->convert_block_to_world_units(target_BlockPort->read_deep());
+  }else{
+    read_value = read_deep();
+  }
+  Plugin::read_deep_warnings = warnings;
+  return read_value;
+}
+
 
 void BlockPort::enable(){
   push_pull_enabled = true;
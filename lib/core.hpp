@@ -77,6 +77,7 @@ void dance_start();
 
 void stepdance_metrics_reset(); //resets the CPU usage metrics
 float stepdance_get_cpu_usage(); //returns a value from 0-1 indicating the maximum CPU usage.
+uint32_t stepdance_get_frame_count(); //returns the number of frames run since dance_start(). Wraps after ~48 hours.
 static volatile float stepdance_max_cpu_usage = 0; //stores a running count of the maximum CPU usage, in the range 0-1;
 static volatile uint32_t stepdance_interrupt_entry_cycle_count = 0; //stores the entry value of ARM_DWT_CYCCNT
 
@@ -111,6 +112,7 @@ class Plugin{
     virtual void push_deep(); //deep push across the plugin (e.g. from input to output blockports) for state sync.
     virtual void pull_deep(); //performs a deep pull across the plugin (e.g. from output to input blockports) for state sync
     virtual DecimalPosition read_deep(BlockPort& in_blockport); //performs a deep read across the plugin (e.g. from output to input blockports) for state sync
+    static bool read_deep_warnings; //false while BlockPort::read_deep_quiet() runs, so plugins without read_deep() don't print a warning
 
   private:
     static Plugin* registered_input_port_frame_plugins[MAX_NUM_INPUT_PORT_FRAME_PLUGINS]; //stores all registered input port plugins
@@ -240,6 +242,7 @@ class BlockPort{
     }
     
     DecimalPosition read_deep();
+    DecimalPosition read_deep_quiet(); //as read_deep(), but without warnings, and through an output in world units. For positions that are polled, e.g. status reports.
 
     void enable(); // enables push/pull on blockport
     void disable(); // disables push/pull
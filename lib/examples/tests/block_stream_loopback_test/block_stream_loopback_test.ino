@@ -0,0 +1,177 @@
+/*
+Block Stream Loopback Test
+
+Plays the host side of the block stream protocol into a BlockStreamInterface through an in-memory stream, and checks
+each reply. The exchange covers a sequence reset, good frames, a frame corrupted in transit, a frame that arrives out
+of sequence as a result, the resend that recovers from both, and a malformed block. Once the queued moves have run,
+the X output should have moved by exactly the sum of the blocks that were accepted.
+
+Results are printed to the serial port about a second after startup.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_driver   // tells compiler we're using the Stepdance Driver Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+// Bytes written by the test are read by the interface, and bytes written by the interface are kept for the test to decode.
+class LoopbackStream : public Stream{
+  public:
+    int available(){
+      return to_device_length - to_device_index;
+    }
+    int read(){
+      return (to_device_index < to_device_length) ? to_device_buffer[to_device_index++] : -1;
+    }
+    int peek(){
+      return (to_device_index < to_device_length) ? to_device_buffer[to_device_index] : -1;
+    }
+    size_t write(uint8_t character){
+      if(to_host_length < sizeof(to_host_buffer)){
+        to_host_buffer[to_host_length++] = character;
+      }
+      return 1;
+    }
+    void send_to_device(const uint8_t* data, uint16_t length){
+      memcpy(to_device_buffer, data, length);
+      to_device_length = length;
+      to_device_index = 0;
+      to_host_length = 0;
+    }
+    uint8_t to_host_buffer[64];
+    uint16_t to_host_length = 0;
+  private:
+    uint8_t to_device_buffer[BSI_HEADER_SIZE + BSI_MAX_PAYLOAD_SIZE + BSI_CRC_SIZE];
+    uint16_t to_device_length = 0;
+    uint16_t to_device_index = 0;
+};
+
+LoopbackStream loopback;
+BlockStreamInterface block_stream;
+
+const uint8_t BLOCKS_PER_FRAME = 4;
+const float32_t BLOCK_X_MM = 0.5;
+const float32_t BLOCK_TIME_S = 0.01;
+
+uint8_t frame[BSI_HEADER_SIZE + BSI_MAX_PAYLOAD_SIZE + BSI_CRC_SIZE];
+uint16_t frame_length;
+uint8_t num_failures = 0;
+
+void setup() {
+  block_stream.begin(&loopback);
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+bool report_complete = false;
+
+void loop() {
+  if(!report_complete && millis() > 1000){
+    report_complete = true;
+    run_test();
+  }
+  dance_loop(); // Stepdance loop
+}
+
+void run_test(){
+  uint8_t reset_frame[BSI_HEADER_SIZE + BSI_CRC_SIZE];
+  uint16_t reset_length = BlockStreamInterface::encode_frame(reset_frame, BSI_FRAME_RESET, 10, nullptr, 0);
+  exchange(reset_frame, reset_length);
+  expect_reply("reset", BSI_FRAME_STATUS, 11);
+
+  encode_x_blocks(11);
+  exchange(frame, frame_length);
+  expect_reply("first frame", BSI_FRAME_STATUS, 12);
+
+  encode_x_blocks(12);
+  uint8_t corrupted_frame[sizeof(frame)];
+  memcpy(corrupted_frame, frame, frame_length);
+  corrupted_frame[BSI_HEADER_SIZE + 3] ^= 0x40;
+  exchange(corrupted_frame, frame_length);
+  expect_reply("corrupted frame", BSI_FRAME_NAK, 12);
+
+  encode_x_blocks(13);
+  exchange(frame, frame_length);
+  expect_silence("frame after the corrupted one");
+
+  encode_x_blocks(12);
+  exchange(frame, frame_length);
+  expect_reply("resent frame", BSI_FRAME_STATUS, 13);
+  encode_x_blocks(13);
+  exchange(frame, frame_length);
+  expect_reply("frame after the resent one", BSI_FRAME_STATUS, 14);
+
+  float32_t partial_axes[1] = {1};
+  uint8_t payload[BSI_MAX_PAYLOAD_SIZE];
+  uint8_t payload_length = BlockStreamInterface::encode_block(payload, ABSOLUTE, BLOCK_TIME_S, 0x01, partial_axes);
+  frame_length = BlockStreamInterface::encode_frame(frame, BSI_FRAME_BLOCKS, 14, payload, payload_length);
+  exchange(frame, frame_length);
+  expect_reply("absolute block missing axes", BSI_FRAME_NAK, 14);
+
+  // Let the queued moves run
+  uint32_t end_time_ms = millis() + 3 * 4 * BLOCKS_PER_FRAME * BLOCK_TIME_S * 1000;
+  while(millis() < end_time_ms){
+    dance_loop();
+  }
+  float64_t expected_x = 3 * BLOCKS_PER_FRAME * BLOCK_X_MM;
+  float64_t actual_x = block_stream.output_x.read_target();
+  check("final X position", fabs(actual_x - expected_x) < 1e-6);
+
+  check("block count", block_stream.read_block_count() == 3 * BLOCKS_PER_FRAME);
+  check("CRC error count", block_stream.read_crc_error_count() == 1);
+  check("sequence error count", block_stream.read_sequence_error_count() == 1);
+
+  Serial.println(num_failures ? "BLOCK STREAM LOOPBACK TEST FAILED" : "BLOCK STREAM LOOPBACK TEST PASSED");
+}
+
+void encode_x_blocks(uint8_t sequence){
+  uint8_t payload[BSI_MAX_PAYLOAD_SIZE];
+  uint8_t payload_length = 0;
+  float32_t x_value = BLOCK_X_MM;
+  for(uint8_t block_index = 0; block_index < BLOCKS_PER_FRAME; block_index++){
+    payload_length += BlockStreamInterface::encode_block(&payload[payload_length], INCREMENTAL, BLOCK_TIME_S, 0x01, &x_value);
+  }
+  frame_length = BlockStreamInterface::encode_frame(frame, BSI_FRAME_BLOCKS, sequence, payload, payload_length);
+}
+
+void exchange(const uint8_t* data, uint16_t length){
+  loopback.send_to_device(data, length);
+  while(loopback.available()){
+    dance_loop();
+  }
+}
+
+void expect_reply(const char* step_name, uint8_t frame_type, uint8_t next_sequence){
+  uint8_t* reply = loopback.to_host_buffer;
+  uint16_t reply_length = loopback.to_host_length;
+  bool reply_ok = (reply_length >= BSI_HEADER_SIZE + BSI_CRC_SIZE) && (reply[0] == BSI_SYNC) &&
+                  (reply_length == BSI_HEADER_SIZE + reply[3] + BSI_CRC_SIZE);
+  if(reply_ok){
+    uint16_t crc = BlockStreamInterface::crc16(&reply[1], BSI_HEADER_SIZE - 1 + reply[3]);
+    reply_ok = (reply[reply_length - 2] == (uint8_t)crc) && (reply[reply_length - 1] == (uint8_t)(crc >> 8));
+  }
+  check(step_name, reply_ok && (reply[1] == frame_type) && (reply[2] == next_sequence));
+}
+
+void expect_silence(const char* step_name){
+  check(step_name, loopback.to_host_length == 0);
+}
+
+void check(const char* step_name, bool passed){
+  Serial.print(passed ? "  ok: " : "FAIL: ");
+  Serial.println(step_name);
+  if(!passed){
+    num_failures++;
+  }
+}
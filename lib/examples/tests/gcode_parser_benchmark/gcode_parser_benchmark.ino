@@ -0,0 +1,114 @@
+/*
+G-Code Parser Benchmark
+
+Replays a short excerpt of slicer output into a GCodeInterface through an in-memory stream, and reports how many
+lines per second the interface can tokenize and match to a code. Only parsing is timed, using the CPU cycle counter,
+so the result doesn't depend on how quickly the machine works through the moves.
+
+The excerpt includes the comments, travel moves, and extrusion moves typical of a sliced print. Unsupported codes
+(e.g. M204) answer with an error, as they would from a real sender. Like comment-only lines, they aren't counted or
+timed, so the result is the rate for lines that match a code.
+
+The result is printed once NUM_LINES lines have been parsed (about a minute).
+
+To measure parsing without a Teensy, use the host build of the interface throughput benchmark
+(lib/examples/tests/host/Makefile), which reports the parse cycles per line from the same counters.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_driver   // tells compiler we're using the Stepdance Driver Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+const char* SLICER_EXCERPT =
+  ";LAYER_CHANGE\n"
+  ";Z:0.4\n"
+  "G1 Z.4 F9000\n"
+  "G1 X101.427 Y97.852 F9000\n"
+  "G1 E.8 F2100\n"
+  ";TYPE:Perimeter\n"
+  "G1 F1800\n"
+  "G1 X102.156 Y97.331 E.02916\n"
+  "G1 X102.995 Y97.006 E.02935\n"
+  "G1 X103.889 Y96.894 E.02939\n"
+  "G1 X146.111 Y96.894 E1.37621\n"
+  "G1 X147.005 Y97.006 E.02939\n"
+  "G1 X147.844 Y97.331 E.02935\n"
+  "G1 X148.573 Y97.852 E.02916 ; perimeter corner\n"
+  "M204 S1000\n"
+  "G1 X148.573 Y102.148 F9000\n"
+  ";TYPE:Solid infill\n"
+  "G1 F2400\n"
+  "G1 X103.25 Y102.148 E1.47723\n"
+  "G1 X103.25 Y102.752 E.01969\n"
+  "G1 X146.75 Y102.752 E1.41781\n"
+  "G1 X146.75 Y103.356 E.01969\n"
+  "G1 X103.25 Y103.356 E1.41781\n"
+  "G1 E-.8 F2100\n";
+
+// Serves the excerpt over and over, as if a host were streaming it. Anything the interface writes back is dropped.
+class ReplayStream : public Stream{
+  public:
+    ReplayStream(const char* text) : text(text), next_char(text){};
+    int available(){
+      return 1;
+    }
+    int read(){
+      char character = *next_char;
+      next_char++;
+      if(*next_char == '\0'){
+        next_char = text;
+      }
+      return character;
+    }
+    int peek(){
+      return *next_char;
+    }
+    size_t write(uint8_t character){
+      return 1;
+    }
+  private:
+    const char* text;
+    const char* next_char;
+};
+
+ReplayStream replay_stream(SLICER_EXCERPT);
+GCodeInterface gcode;
+
+const uint32_t NUM_LINES = 2000;
+bool run_complete = false;
+
+void setup() {
+  gcode.begin(&replay_stream);
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+void loop() {
+  if(!run_complete && (gcode.parsed_line_count >= NUM_LINES)){
+    run_complete = true;
+    report_results();
+  }
+  dance_loop(); // Stepdance loop
+}
+
+void report_results(){
+  float64_t cycles_per_line = (float64_t)gcode.parse_cycles / gcode.parsed_line_count;
+  Serial.print("Lines Parsed: ");
+  Serial.println(gcode.parsed_line_count);
+  Serial.print("Cycles per Line: ");
+  Serial.println(cycles_per_line, 1);
+  Serial.print("Lines per Second: ");
+  Serial.println(F_CPU_ACTUAL / cycles_per_line, 0);
+}
@@ -0,0 +1,55 @@
+/*
+Host Tests - Arduino Layer
+
+Definitions behind the headers in mock/, which stand in for the Teensy core on the host.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <chrono>
+#include <thread>
+#include "Arduino.h"
+#include "SD.h"
+#include "pins_arduino.h"
+
+usb_serial_class Serial;
+usb_serial_class SerialUSB1;
+usb_serial_class SerialUSB2;
+HardwareSerialIMXRT Serial1;
+SDClass SD;
+
+volatile uint32_t host_registers[HOST_NUM_REGISTERS];
+volatile uint32_t host_pad_control_register;
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+static uint64_t host_time_ns(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+uint32_t host_cycle_count(){
+  return (uint32_t)(host_time_ns() * (F_CPU_ACTUAL / 1000000) / 1000); //wraps as the Teensy cycle counter does
+}
+
+uint32_t micros(){
+  return (uint32_t)(host_time_ns() / 1000);
+}
+
+uint32_t millis(){
+  return (uint32_t)(host_time_ns() / 1000000);
+}
+
+void delay(uint32_t ms){
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us){
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode){}
+void digitalWrite(uint8_t pin, uint8_t value){}
+uint8_t digitalRead(uint8_t pin){ return LOW; }
+int analogRead(uint8_t pin){ return 0; }
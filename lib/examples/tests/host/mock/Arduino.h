@@ -0,0 +1,17 @@
+// Host stand-in for the Teensy Arduino core, covering what the Stepdance interfaces use. See arduino_mock.cpp.
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "WString.h"
+#include "core_pins.h"
+#include "wiring.h"
+#include "usb_serial.h"
+#include "HardwareSerial.h"
+
+template<class T> T constrain(T value, T low, T high){ return (value < low) ? low : ((value > high) ? high : value); }
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
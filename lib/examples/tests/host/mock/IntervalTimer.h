@@ -0,0 +1,8 @@
+// Host stand-in for the Teensy IntervalTimer. The host build runs the frame from its main loop instead.
+#pragma once
+class IntervalTimer{
+  public:
+    bool begin(void (*function)(), float period_us){ (void)function; (void)period_us; return true; }
+    void priority(uint8_t priority){ (void)priority; }
+    void end(){}
+};
@@ -0,0 +1,78 @@
+// Host stand-in for the Teensy Print class. Formats as the Teensy core does, with println() ending lines in "\r\n".
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print{
+  public:
+    virtual ~Print(){}
+    virtual size_t write(uint8_t character) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size){
+      for(size_t byte_index = 0; byte_index < size; byte_index++){
+        write(buffer[byte_index]);
+      }
+      return size;
+    }
+    size_t write(const char* text){ return write((const uint8_t*)text, strlen(text)); }
+    size_t write(const char* buffer, size_t size){ return write((const uint8_t*)buffer, size); }
+    virtual int availableForWrite(){ return 0; }
+    virtual void flush(){}
+
+    size_t print(const char* text){ return write(text); }
+    size_t print(const String& text){ return write(text.c_str()); }
+    size_t print(char character){ return write((uint8_t)character); }
+    size_t print(unsigned char value, int base = DEC){ return print_unsigned(value, base); }
+    size_t print(int value, int base = DEC){ return print_signed(value, base); }
+    size_t print(unsigned int value, int base = DEC){ return print_unsigned(value, base); }
+    size_t print(long value, int base = DEC){ return print_signed(value, base); }
+    size_t print(unsigned long value, int base = DEC){ return print_unsigned(value, base); }
+    size_t print(long long value, int base = DEC){ return print_signed(value, base); }
+    size_t print(unsigned long long value, int base = DEC){ return print_unsigned(value, base); }
+    size_t print(double value, int decimal_places = 2){
+      char buffer[64];
+      snprintf(buffer, sizeof(buffer), "%.*f", decimal_places, value);
+      return write(buffer);
+    }
+
+    size_t println(){ return write("\r\n"); }
+    template<typename T> size_t println(const T& value){ return print(value) + println(); }
+    template<typename T> size_t println(const T& value, int format){ return print(value, format) + println(); }
+
+    size_t printf(const char* format, ...){
+      char buffer[256];
+      va_list args;
+      va_start(args, format);
+      vsnprintf(buffer, sizeof(buffer), format, args);
+      va_end(args);
+      return write(buffer);
+    }
+
+  private:
+    size_t print_unsigned(unsigned long long value, int base){
+      char buffer[66];
+      char* digit = &buffer[sizeof(buffer) - 1];
+      *digit = '\0';
+      do{
+        uint8_t digit_value = value % base;
+        *--digit = (digit_value < 10) ? ('0' + digit_value) : ('A' + digit_value - 10);
+        value /= base;
+      }while(value > 0);
+      return write(digit);
+    }
+
+    size_t print_signed(long long value, int base){
+      if((value < 0) && (base == DEC)){
+        return print('-') + print_unsigned(-(unsigned long long)value, base);
+      }
+      return print_unsigned((unsigned long long)value, base);
+    }
+};
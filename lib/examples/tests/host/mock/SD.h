@@ -0,0 +1,55 @@
+// Host stand-in for the Teensy SD library. There's no card on the host, so every file fails to open.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Stream.h"
+
+#define O_READ 0x00
+#define O_RDONLY 0x00
+#define O_WRITE 0x01
+#define O_RDWR 0x02
+#define O_CREAT 0x40
+#define O_TRUNC 0x200
+#define FIFO_SDIO 0
+#define BUILTIN_SDCARD 254
+
+struct SdioConfig{
+  SdioConfig(uint8_t options){ (void)options; }
+};
+
+class FsFile : public Stream{
+  public:
+    int available(){ return 0; }
+    int read(){ return -1; }
+    int read(void* buffer, size_t size){ (void)buffer; (void)size; return -1; }
+    int peek(){ return -1; }
+    size_t write(uint8_t character){ (void)character; return 0; }
+    size_t write(const void* buffer, size_t size){ (void)buffer; (void)size; return 0; }
+    using Print::write;
+    bool close(){ return true; }
+    bool isOpen(){ return false; }
+    operator bool(){ return false; }
+    uint64_t fileSize(){ return 0; }
+    uint64_t curPosition(){ return 0; }
+    bool seek(uint64_t position){ (void)position; return false; }
+    bool seekSet(uint64_t position){ (void)position; return false; }
+    bool truncate(){ return false; }
+    bool truncate(uint64_t length){ (void)length; return false; }
+    bool preAllocate(uint64_t length){ (void)length; return false; }
+    bool sync(){ return false; }
+    String readStringUntil(char terminator){ (void)terminator; return String(); }
+};
+
+class SdFs{
+  public:
+    bool begin(SdioConfig config){ (void)config; return false; }
+    FsFile open(const char* path, int mode = O_READ){ (void)path; (void)mode; return FsFile(); }
+    bool exists(const char* path){ (void)path; return false; }
+};
+
+class SDClass{
+  public:
+    SdFs sdfs;
+};
+
+extern SDClass SD;
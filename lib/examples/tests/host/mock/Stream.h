@@ -0,0 +1,24 @@
+// Host stand-in for the Teensy Stream class. Reads never wait, since the benchmark streams are all in memory.
+#pragma once
+#include "Print.h"
+
+class Stream : public Print{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout_ms){ (void)timeout_ms; }
+    size_t readBytes(char* buffer, size_t length){
+      size_t count = 0;
+      while(count < length){
+        int character = read();
+        if(character < 0){
+          break;
+        }
+        buffer[count++] = (char)character;
+      }
+      return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length){ return readBytes((char*)buffer, length); }
+};
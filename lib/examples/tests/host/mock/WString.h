@@ -0,0 +1,58 @@
+// Host stand-in for the Arduino String, covering what the Stepdance interfaces and RPC use.
+#pragma once
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+class String{
+  public:
+    String(){}
+    String(const char* text) : text(text ? text : ""){}
+    String(const char* text, size_t length) : text(text, length){}
+    String(const std::string& text) : text(text){}
+    explicit String(char character) : text(1, character){}
+    String(int value) : text(std::to_string(value)){}
+    String(unsigned int value) : text(std::to_string(value)){}
+    String(long value) : text(std::to_string(value)){}
+    String(unsigned long value) : text(std::to_string(value)){}
+    String(double value, unsigned char decimal_places = 2){
+      char buffer[48];
+      snprintf(buffer, sizeof(buffer), "%.*f", decimal_places, value);
+      text = buffer;
+    }
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    bool reserve(unsigned int size){ text.reserve(size); return true; }
+    bool concat(const char* other){ text += other; return true; }
+    bool concat(const char* other, unsigned int length){ text.append(other, length); return true; }
+    bool concat(char character){ text += character; return true; }
+    bool concat(const String& other){ text += other.text; return true; }
+    char operator[](unsigned int index) const { return text[index]; }
+    char& operator[](unsigned int index){ return text[index]; }
+    long toInt() const { return atol(text.c_str()); }
+    float toFloat() const { return atof(text.c_str()); }
+
+    String& operator=(const char* other){ text = other ? other : ""; return *this; }
+    String& operator+=(char character){ text += character; return *this; }
+    String& operator+=(const char* other){ text += other; return *this; }
+    String& operator+=(const String& other){ text += other.text; return *this; }
+    String operator+(const String& other) const { return String(text + other.text); }
+    String operator+(const char* other) const { return String(text + other); }
+    friend String operator+(const char* left, const String& right){ return String(left + right.text); }
+
+    bool operator==(const char* other) const { return text == other; }
+    bool operator==(const String& other) const { return text == other.text; }
+    bool operator!=(const char* other) const { return text != other; }
+    bool operator!=(const String& other) const { return text != other.text; }
+    bool operator<(const String& other) const { return text < other.text; }
+
+  private:
+    std::string text;
+};
+
+// Arduino's type for the result of adding to a String. Some libraries (e.g. ArduinoJson) name it.
+class StringSumHelper : public String{
+  public:
+    StringSumHelper(const String& text) : String(text){}
+};
@@ -0,0 +1,3 @@
+#pragma once
+typedef float float32_t;
+typedef double float64_t;
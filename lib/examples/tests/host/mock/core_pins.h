@@ -0,0 +1,38 @@
+// Host stand-in for the Teensy core. Time comes from the host clock, and interrupts are never masked, since the host build
+// runs the frame from its main loop rather than from a timer interrupt.
+#pragma once
+#include <stdint.h>
+#include "imxrt.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define F_CPU 600000000
+#define F_CPU_ACTUAL 600000000 //the cycle counter is scaled to this, so results read as they would on a Teensy 4.1
+
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+uint8_t digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+#define digitalWriteFast(pin, value) digitalWrite(pin, value)
+#define digitalReadFast(pin) digitalRead(pin)
+
+#define noInterrupts() do{}while(0)
+#define interrupts() do{}while(0)
+#define __disable_irq() do{}while(0)
+#define __enable_irq() do{}while(0)
+
+#define DMAMEM
+#define EXTMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
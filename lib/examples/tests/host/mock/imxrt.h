@@ -0,0 +1,174 @@
+// Host stand-in for the i.MX RT register definitions. The cycle counter counts host time. The peripheral registers that
+// the library configures are plain memory (host_registers), so that tests can read back what was written to them, e.g. the
+// FlexIO shift buffers that the output ports transmit through. Bit-field macros pass their value through unshifted.
+#pragma once
+#include <stdint.h>
+
+uint32_t host_cycle_count(); //host time in cycles of an F_CPU_ACTUAL clock
+#define ARM_DWT_CYCCNT (host_cycle_count())
+
+enum host_register_index{
+  HOST_ADC1_CFG,
+  HOST_ADC1_GC,
+  HOST_ADC1_HC0,
+  HOST_ADC1_R0,
+  HOST_ADC2_CFG,
+  HOST_ADC2_GC,
+  HOST_ADC2_HC0,
+  HOST_ADC2_R0,
+  HOST_CCM_CCGR1,
+  HOST_CCM_CCGR7,
+  HOST_CCM_CS1CDR,
+  HOST_FLEXIO3_CTRL,
+  HOST_FLEXIO3_SHIFTBUF0,
+  HOST_FLEXIO3_SHIFTBUF1,
+  HOST_FLEXIO3_SHIFTBUF2,
+  HOST_FLEXIO3_SHIFTBUF3,
+  HOST_FLEXIO3_SHIFTBUF4,
+  HOST_FLEXIO3_SHIFTBUF5,
+  HOST_FLEXIO3_SHIFTBUF6,
+  HOST_FLEXIO3_SHIFTBUF7,
+  HOST_FLEXIO3_SHIFTCFG0,
+  HOST_FLEXIO3_SHIFTCFG1,
+  HOST_FLEXIO3_SHIFTCFG2,
+  HOST_FLEXIO3_SHIFTCFG3,
+  HOST_FLEXIO3_SHIFTCFG4,
+  HOST_FLEXIO3_SHIFTCFG5,
+  HOST_FLEXIO3_SHIFTCFG6,
+  HOST_FLEXIO3_SHIFTCFG7,
+  HOST_FLEXIO3_SHIFTCTL0,
+  HOST_FLEXIO3_SHIFTCTL1,
+  HOST_FLEXIO3_SHIFTCTL2,
+  HOST_FLEXIO3_SHIFTCTL3,
+  HOST_FLEXIO3_SHIFTCTL4,
+  HOST_FLEXIO3_SHIFTCTL5,
+  HOST_FLEXIO3_SHIFTCTL6,
+  HOST_FLEXIO3_SHIFTCTL7,
+  HOST_FLEXIO3_TIMCFG0,
+  HOST_FLEXIO3_TIMCFG1,
+  HOST_FLEXIO3_TIMCFG2,
+  HOST_FLEXIO3_TIMCFG3,
+  HOST_FLEXIO3_TIMCMP0,
+  HOST_FLEXIO3_TIMCMP1,
+  HOST_FLEXIO3_TIMCMP2,
+  HOST_FLEXIO3_TIMCMP3,
+  HOST_FLEXIO3_TIMCTL0,
+  HOST_FLEXIO3_TIMCTL1,
+  HOST_FLEXIO3_TIMCTL2,
+  HOST_FLEXIO3_TIMCTL3,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_08,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_09,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_10,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_11,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_02,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_03,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_12,
+  HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_13,
+  HOST_NUM_REGISTERS
+};
+extern volatile uint32_t host_registers[HOST_NUM_REGISTERS];
+
+#define ADC1_CFG (host_registers[HOST_ADC1_CFG])
+#define ADC1_GC (host_registers[HOST_ADC1_GC])
+#define ADC1_HC0 (host_registers[HOST_ADC1_HC0])
+#define ADC1_R0 (host_registers[HOST_ADC1_R0])
+#define ADC2_CFG (host_registers[HOST_ADC2_CFG])
+#define ADC2_GC (host_registers[HOST_ADC2_GC])
+#define ADC2_HC0 (host_registers[HOST_ADC2_HC0])
+#define ADC2_R0 (host_registers[HOST_ADC2_R0])
+#define CCM_CCGR1 (host_registers[HOST_CCM_CCGR1])
+#define CCM_CCGR7 (host_registers[HOST_CCM_CCGR7])
+#define CCM_CS1CDR (host_registers[HOST_CCM_CS1CDR])
+#define FLEXIO3_CTRL (host_registers[HOST_FLEXIO3_CTRL])
+#define FLEXIO3_SHIFTBUF0 (host_registers[HOST_FLEXIO3_SHIFTBUF0])
+#define FLEXIO3_SHIFTBUF1 (host_registers[HOST_FLEXIO3_SHIFTBUF1])
+#define FLEXIO3_SHIFTBUF2 (host_registers[HOST_FLEXIO3_SHIFTBUF2])
+#define FLEXIO3_SHIFTBUF3 (host_registers[HOST_FLEXIO3_SHIFTBUF3])
+#define FLEXIO3_SHIFTBUF4 (host_registers[HOST_FLEXIO3_SHIFTBUF4])
+#define FLEXIO3_SHIFTBUF5 (host_registers[HOST_FLEXIO3_SHIFTBUF5])
+#define FLEXIO3_SHIFTBUF6 (host_registers[HOST_FLEXIO3_SHIFTBUF6])
+#define FLEXIO3_SHIFTBUF7 (host_registers[HOST_FLEXIO3_SHIFTBUF7])
+#define FLEXIO3_SHIFTCFG0 (host_registers[HOST_FLEXIO3_SHIFTCFG0])
+#define FLEXIO3_SHIFTCFG1 (host_registers[HOST_FLEXIO3_SHIFTCFG1])
+#define FLEXIO3_SHIFTCFG2 (host_registers[HOST_FLEXIO3_SHIFTCFG2])
+#define FLEXIO3_SHIFTCFG3 (host_registers[HOST_FLEXIO3_SHIFTCFG3])
+#define FLEXIO3_SHIFTCFG4 (host_registers[HOST_FLEXIO3_SHIFTCFG4])
+#define FLEXIO3_SHIFTCFG5 (host_registers[HOST_FLEXIO3_SHIFTCFG5])
+#define FLEXIO3_SHIFTCFG6 (host_registers[HOST_FLEXIO3_SHIFTCFG6])
+#define FLEXIO3_SHIFTCFG7 (host_registers[HOST_FLEXIO3_SHIFTCFG7])
+#define FLEXIO3_SHIFTCTL0 (host_registers[HOST_FLEXIO3_SHIFTCTL0])
+#define FLEXIO3_SHIFTCTL1 (host_registers[HOST_FLEXIO3_SHIFTCTL1])
+#define FLEXIO3_SHIFTCTL2 (host_registers[HOST_FLEXIO3_SHIFTCTL2])
+#define FLEXIO3_SHIFTCTL3 (host_registers[HOST_FLEXIO3_SHIFTCTL3])
+#define FLEXIO3_SHIFTCTL4 (host_registers[HOST_FLEXIO3_SHIFTCTL4])
+#define FLEXIO3_SHIFTCTL5 (host_registers[HOST_FLEXIO3_SHIFTCTL5])
+#define FLEXIO3_SHIFTCTL6 (host_registers[HOST_FLEXIO3_SHIFTCTL6])
+#define FLEXIO3_SHIFTCTL7 (host_registers[HOST_FLEXIO3_SHIFTCTL7])
+#define FLEXIO3_TIMCFG0 (host_registers[HOST_FLEXIO3_TIMCFG0])
+#define FLEXIO3_TIMCFG1 (host_registers[HOST_FLEXIO3_TIMCFG1])
+#define FLEXIO3_TIMCFG2 (host_registers[HOST_FLEXIO3_TIMCFG2])
+#define FLEXIO3_TIMCFG3 (host_registers[HOST_FLEXIO3_TIMCFG3])
+#define FLEXIO3_TIMCMP0 (host_registers[HOST_FLEXIO3_TIMCMP0])
+#define FLEXIO3_TIMCMP1 (host_registers[HOST_FLEXIO3_TIMCMP1])
+#define FLEXIO3_TIMCMP2 (host_registers[HOST_FLEXIO3_TIMCMP2])
+#define FLEXIO3_TIMCMP3 (host_registers[HOST_FLEXIO3_TIMCMP3])
+#define FLEXIO3_TIMCTL0 (host_registers[HOST_FLEXIO3_TIMCTL0])
+#define FLEXIO3_TIMCTL1 (host_registers[HOST_FLEXIO3_TIMCTL1])
+#define FLEXIO3_TIMCTL2 (host_registers[HOST_FLEXIO3_TIMCTL2])
+#define FLEXIO3_TIMCTL3 (host_registers[HOST_FLEXIO3_TIMCTL3])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_08 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_08])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_09 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_09])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_10 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_10])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_11 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_AD_B1_11])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_02 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_02])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_03 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_03])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_12 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_12])
+#define IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_13 (host_registers[HOST_IOMUXC_SW_MUX_CTL_PAD_GPIO_B1_13])
+
+#define CCM_CCGR_ON 3
+#define CCM_CCGR1_ADC1(n) ((uint32_t)(n))
+#define CCM_CCGR1_ADC2(n) ((uint32_t)(n))
+#define CCM_CCGR7_FLEXIO3(n) ((uint32_t)(n))
+#define CCM_CS1CDR_FLEXIO2_CLK_PODF(n) ((uint32_t)(n))
+
+#define FLEXIO_SHIFTCFG_PWIDTH(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCFG_SSTART(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCFG_SSTOP(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCTL_PINCFG(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCTL_PINSEL(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCTL_SMOD(n) ((uint32_t)(n))
+#define FLEXIO_SHIFTCTL_TIMSEL(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TIMDEC(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TIMDIS(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TIMENA(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TIMOUT(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TIMRST(n) ((uint32_t)(n))
+#define FLEXIO_TIMCFG_TSTOP(n) ((uint32_t)(n))
+#define FLEXIO_TIMCTL_PINCFG(n) ((uint32_t)(n))
+#define FLEXIO_TIMCTL_PINSEL(n) ((uint32_t)(n))
+#define FLEXIO_TIMCTL_TIMOD(n) ((uint32_t)(n))
+#define FLEXIO_TIMCTL_TRGSEL(n) ((uint32_t)(n))
+#define FLEXIO_TIMCTL_TRGPOL ((uint32_t)(1 << 23))
+#define FLEXIO_TIMCTL_TRGSRC ((uint32_t)(1 << 22))
+
+#define ADC_CFG_ADHSC ((uint32_t)(1 << 10))
+#define ADC_CFG_ADLSMP ((uint32_t)(1 << 4))
+#define ADC_CFG_OVWREN ((uint32_t)(1 << 16))
+#define ADC_CFG_ADICLK(n) ((uint32_t)(n))
+#define ADC_CFG_ADIV(n) ((uint32_t)(n))
+#define ADC_CFG_ADSTS(n) ((uint32_t)(n))
+#define ADC_CFG_AVGS(n) ((uint32_t)(n))
+#define ADC_CFG_MODE(n) ((uint32_t)(n))
+#define ADC_GC_AVGE ((uint32_t)(1 << 5))
+#define ADC_GC_CAL ((uint32_t)(1 << 7))
+#define ADC_HC_AIEN ((uint32_t)(1 << 7))
+
+#define IOMUXC_PAD_PKE ((uint32_t)(1 << 12))
+#define IOMUXC_PAD_PUE ((uint32_t)(1 << 13))
+
+// Interrupts never fire on the host
+enum IRQ_NUMBER_t{ IRQ_ADC1, IRQ_ADC2 };
+#define NVIC_SET_PRIORITY(irq, priority) do{ (void)(irq); (void)(priority); }while(0)
+#define NVIC_ENABLE_IRQ(irq) do{ (void)(irq); }while(0)
+#define NVIC_DISABLE_IRQ(irq) do{ (void)(irq); }while(0)
+inline void attachInterruptVector(IRQ_NUMBER_t irq, void (*function)(void)){ (void)irq; (void)function; }
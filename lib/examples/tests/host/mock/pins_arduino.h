@@ -0,0 +1,6 @@
+// Host stand-in for the Teensy pin definitions. Every pin shares one pad control register.
+#pragma once
+#include <stdint.h>
+
+extern volatile uint32_t host_pad_control_register;
+#define portControlRegister(pin) (&host_pad_control_register)
@@ -0,0 +1,22 @@
+// Host stand-in for the Teensy USB serial ports. Serial writes to stdout and never has anything to read.
+#pragma once
+#include <stdio.h>
+#include "Stream.h"
+
+class usb_serial_class : public Stream{
+  public:
+    void begin(long baud){ (void)baud; }
+    int available(){ return 0; }
+    int read(){ return -1; }
+    int peek(){ return -1; }
+    size_t write(uint8_t character){ return fwrite(&character, 1, 1, stdout); }
+    size_t write(const uint8_t* buffer, size_t size){ return fwrite(buffer, 1, size, stdout); }
+    using Print::write;
+    int availableForWrite(){ return 4096; }
+    void flush(){ fflush(stdout); }
+    operator bool(){ return true; }
+};
+
+extern usb_serial_class Serial;
+extern usb_serial_class SerialUSB1;
+extern usb_serial_class SerialUSB2;
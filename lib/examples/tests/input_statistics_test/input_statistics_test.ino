@@ -0,0 +1,71 @@
+/*
+Input Statistics Test
+
+Reports signal statistics for input port A: decoded pulses per signal, pulses that didn't
+match any signal, pulses on disabled signals, pulses close to a rounding boundary, and a
+histogram of received pulse widths.
+
+Connect an upstream module to input port A. On a healthy link, every pulse lands in one of six
+narrow histogram peaks (2us, 3us, ... 7us), and the out-of-range and marginal counts stay at zero.
+Peaks that spread out or drift towards a boundary point to cabling or clock problems.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_basic   // tells compiler we're using the Stepdance Basic Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+// -- Input Port --
+InputPort input_a;
+
+void setup() {
+  // -- Configure and start the input port --
+  input_a.begin(INPUT_A);
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+LoopDelay report;
+
+void loop() {
+  dance_loop(); // Stepdance loop
+  report.periodic_call(&report_statistics, 1000);
+}
+
+void report_statistics(){
+  const char signal_names[NUM_SIGNALS] = {'X', 'Y', 'R', 'T', 'Z', 'E'};
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    Serial.print(signal_names[signal_index]);
+    Serial.print(": ");
+    Serial.print(input_a.read_pulse_count(signal_index));
+    Serial.print(", ");
+  }
+  Serial.print("Out of Range: ");
+  Serial.print(input_a.read_out_of_range_count());
+  Serial.print(", Disabled: ");
+  Serial.print(input_a.read_disabled_count());
+  Serial.print(", Marginal: ");
+  Serial.println(input_a.read_marginal_count());
+
+  // print non-empty histogram bins
+  for(uint8_t bin_index = 0; bin_index < INPUT_HISTOGRAM_NUM_BINS; bin_index++){
+    uint32_t bin_count = input_a.read_histogram_bin(bin_index);
+    if(bin_count){
+      Serial.print("  ");
+      Serial.print((float)(bin_index * INPUT_HISTOGRAM_BIN_COUNTS) / FLEXPWM_CLOCK_MHZ);
+      Serial.print("us: ");
+      Serial.println(bin_count);
+    }
+  }
+}
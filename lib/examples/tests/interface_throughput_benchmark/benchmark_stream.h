@@ -0,0 +1,267 @@
+/*
+Interface Throughput Benchmark - Benchmark Stream
+
+A stream that replays a recording into an interface, shared by the sketch and the host build (see host/).
+
+Lines are sent one at a time, waiting for the reply before sending the next, as a G-code sender or the AxiDraw software
+does, so the latency of a line is the time from the interface reading its first character to it writing the end of its
+reply.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+#include "arm_math.h"
+#include "Arduino.h"
+#include "Stream.h"
+
+#ifndef benchmark_stream_h
+#define benchmark_stream_h
+
+const uint32_t REPLY_TIMEOUT_US = 100000; //a line without a reply by then is counted, and the next line is sent
+
+#define NUM_LATENCY_BINS  16 //bin n holds latencies from 2^n to 2^(n+1) microseconds, with bin 0 holding anything shorter
+#define NUM_LENGTH_BINS   5 //lines of 0-15, 16-31, 32-47, 48-63, and 64 or more characters
+#define LENGTH_BIN_SIZE   16
+
+// Hands an interface one line of a recording at a time, releasing the next once the interface has replied, and measures
+// how long each line takes.
+class BenchmarkStream : public Stream{
+  public:
+    void start(const char* recording, char line_end_character, uint32_t lines_to_send){
+      this->recording = recording;
+      this->line_end_character = line_end_character;
+      this->lines_to_send = lines_to_send;
+      lines_sent = 0;
+      lines_replied = 0;
+      lines_timed_out = 0;
+      total_latency_cycles = 0;
+      max_latency_cycles = 0;
+      memset(latency_histogram, 0, sizeof(latency_histogram));
+      memset(latency_cycles_by_length, 0, sizeof(latency_cycles_by_length));
+      memset(lines_by_length, 0, sizeof(lines_by_length));
+      heap_bytes_before = heap_bytes_in_use();
+      heap_bytes_peak = heap_bytes_before;
+      heap_bytes_warm = heap_bytes_before;
+      warm = false;
+      line_start = recording;
+      release_line();
+      running = true;
+      start_time_us = micros();
+    }
+
+    bool is_complete(){
+      return !running && (lines_to_send > 0);
+    }
+
+    int available(){
+      if(!running){
+        return 0;
+      }
+      if(awaiting_reply){
+        if(micros() - line_read_time_us > REPLY_TIMEOUT_US){
+          lines_timed_out ++;
+          finish_line();
+        }
+        return 0;
+      }
+      return line_end - next_char;
+    }
+
+    int read(){
+      if(!running || awaiting_reply){
+        return -1;
+      }
+      if(next_char == line_start){
+        line_start_cycle_count = ARM_DWT_CYCCNT;
+      }
+      char character = *next_char;
+      next_char++;
+      if(next_char == line_end){
+        awaiting_reply = true;
+        line_read_time_us = micros();
+      }
+      return character;
+    }
+
+    int peek(){
+      return (running && !awaiting_reply) ? *next_char : -1;
+    }
+
+    size_t write(uint8_t character){
+      if(running && awaiting_reply && (character == '\n')){ //every reply ends with a newline
+        record_latency(ARM_DWT_CYCCNT - line_start_cycle_count, line_end - line_start);
+        lines_replied ++;
+        finish_line();
+      }
+      return 1;
+    }
+
+    using Print::write;
+
+    // -- Results --
+    uint32_t lines_sent;
+    uint32_t lines_replied;
+    uint32_t lines_timed_out;
+    uint32_t elapsed_us;
+    uint64_t total_latency_cycles;
+    uint32_t max_latency_cycles;
+    uint32_t latency_histogram[NUM_LATENCY_BINS];
+    uint64_t latency_cycles_by_length[NUM_LENGTH_BINS];
+    uint32_t lines_by_length[NUM_LENGTH_BINS];
+    uint32_t heap_bytes_before;
+    uint32_t heap_bytes_warm; //after the first pass through the recording, once buffers kept between lines have grown to fit
+    uint32_t heap_bytes_peak;
+    uint32_t heap_bytes_after;
+
+  private:
+    const char* recording;
+    char line_end_character;
+    uint32_t lines_to_send = 0;
+    volatile bool running = false;
+    bool awaiting_reply = false;
+    bool warm = false;
+    const char* line_start;
+    const char* line_end;
+    const char* next_char;
+    uint32_t line_start_cycle_count;
+    uint32_t line_read_time_us;
+    uint32_t start_time_us;
+
+    static uint32_t heap_bytes_in_use(){
+#if defined(__GLIBC__) //glibc has deprecated mallinfo() in favor of mallinfo2(). The Teensy's newlib only has mallinfo().
+      return mallinfo2().uordblks;
+#else
+      return mallinfo().uordblks;
+#endif
+    }
+
+    void release_line(){
+      if(*line_start == '\0'){ //back to the top of the recording
+        line_start = recording;
+        if(!warm){
+          heap_bytes_warm = heap_bytes_in_use();
+          warm = true;
+        }
+      }
+      line_end = line_start;
+      while((*line_end != '\0') && (*line_end != line_end_character)){
+        line_end++;
+      }
+      if(*line_end == line_end_character){
+        line_end++;
+      }
+      next_char = line_start;
+      awaiting_reply = false;
+    }
+
+    void finish_line(){
+      // The heap is checked between lines, so that it isn't part of the latency of either.
+      uint32_t heap_bytes = heap_bytes_in_use();
+      if(heap_bytes > heap_bytes_peak){
+        heap_bytes_peak = heap_bytes;
+      }
+      lines_sent ++;
+      if(lines_sent == lines_to_send){
+        elapsed_us = micros() - start_time_us;
+        heap_bytes_after = heap_bytes;
+        running = false;
+        return;
+      }
+      line_start = line_end;
+      release_line();
+    }
+
+    void record_latency(uint32_t latency_cycles, uint32_t line_length){
+      total_latency_cycles += latency_cycles;
+      if(latency_cycles > max_latency_cycles){
+        max_latency_cycles = latency_cycles;
+      }
+      uint32_t latency_us = latency_cycles / (F_CPU_ACTUAL / 1000000);
+      uint8_t latency_bin = 0;
+      while((latency_us >>= 1) && (latency_bin < NUM_LATENCY_BINS - 1)){
+        latency_bin++;
+      }
+      latency_histogram[latency_bin]++;
+      uint8_t length_bin = line_length / LENGTH_BIN_SIZE;
+      if(length_bin >= NUM_LENGTH_BINS){
+        length_bin = NUM_LENGTH_BINS - 1;
+      }
+      latency_cycles_by_length[length_bin] += latency_cycles;
+      lines_by_length[length_bin]++;
+    }
+};
+
+// Prints the results of a run over Serial. Returns true if the interface beat its minimum rate, replied to every line, and
+// held no more memory at the end than after its first pass through the recording.
+inline bool report_results(const char* interface_name, BenchmarkStream& stream, float32_t min_lines_per_s){
+  float32_t cycles_per_us = F_CPU_ACTUAL / 1000000.0;
+  float32_t lines_per_s = stream.lines_sent * 1000000.0 / stream.elapsed_us;
+  bool passed = (lines_per_s >= min_lines_per_s) && (stream.lines_timed_out == 0) && (stream.heap_bytes_after <= stream.heap_bytes_warm);
+
+  Serial.println();
+  Serial.print("-- ");
+  Serial.print(interface_name);
+  Serial.println(passed ? " -- passed" : " -- FAILED");
+  Serial.print("Lines: ");
+  Serial.print(stream.lines_sent);
+  Serial.print(" in ");
+  Serial.print(stream.elapsed_us / 1000.0, 1);
+  Serial.print(" ms, ");
+  Serial.print(lines_per_s, 0);
+  Serial.print(" lines/s (minimum ");
+  Serial.print(min_lines_per_s, 0);
+  Serial.println(")");
+  Serial.print("Lines Without a Reply: ");
+  Serial.println(stream.lines_timed_out);
+
+  if(stream.lines_replied > 0){
+    Serial.print("Latency us: mean ");
+    Serial.print(stream.total_latency_cycles / cycles_per_us / stream.lines_replied, 1);
+    Serial.print(", max ");
+    Serial.println(stream.max_latency_cycles / cycles_per_us, 1);
+  }
+  for(uint8_t latency_bin = 0; latency_bin < NUM_LATENCY_BINS; latency_bin++){
+    if(stream.latency_histogram[latency_bin] == 0){
+      continue;
+    }
+    Serial.print("  < ");
+    Serial.print(2UL << latency_bin);
+    Serial.print(" us: ");
+    Serial.println(stream.latency_histogram[latency_bin]);
+  }
+
+  Serial.println("Mean Latency us by Line Length:");
+  for(uint8_t length_bin = 0; length_bin < NUM_LENGTH_BINS; length_bin++){
+    if(stream.lines_by_length[length_bin] == 0){
+      continue;
+    }
+    Serial.print("  ");
+    Serial.print(length_bin * LENGTH_BIN_SIZE);
+    if(length_bin < NUM_LENGTH_BINS - 1){
+      Serial.print("-");
+      Serial.print((length_bin + 1) * LENGTH_BIN_SIZE - 1);
+    }else{
+      Serial.print("+");
+    }
+    Serial.print(" chars: ");
+    Serial.println(stream.latency_cycles_by_length[length_bin] / cycles_per_us / stream.lines_by_length[length_bin], 1);
+  }
+
+  Serial.print("Heap Bytes in Use: ");
+  Serial.print(stream.heap_bytes_before);
+  Serial.print(" before, ");
+  Serial.print(stream.heap_bytes_warm);
+  Serial.print(" after the first pass, ");
+  Serial.print(stream.heap_bytes_peak);
+  Serial.print(" peak, ");
+  Serial.print(stream.heap_bytes_after);
+  Serial.println(" after");
+  return passed;
+}
+
+#endif
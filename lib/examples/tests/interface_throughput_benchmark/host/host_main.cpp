@@ -0,0 +1,185 @@
+/*
+Interface Throughput Benchmark - Host Build
+
+Runs the interface throughput benchmark on a PC, so that it can gate changes in CI without a Teensy. It's built with
+the other host tests, by lib/examples/tests/host/Makefile. The interfaces are built from the library as they are for the
+board, and feed a stand-in interpolator (interpolator_sink.h). The frame runs from the main loop, every 40us of host time.
+
+Usage:
+  interface_throughput_benchmark [--lines N] [--gcode FILE] [--ebb FILE] [--rpc FILE] [--skip-rpc]
+
+Each interface replays the recording in ../recordings.h, or a recorded file if one is given. Lines in EBB files may end
+in CR, LF, or CRLF. Results are reported as in the sketch, and the program exits with 1 if any interface fails.
+
+RPC can only be benchmarked when the build is given ArduinoJson. A build without it fails, unless --skip-rpc is given.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "interfaces.hpp"
+#include "rpc.hpp"
+#include "interpolator_sink.h"
+#include "recordings.h"
+#include "benchmark_stream.h"
+
+// -- Pass Criteria --
+// A quarter of the slowest of nine runs on a single-core Xeon build container, whose runs ranged over 560k-764k lines/s
+// for G-code and 337k-439k for EBB. This leaves room for slower or busier CI machines. RPC has no host baseline yet, so
+// it's only checked for replying to every line and holding its memory.
+const float32_t GCODE_MIN_LINES_PER_S = 140000;
+const float32_t EBB_MIN_LINES_PER_S = 84000;
+const float32_t RPC_MIN_LINES_PER_S = 0;
+
+const uint32_t DEFAULT_NUM_LINES = 200000; //lines sent to each interface
+
+BenchmarkStream gcode_stream;
+BenchmarkStream ebb_stream;
+GCodeInterface gcode;
+Eibotboard ebb;
+
+#ifdef HOST_RPC
+BenchmarkStream rpc_stream;
+RPC rpc;
+
+float32_t bench_gain = 1;
+
+float32_t bench_add(float32_t a, float32_t b){
+  return a + b;
+}
+#endif
+
+static uint32_t last_frame_time_us = 0;
+
+// Runs the main loop once, and any frames that have come due since the last call.
+void run_loop(){
+  dance_loop();
+  uint32_t time_us = micros();
+  while(time_us - last_frame_time_us >= CORE_FRAME_PERIOD_US){
+    last_frame_time_us += CORE_FRAME_PERIOD_US;
+    Plugin::run_pre_channel_frame_plugins();
+  }
+}
+
+// Replays a recording through a stream until every line has been sent, then reports the results.
+bool run_benchmark(const char* interface_name, BenchmarkStream& stream, const char* recording, char line_end_character, uint32_t num_lines, float32_t min_lines_per_s){
+  uint32_t block_count_before = interpolator_sink_block_count;
+  stream.start(recording, line_end_character, num_lines);
+  while(!stream.is_complete()){
+    run_loop();
+  }
+  bool passed = report_results(interface_name, stream, min_lines_per_s);
+  Serial.print("Blocks Taken by the Interpolator: ");
+  Serial.println(interpolator_sink_block_count - block_count_before);
+  return passed;
+}
+
+// Reads a recorded file, with each line ending in line_end_character.
+bool load_recording(const char* file_name, char line_end_character, std::string* recording){
+  std::ifstream recording_file(file_name, std::ios::binary);
+  if(!recording_file){
+    fprintf(stderr, "Can't open %s\n", file_name);
+    return false;
+  }
+  std::stringstream contents;
+  contents << recording_file.rdbuf();
+  recording->clear();
+  bool line_ended = true;
+  for(char character : contents.str()){
+    if((character == '\r') || (character == '\n')){
+      if(!line_ended){ //so CRLF ends a line only once, and blank lines are dropped
+        *recording += line_end_character;
+        line_ended = true;
+      }
+    }else{
+      *recording += character;
+      line_ended = false;
+    }
+  }
+  if(!line_ended){
+    *recording += line_end_character;
+  }
+  if(recording->empty()){
+    fprintf(stderr, "%s is empty\n", file_name);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv){
+  uint32_t num_lines = DEFAULT_NUM_LINES;
+  bool skip_rpc = false;
+  std::string gcode_recording = GCODE_RECORDING;
+  std::string ebb_recording = EBB_RECORDING;
+  std::string rpc_recording = RPC_RECORDING;
+  for(int arg_index = 1; arg_index < argc; arg_index++){
+    bool has_value = (arg_index + 1 < argc);
+    if(has_value && !strcmp(argv[arg_index], "--lines")){
+      num_lines = strtoul(argv[++arg_index], nullptr, 10);
+    }else if(has_value && !strcmp(argv[arg_index], "--gcode")){
+      if(!load_recording(argv[++arg_index], '\n', &gcode_recording)) return 2;
+    }else if(has_value && !strcmp(argv[arg_index], "--ebb")){
+      if(!load_recording(argv[++arg_index], '\r', &ebb_recording)) return 2;
+    }else if(has_value && !strcmp(argv[arg_index], "--rpc")){
+      if(!load_recording(argv[++arg_index], '\n', &rpc_recording)) return 2;
+    }else if(!strcmp(argv[arg_index], "--skip-rpc")){
+      skip_rpc = true;
+    }else{
+      fprintf(stderr, "usage: %s [--lines N] [--gcode FILE] [--ebb FILE] [--rpc FILE] [--skip-rpc]\n", argv[0]);
+      return 2;
+    }
+  }
+  if(num_lines == 0){
+    fprintf(stderr, "--lines must be at least 1\n");
+    return 2;
+  }
+
+  gcode.begin(&gcode_stream);
+  ebb.begin(&ebb_stream);
+#ifdef HOST_RPC
+  rpc.begin(&rpc_stream);
+  rpc.enroll("bench_gain", bench_gain);
+  rpc.enroll("bench_add", bench_add);
+  rpc.enroll("ebb", ebb);
+#endif
+  last_frame_time_us = micros();
+
+  bool all_passed = true;
+  all_passed = run_benchmark("G-Code", gcode_stream, gcode_recording.c_str(), '\n', num_lines, GCODE_MIN_LINES_PER_S) && all_passed;
+  Serial.print("Parse Cycles per Line: ");
+  Serial.println((float64_t)gcode.parse_cycles / gcode.parsed_line_count, 1);
+
+  ebb.reset_latency_statistics();
+  all_passed = run_benchmark("EBB", ebb_stream, ebb_recording.c_str(), '\r', num_lines, EBB_MIN_LINES_PER_S) && all_passed;
+  Serial.print("Mean Latency us (immediate, queued, queued to interpolator): ");
+  for(uint8_t latency_class = 0; latency_class < EBB_NUM_LATENCY_CLASSES; latency_class++){
+    Serial.print(ebb.read_mean_latency_us(latency_class), 1);
+    Serial.print((latency_class < EBB_NUM_LATENCY_CLASSES - 1) ? ", " : "\n");
+  }
+
+#ifdef HOST_RPC
+  if(!skip_rpc){
+    all_passed = run_benchmark("RPC", rpc_stream, rpc_recording.c_str(), '\n', num_lines, RPC_MIN_LINES_PER_S) && all_passed;
+  }
+#else
+  Serial.println();
+  if(skip_rpc){
+    Serial.println("-- RPC -- skipped");
+  }else{
+    Serial.println("-- RPC -- FAILED: built without ArduinoJson, so RPC can't be benchmarked");
+    all_passed = false;
+  }
+#endif
+
+  Serial.println();
+  Serial.println(all_passed ? "PASSED" : "FAILED");
+  Serial.flush();
+  return all_passed ? 0 : 1;
+}
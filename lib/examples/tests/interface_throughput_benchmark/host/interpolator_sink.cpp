@@ -0,0 +1,134 @@
+/*
+Interface Throughput Benchmark - Interpolator Sink
+
+Stands in for interpolators.cpp in the host build. See interpolator_sink.h.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include "interpolators.hpp"
+#include "interpolator_sink.h"
+
+uint32_t interpolator_sink_block_count = 0;
+
+TimeBasedInterpolatorBase::TimeBasedInterpolatorBase(uint8_t num_axes, BlockPort* axis_ports, struct axis_state* axes, struct queued_block_header* default_block_queue, uint16_t block_stride){
+  this->num_axes = num_axes;
+  this->axis_ports = axis_ports;
+  this->axes = axes;
+  this->block_queue = default_block_queue;
+  this->block_stride = block_stride;
+};
+
+TimeBasedInterpolator::TimeBasedInterpolator(){};
+
+void TimeBasedInterpolatorBase::begin(){
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    axis_ports[axis_index].begin(&axes[axis_index].output_position, BLOCKPORT_OUTPUT);
+  }
+  output_parameter.begin(&output_position_parameter, BLOCKPORT_OUTPUT);
+  output_duration.begin(&output_value_duration, BLOCKPORT_OUTPUT);
+  reset_block_queue();
+  register_plugin();
+}
+
+void TimeBasedInterpolatorBase::set_block_queue(struct queued_block_header* block_storage, uint16_t queue_depth){
+  if((block_storage != nullptr) && (queue_depth > 0)){
+    block_queue = block_storage;
+    block_queue_depth = queue_depth;
+  }
+}
+
+// -- QUEUE --
+
+int16_t TimeBasedInterpolatorBase::queue_block(uint8_t block_type, uint32_t block_id, float32_t block_time_s, float32_t block_velocity_per_s, const float64_t* axis_values, const float32_t* curve_values, uint8_t block_flags){
+  if(queue_is_full()){
+    return -1;
+  }
+  slots_remaining --;
+  interpolator_sink_block_count ++;
+  return (int16_t)slots_remaining;
+}
+
+int16_t TimeBasedInterpolatorBase::add_block(struct motion_block* block_to_add){
+  return queue_block(block_to_add->block_type, block_to_add->block_id, block_to_add->block_time_s, block_to_add->block_velocity_per_s, nullptr, block_to_add->curve_values, block_to_add->block_flags);
+}
+
+int16_t TimeBasedInterpolatorBase::add_axes_move(uint8_t mode, float32_t move_velocity_per_s, const float64_t* axis_positions){
+  return queue_block(BLOCK_TYPE_INCREMENTAL, 0, 0, move_velocity_per_s, axis_positions, nullptr);
+}
+
+int16_t TimeBasedInterpolatorBase::add_timed_axes_move(uint8_t mode, float32_t move_time_s, const float64_t* axis_positions){
+  return queue_block(BLOCK_TYPE_INCREMENTAL, 0, move_time_s, 0, axis_positions, nullptr);
+}
+
+int16_t TimeBasedInterpolatorBase::add_arc(float32_t velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition center_x, DecimalPosition center_y, int8_t direction, DecimalPosition z, DecimalPosition e){
+  if(num_axes < 2){
+    return -1;
+  }
+  return queue_block(BLOCK_TYPE_ARC, 0, 0, velocity_per_s, nullptr, nullptr);
+}
+
+int16_t TimeBasedInterpolatorBase::add_bezier(float32_t velocity_per_s, DecimalPosition control_1_x, DecimalPosition control_1_y, DecimalPosition control_2_x, DecimalPosition control_2_y, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e){
+  if(num_axes < 2){
+    return -1;
+  }
+  return queue_block(BLOCK_TYPE_BEZIER, 0, 0, velocity_per_s, nullptr, nullptr);
+}
+
+void TimeBasedInterpolatorBase::reset_block_queue(){
+  slots_remaining = block_queue_depth;
+  in_block = 0;
+}
+
+bool TimeBasedInterpolatorBase::is_idle(){
+  return slots_remaining == block_queue_depth;
+}
+
+bool TimeBasedInterpolatorBase::queue_is_full(){
+  return slots_remaining == 0;
+}
+
+// -- FRAME --
+
+void TimeBasedInterpolatorBase::run(){
+  // Finishes every queued block. A held interpolator stops at once.
+  if(!feed_hold_active){
+    slots_remaining = block_queue_depth;
+  }
+}
+
+// -- CONTROL --
+
+void TimeBasedInterpolatorBase::feed_hold(){
+  feed_hold_active = true;
+}
+
+void TimeBasedInterpolatorBase::resume(){
+  feed_hold_active = false;
+}
+
+bool TimeBasedInterpolatorBase::is_held(){
+  return feed_hold_active;
+}
+
+bool TimeBasedInterpolatorBase::feed_hold_requested(){
+  return feed_hold_active;
+}
+
+float32_t TimeBasedInterpolatorBase::read_speed_per_s(){
+  return 0;
+}
+
+void TimeBasedInterpolatorBase::set_acceleration(uint8_t axis_index, float32_t acceleration_per_s2){
+  if(axis_index < num_axes){
+    axes[axis_index].acceleration_per_s2 = acceleration_per_s2;
+  }
+}
+
+void TimeBasedInterpolatorBase::set_junction_deviation(float32_t junction_deviation){
+  this->junction_deviation = junction_deviation;
+}
+
+void TimeBasedInterpolatorBase::enroll(RPC *rpc, const String& instance_name){}
@@ -0,0 +1,21 @@
+/*
+Interface Throughput Benchmark - Interpolator Sink
+
+The host build links interpolator_sink.cpp in place of interpolators.cpp. Each TimeBasedInterpolator then takes blocks
+as the real one does, with the same queue depth and the same replies, but finishes every queued block at the next frame
+and doesn't plan or move anything. This keeps the planner, and the time the machine takes to move, out of the
+measurement, so that the interfaces are measured on their own. The queue still fills if lines arrive faster than frames.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <stdint.h>
+
+#ifndef interpolator_sink_h
+#define interpolator_sink_h
+
+extern uint32_t interpolator_sink_block_count; //blocks taken by every interpolator since startup
+
+#endif
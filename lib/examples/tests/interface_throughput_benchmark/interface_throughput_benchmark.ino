@@ -0,0 +1,131 @@
+/*
+Interface Throughput Benchmark
+
+Replays recorded host traffic into a GCodeInterface, an Eibotboard, and an RPC in turn, each through an in-memory
+stream, and reports how many lines per second each interface can take. Lines are sent one at a time, waiting for the
+reply before sending the next, as a G-code sender or the AxiDraw software does, so the latency of a line is the time
+from the interface reading its first character to it writing the end of its reply.
+
+For each interface the benchmark reports:
+- lines per second over the whole run
+- mean and longest latency, and a histogram of latencies in power-of-two microsecond bins
+- mean latency by line length, to show how parse time grows with the complexity of a line
+- bytes in use on the heap before the run, at its peak, and after it
+
+The recordings move the machine by tiny amounts at high speed, so that each move takes a frame or two and the
+interpolators drain about as fast as lines arrive. What's measured is then mostly the interfaces themselves.
+
+The run takes a few seconds, starting a second after startup. It finishes with PASSED if every interface beats its
+minimum rate, replied to every line, and held no more memory at the end than after its first pass through the
+recording. Otherwise it prints FAILED, so the sketch can gate changes on a test rig.
+
+The same benchmark builds and runs on a PC, with a stand-in for the Teensy core and the interpolator, so that it can
+gate changes in CI. See host/host_main.cpp.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_driver   // tells compiler we're using the Stepdance Driver Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+#include "recordings.h"
+#include "benchmark_stream.h"
+
+// -- Pass Criteria --
+// These haven't been measured against a Teensy 4.1 yet. They sit well under the one-block-per-frame (25k lines/s) limit
+// of the recordings, and should be set to about half of a measured run. The host build's floors are measured; see host/.
+const float32_t GCODE_MIN_LINES_PER_S = 2000;
+const float32_t EBB_MIN_LINES_PER_S = 2000;
+const float32_t RPC_MIN_LINES_PER_S = 1000;
+
+const uint32_t NUM_LINES = 5000; //lines sent to each interface
+
+BenchmarkStream gcode_stream;
+BenchmarkStream ebb_stream;
+BenchmarkStream rpc_stream;
+
+GCodeInterface gcode;
+Eibotboard ebb;
+RPC rpc;
+
+float32_t bench_gain = 1;
+
+float32_t bench_add(float32_t a, float32_t b){
+  return a + b;
+}
+
+enum{
+  PHASE_WAITING,
+  PHASE_GCODE,
+  PHASE_EBB,
+  PHASE_RPC,
+  PHASE_COMPLETE
+};
+uint8_t phase = PHASE_WAITING;
+bool all_passed = true;
+
+void setup() {
+  gcode.begin(&gcode_stream);
+  ebb.begin(&ebb_stream);
+  rpc.begin(&rpc_stream);
+  rpc.enroll("bench_gain", bench_gain);
+  rpc.enroll("bench_add", bench_add);
+  rpc.enroll("ebb", ebb);
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+void loop() {
+  switch(phase){
+    case PHASE_WAITING:
+      if(millis() > 1000){
+        gcode_stream.start(GCODE_RECORDING, '\n', NUM_LINES);
+        phase = PHASE_GCODE;
+      }
+      break;
+
+    case PHASE_GCODE:
+      if(gcode_stream.is_complete()){
+        all_passed = report_results("G-Code", gcode_stream, GCODE_MIN_LINES_PER_S) && all_passed;
+        Serial.print("Parse Cycles per Line: ");
+        Serial.println((float64_t)gcode.parse_cycles / gcode.parsed_line_count, 1);
+        ebb.reset_latency_statistics();
+        ebb_stream.start(EBB_RECORDING, '\r', NUM_LINES);
+        phase = PHASE_EBB;
+      }
+      break;
+
+    case PHASE_EBB:
+      if(ebb_stream.is_complete()){
+        all_passed = report_results("EBB", ebb_stream, EBB_MIN_LINES_PER_S) && all_passed;
+        Serial.print("Mean Latency us (immediate, queued, queued to interpolator): ");
+        for(uint8_t latency_class = 0; latency_class < EBB_NUM_LATENCY_CLASSES; latency_class++){
+          Serial.print(ebb.read_mean_latency_us(latency_class), 1);
+          Serial.print((latency_class < EBB_NUM_LATENCY_CLASSES - 1) ? ", " : "\n");
+        }
+        rpc_stream.start(RPC_RECORDING, '\n', NUM_LINES);
+        phase = PHASE_RPC;
+      }
+      break;
+
+    case PHASE_RPC:
+      if(rpc_stream.is_complete()){
+        all_passed = report_results("RPC", rpc_stream, RPC_MIN_LINES_PER_S) && all_passed;
+        Serial.println();
+        Serial.println(all_passed ? "PASSED" : "FAILED");
+        phase = PHASE_COMPLETE;
+      }
+      break;
+  }
+  dance_loop(); // Stepdance loop
+}
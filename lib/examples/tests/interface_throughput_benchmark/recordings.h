@@ -0,0 +1,43 @@
+/*
+Interface Throughput Benchmark - Recordings
+
+Host traffic replayed by the benchmark, shared by the sketch and the host build (see host/). Each recording is replayed
+from the top until the run has sent enough lines. The moves in each pass add up to zero.
+
+The host build can replay files in place of these, e.g. a capture of a real print or plot.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#ifndef interface_throughput_recordings_h
+#define interface_throughput_recordings_h
+
+const char* const GCODE_RECORDING =
+  "G91\n"
+  ";TYPE:Perimeter\n"
+  "G1 X.001 F60000\n"
+  "G1 Y.001\n"
+  "G1 X-.001 Y-.001\n"
+  "G1 X.001 Y.001 Z.001 E.0001\n"
+  "G1 X-.001 Y-.001 Z-.001 E-.0001 F60000\n"
+  "G1 X0.0010 Y0.0010 Z0.0010 E0.00010 F60000.0 ; corner\n"
+  "G1 X-0.0010 Y-0.0010 Z-0.0010 E-0.00010 F60000.0 ; with a longer trailing comment\n"
+  "M204 S1000\n";
+
+const char* const EBB_RECORDING =
+  "V\r"
+  "LT,4,1073741824,0,-1073741824,0\r"
+  "LT,4,-1073741824,0,1073741824,0\r"
+  "LT,8,536870912,1000000,536870912,1000000\r"
+  "LT,8,-536870912,-1000000,-536870912,-1000000\r";
+
+const char* const RPC_RECORDING =
+  "{\"name\":\"bench_gain\"}\n"
+  "{\"name\":\"bench_gain\",\"args\":[1.5]}\n"
+  "{\"name\":\"bench_add\",\"args\":[1.25,2.5]}\n"
+  "{\"name\":\"ebb.read_latency_count\",\"args\":[1]}\n"
+  "{\"name\":\"not_enrolled\",\"args\":[1,2,3]}\n";
+
+#endif
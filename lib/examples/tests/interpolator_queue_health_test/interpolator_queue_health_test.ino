@@ -0,0 +1,101 @@
+/*
+Interpolator Queue Health Test
+
+Streams short square-wave moves into a TimeBasedInterpolator from the main loop, pausing every so
+often as a slow host would, and reports the interpolator's queue health statistics once a second.
+
+Each pause longer than the queued work shows up as a starvation, and the frames spent waiting are
+added to the starved frame count. The duration histogram shows how long the streamed blocks actually
+ran, and the fill histogram shows how full the queue was as each block started. Raise the host pause
+to watch starvations climb, or raise the block length to watch them disappear.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_driver   // tells compiler we're using the Stepdance Driver Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+TimeBasedInterpolator tbi;
+
+const float BLOCK_LENGTH_MM = 0.2; // length of each streamed move
+const float BLOCK_VELOCITY_MM_PER_S = 20;
+const uint32_t HOST_PAUSE_MS = 50; // how long the "host" pauses
+const uint32_t BLOCKS_BETWEEN_PAUSES = 40;
+
+uint32_t blocks_sent = 0;
+uint32_t resume_time_ms = 0;
+
+void setup() {
+  tbi.begin();
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+LoopDelay report;
+
+void loop() {
+  stream_blocks();
+  report.periodic_call(&report_statistics, 1000);
+  dance_loop(); // Stepdance loop
+}
+
+void stream_blocks(){
+  if(millis() < resume_time_ms){ //host is busy
+    return;
+  }
+  while(!tbi.queue_is_full()){
+    float direction = (blocks_sent % 2) ? -1 : 1;
+    tbi.add_move(INCREMENTAL, BLOCK_VELOCITY_MM_PER_S, BLOCK_LENGTH_MM * direction, BLOCK_LENGTH_MM, 0, 0, 0, 0);
+    blocks_sent ++;
+    if((blocks_sent % BLOCKS_BETWEEN_PAUSES) == 0){
+      resume_time_ms = millis() + HOST_PAUSE_MS;
+      return;
+    }
+  }
+}
+
+void report_statistics(){
+  Serial.print("Starvations: ");
+  Serial.print(tbi.read_starvation_count());
+  Serial.print(", Starved Frames: ");
+  Serial.print(tbi.read_starved_frame_count());
+  Serial.print(", Min Fill: ");
+  Serial.print(tbi.read_min_queue_fill());
+  Serial.print(", Skipped: ");
+  Serial.print(tbi.read_skipped_block_count());
+  Serial.print(", Max Pull Cycles: ");
+  Serial.println(tbi.max_pull_block_cycles);
+
+  // print non-empty histogram bins
+  for(uint8_t bin_index = 0; bin_index < TBI_DURATION_HISTOGRAM_NUM_BINS; bin_index++){
+    uint32_t bin_count = tbi.read_duration_histogram_bin(bin_index);
+    if(bin_count){
+      Serial.print("  ");
+      Serial.print(1UL << bin_index);
+      Serial.print("+ frames: ");
+      Serial.println(bin_count);
+    }
+  }
+  for(uint8_t bin_index = 0; bin_index < TBI_FILL_HISTOGRAM_NUM_BINS; bin_index++){
+    uint32_t bin_count = tbi.read_fill_histogram_bin(bin_index);
+    if(bin_count){
+      Serial.print("  fill ");
+      Serial.print(bin_index);
+      Serial.print("/");
+      Serial.print(TBI_FILL_HISTOGRAM_NUM_BINS);
+      Serial.print(": ");
+      Serial.println(bin_count);
+    }
+  }
+}
@@ -0,0 +1,89 @@
+/*
+Interpolator Timing Test - Host Build
+
+Runs the interpolator timing test on a PC, with the TimeBasedInterpolator built from the library as it is for the board.
+Frames are run back to back rather than every 40us, so a million blocks take a few seconds.
+
+Each run streams a million timed moves, each lasting a non-whole number of frames, and checks that neither time nor
+position drifts: the run should take the sum of the block times to within a frame, and end exactly at the sum of the
+block distances.
+
+Absolute blocks are also run far from the origin, where a float32 target would be off by more than the tolerance, to
+check that the queue's compact values keep their precision.
+
+Blocks shorter than 1/TBI_MAX_BLOCKS_PER_FRAME of a frame can't all start in time, so a stream of them runs slower than
+its block times. For those, the test checks that the time they fall behind is exactly what read_lost_time_s() reports.
+
+Usage:
+  interpolator_timing_test
+
+The program exits with 1 if any run fails.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "interpolators.hpp"
+
+TimeBasedInterpolator tbi;
+
+const uint32_t NUM_BLOCKS = 1000000;
+const float64_t BLOCK_DISTANCE_MM = 0.013;
+const float64_t MAX_DRIFT_FRAMES = 1; // the last block ends partway through a frame
+const float64_t MAX_CARRIED_FRAMES = 1; // blocks that fall behind may still be up to a frame behind when the queue runs out
+const float64_t MAX_POSITION_ERROR_MM = 1e-6;
+
+// Streams NUM_BLOCKS blocks of frames_per_block frames each, keeping the queue full, and runs frames until the
+// interpolator is idle. Blocks are given in mode (INCREMENTAL or ABSOLUTE), starting from start_position.
+// Returns true if the run passes.
+bool run_blocks(float64_t frames_per_block, bool expect_lost_time, uint8_t mode = INCREMENTAL, float64_t start_position = 0){
+  tbi.reset_block_queue();
+  tbi.reset_statistics();
+  tbi.output_x.set(start_position, ABSOLUTE);
+  tbi.output_x.push();
+  Plugin::run_pre_channel_frame_plugins(); //lets the output settle at the start position
+  start_position = tbi.output_x.read(ABSOLUTE);
+
+  uint32_t blocks_sent = 0;
+  uint32_t elapsed_frames = 0;
+  while((blocks_sent < NUM_BLOCKS) || !tbi.is_idle()){
+    while(!tbi.queue_is_full() && (blocks_sent < NUM_BLOCKS)){
+      blocks_sent ++;
+      float64_t block_position = (mode == ABSOLUTE) ? start_position + blocks_sent * BLOCK_DISTANCE_MM : BLOCK_DISTANCE_MM;
+      tbi.add_timed_move(mode, frames_per_block * CORE_FRAME_PERIOD_S, block_position, 0, 0, 0, 0, 0);
+    }
+    Plugin::run_pre_channel_frame_plugins();
+    elapsed_frames ++;
+  }
+
+  float64_t expected_frames = NUM_BLOCKS * frames_per_block;
+  float64_t lost_frames = (float64_t)tbi.read_lost_time_s() * CORE_FRAME_FREQ_HZ;
+  float64_t drift_frames = elapsed_frames - expected_frames - lost_frames;
+  float64_t position_error = tbi.output_x.read(ABSOLUTE) - start_position - NUM_BLOCKS * BLOCK_DISTANCE_MM;
+
+  float64_t max_drift_frames = MAX_DRIFT_FRAMES + (expect_lost_time ? MAX_CARRIED_FRAMES : 0);
+  bool passed = (drift_frames >= -max_drift_frames) && (drift_frames <= max_drift_frames) &&
+                (fabs(position_error) <= MAX_POSITION_ERROR_MM) && ((lost_frames > 0) == expect_lost_time) &&
+                (tbi.read_starvation_count() == 0);
+  printf("-- %.3f frames per block, %s from %.3f --\n", frames_per_block, (mode == ABSOLUTE) ? "absolute" : "incremental", start_position);
+  printf("Elapsed Frames: %u, Expected: %.2f, Lost: %.2f, Drift: %.3f frames\n", elapsed_frames, expected_frames, lost_frames, drift_frames);
+  printf("Position Error: %.9f mm\n", position_error);
+  printf("Starvations: %u\n", tbi.read_starvation_count());
+  printf("%s\n\n", passed ? "PASSED" : "FAILED");
+  return passed;
+}
+
+int main(){
+  tbi.begin();
+
+  bool all_passed = true;
+  all_passed = run_blocks(1.37, false) && all_passed; // as in the sketch
+  all_passed = run_blocks(0.37, false) && all_passed; // several blocks per frame, but no more than TBI_MAX_BLOCKS_PER_FRAME
+  all_passed = run_blocks(0.13, true) && all_passed; // more blocks per frame than can start, so they fall behind
+  all_passed = run_blocks(1.37, false, ABSOLUTE, 5000.0007) && all_passed; // targets far from the origin, between float32 values
+  printf(all_passed ? "PASSED\n" : "FAILED\n");
+  return all_passed ? 0 : 1;
+}
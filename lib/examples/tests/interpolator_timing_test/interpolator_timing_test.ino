@@ -0,0 +1,89 @@
+/*
+Interpolator Timing Test
+
+Streams a million short timed moves through a TimeBasedInterpolator, each lasting a non-whole number
+of frames, and checks that neither time nor position drifts.
+
+Each block ends partway through a frame, and the rest of that frame carries into the next block. So the
+run should take the sum of the block times to within a frame, and end exactly at the sum of the block
+distances. Before remainders were carried, every block rounded to whole frames, and the error grew with
+the number of blocks.
+
+The result is printed once the run completes (about a minute). Starvations should read zero, or the host
+side of this sketch couldn't keep the queue full and the timing result is not meaningful. Lost time should
+also read zero. It counts time dropped when blocks are shorter than 1/TBI_MAX_BLOCKS_PER_FRAME of a frame.
+
+The host build (host/host_main.cpp) runs the same check on a PC, along with runs of shorter blocks.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_driver   // tells compiler we're using the Stepdance Driver Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+TimeBasedInterpolator tbi;
+
+const uint32_t NUM_BLOCKS = 1000000;
+const float64_t FRAMES_PER_BLOCK = 1.37; // deliberately not a whole number of frames
+const float64_t BLOCK_DISTANCE_MM = 0.013;
+
+uint32_t blocks_sent = 0;
+uint32_t start_frame = 0;
+bool run_complete = false;
+
+void setup() {
+  tbi.begin();
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+  start_frame = stepdance_get_frame_count();
+}
+
+void loop() {
+  if(blocks_sent < NUM_BLOCKS){
+    while(!tbi.queue_is_full() && (blocks_sent < NUM_BLOCKS)){
+      tbi.add_timed_move(INCREMENTAL, FRAMES_PER_BLOCK * CORE_FRAME_PERIOD_S, BLOCK_DISTANCE_MM, 0, 0, 0, 0, 0);
+      blocks_sent ++;
+    }
+  }else if(!run_complete && tbi.is_idle()){
+    run_complete = true;
+    report_results(stepdance_get_frame_count() - start_frame);
+  }
+  dance_loop(); // Stepdance loop
+}
+
+void report_results(uint32_t elapsed_frames){
+  float64_t expected_frames = NUM_BLOCKS * FRAMES_PER_BLOCK;
+  float64_t expected_position = NUM_BLOCKS * BLOCK_DISTANCE_MM;
+  float64_t position = tbi.output_x.read(ABSOLUTE);
+  Serial.print("Blocks: ");
+  Serial.println(NUM_BLOCKS);
+  Serial.print("Elapsed Frames: ");
+  Serial.print(elapsed_frames);
+  Serial.print(", Expected: ");
+  Serial.print(expected_frames, 2);
+  Serial.print(", Drift: ");
+  Serial.print(elapsed_frames - expected_frames, 2);
+  Serial.println(" frames");
+  Serial.print("Position: ");
+  Serial.print(position, 6);
+  Serial.print(", Expected: ");
+  Serial.print(expected_position, 6);
+  Serial.print(", Error: ");
+  Serial.println(position - expected_position, 9);
+  Serial.print("Lost Time: ");
+  Serial.print(tbi.read_lost_time_s() * 1000000, 1);
+  Serial.println(" us");
+  Serial.print("Starvations: ");
+  Serial.println(tbi.read_starvation_count());
+}
@@ -0,0 +1,251 @@
+/*
+Output Port Test - Host Build
+
+Checks the output port encoders and the lookahead ring on a PC. The output ports are built from the library as they are
+for the board, and transmit into the FlexIO shift buffer registers, which the host build keeps in plain memory
+(see lib/examples/tests/host/mock/imxrt.h). Each frame is run as the frame interrupt runs it: lookahead frames are
+released first, then steps are added, and then every port is encoded and transmitted.
+
+Usage:
+  output_port_test
+
+Every check that fails is printed, and the program exits with 1 if any of them fail.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include <stdio.h>
+#include "output_ports.hpp"
+
+OutputPort output_a; // lookahead
+OutputPort output_b; // no lookahead, for reference
+OutputPort output_c; // transmits manually
+
+const uint32_t SHIFTBUF_SENTINEL = 0xA5A5A5A5; // written before each frame, to tell whether a port transmitted
+const uint8_t LOOKAHEAD_FRAMES = 3;
+const uint16_t NUM_PATTERN_FRAMES = 64;
+
+static uint32_t num_checks = 0;
+static uint32_t num_failures = 0;
+
+void check(bool passed, const char* description, uint32_t value = 0){
+  num_checks ++;
+  if(!passed){
+    num_failures ++;
+    printf("FAILED: %s (0x%08X)\n", description, value);
+  }
+}
+
+void write_sentinels(){
+  FLEXIO3_SHIFTBUF0 = SHIFTBUF_SENTINEL; // A step
+  FLEXIO3_SHIFTBUF4 = SHIFTBUF_SENTINEL; // A dir
+  FLEXIO3_SHIFTBUF1 = SHIFTBUF_SENTINEL; // B step
+  FLEXIO3_SHIFTBUF5 = SHIFTBUF_SENTINEL; // B dir
+}
+
+// Adds one step to each signal set in signal_mask, on both output_a and output_b.
+void add_signals(uint8_t signal_mask, uint8_t direction){
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    if((signal_mask >> signal_index) & 1){
+      output_a.add_signal(signal_index, direction);
+      output_b.add_signal(signal_index, direction);
+    }
+  }
+}
+
+// Runs a frame as on_frame() does for the output ports.
+void run_frame(uint8_t signal_mask, uint8_t direction){
+  write_sentinels();
+  release_frames_on_all_output_ports();
+  add_signals(signal_mask, direction);
+  transmit_frames_on_all_output_ports();
+}
+
+// Finds the runs of high bits in an encoded frame. Returns the number of runs.
+uint8_t find_pulses(uint32_t encoded_frame, uint8_t* pulse_starts, uint8_t* pulse_lengths, uint8_t max_pulses){
+  uint8_t num_pulses = 0;
+  uint8_t bit_index = 0;
+  while(bit_index < OUTPUT_FRAME_BITS){
+    if(!((encoded_frame >> bit_index) & 1)){
+      bit_index ++;
+      continue;
+    }
+    uint8_t pulse_start = bit_index;
+    while((bit_index < OUTPUT_FRAME_BITS) && ((encoded_frame >> bit_index) & 1)){
+      bit_index ++;
+    }
+    if(num_pulses < max_pulses){
+      pulse_starts[num_pulses] = pulse_start;
+      pulse_lengths[num_pulses] = bit_index - pulse_start;
+    }
+    num_pulses ++;
+  }
+  return num_pulses;
+}
+
+// -- LOOKAHEAD RING --
+
+void test_lookahead_ring(){
+  check(output_a.set_lookahead(LOOKAHEAD_FRAMES), "set_lookahead() on an idle port");
+  check(!output_c.set_lookahead(1), "set_lookahead() is refused on a manually transmitted port");
+
+  // Every frame on A must be the frame B transmitted LOOKAHEAD_FRAMES earlier. The first ones come from the primed ring.
+  uint32_t a_steps[NUM_PATTERN_FRAMES], a_dirs[NUM_PATTERN_FRAMES];
+  uint32_t b_steps[NUM_PATTERN_FRAMES], b_dirs[NUM_PATTERN_FRAMES];
+  for(uint16_t frame_index = 0; frame_index < NUM_PATTERN_FRAMES; frame_index++){
+    uint8_t signal_mask = (frame_index < NUM_PATTERN_FRAMES - LOOKAHEAD_FRAMES) ? ((frame_index * 37) & 0x3F) : 0; //idle at the end, so the ring drains
+    run_frame(signal_mask, frame_index & 1);
+    a_steps[frame_index] = FLEXIO3_SHIFTBUF0;
+    a_dirs[frame_index] = FLEXIO3_SHIFTBUF4;
+    b_steps[frame_index] = FLEXIO3_SHIFTBUF1;
+    b_dirs[frame_index] = FLEXIO3_SHIFTBUF5;
+  }
+  uint32_t b_frames_with_steps = 0;
+  for(uint16_t frame_index = 0; frame_index < NUM_PATTERN_FRAMES; frame_index++){
+    check(a_steps[frame_index] != SHIFTBUF_SENTINEL, "lookahead port transmits every frame", frame_index);
+    check(b_steps[frame_index] != SHIFTBUF_SENTINEL, "reference port transmits every frame", frame_index);
+    if(b_steps[frame_index]){
+      b_frames_with_steps ++;
+    }
+    if(frame_index < LOOKAHEAD_FRAMES){
+      check((a_steps[frame_index] == 0) && (a_dirs[frame_index] == 0), "primed lookahead frames are empty", frame_index);
+    }else{
+      check(a_steps[frame_index] == b_steps[frame_index - LOOKAHEAD_FRAMES], "lookahead step frame matches the reference", frame_index);
+      check(a_dirs[frame_index] == b_dirs[frame_index - LOOKAHEAD_FRAMES], "lookahead dir frame matches the reference", frame_index);
+    }
+  }
+  check(b_frames_with_steps > NUM_PATTERN_FRAMES / 2, "pattern moves the reference port", b_frames_with_steps);
+  check(output_a.lookahead_underruns == 0, "no underruns while encode and release alternate", output_a.lookahead_underruns);
+  check(output_a.lookahead_overruns == 0, "no overruns while encode and release alternate", output_a.lookahead_overruns);
+
+  // Resizing is refused while a frame in the ring carries a step, and allowed once the ring has drained.
+  run_frame(1 << SIGNAL_X, DIRECTION_FORWARD);
+  check(!output_a.set_lookahead(1), "set_lookahead() is refused while the ring holds steps");
+  for(uint8_t frame_index = 0; frame_index < LOOKAHEAD_FRAMES; frame_index++){
+    run_frame(0, DIRECTION_FORWARD);
+  }
+  check(FLEXIO3_SHIFTBUF0 == 0x0000000C, "step released after the lookahead", FLEXIO3_SHIFTBUF0);
+  check(output_a.set_lookahead(1), "set_lookahead() once the ring has drained");
+
+  // Releasing out of turn empties the ring, so the next frame has nothing to send.
+  output_a.release_frame();
+  run_frame(0, DIRECTION_FORWARD);
+  check(FLEXIO3_SHIFTBUF0 == SHIFTBUF_SENTINEL, "nothing is transmitted from an empty ring", FLEXIO3_SHIFTBUF0);
+  check(output_a.lookahead_underruns == 1, "empty ring counts an underrun", output_a.lookahead_underruns);
+
+  // Encoding out of turn fills the ring, and frames beyond its size are discarded.
+  for(uint8_t frame_index = 0; frame_index < OUTPUT_LOOKAHEAD_RING_SIZE; frame_index++){
+    output_a.transmit_frame();
+  }
+  check(output_a.lookahead_overruns == 2, "full ring counts overruns", output_a.lookahead_overruns);
+
+  check(output_a.set_lookahead(OUTPUT_LOOKAHEAD_OFF), "turn lookahead off");
+  run_frame(0, DIRECTION_FORWARD);
+  check(FLEXIO3_SHIFTBUF0 == 0, "port transmits at encode time with lookahead off", FLEXIO3_SHIFTBUF0);
+}
+
+// -- STEPDANCE FORMAT --
+
+void test_encode(){
+  // A single forward step on X: a 2us step pulse at 2us, and a 4us dir pulse at 1us.
+  output_b.add_signal(SIGNAL_X, DIRECTION_FORWARD);
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == 0x0000000C, "X step pulse", FLEXIO3_SHIFTBUF1);
+  check(FLEXIO3_SHIFTBUF5 == 0x0000001E, "X dir pulse", FLEXIO3_SHIFTBUF5);
+
+  // Reverse steps have no dir pulse.
+  output_b.add_signal(SIGNAL_X, DIRECTION_REVERSE);
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == 0x0000000C, "reverse X step pulse", FLEXIO3_SHIFTBUF1);
+  check(FLEXIO3_SHIFTBUF5 == 0, "reverse X has no dir pulse", FLEXIO3_SHIFTBUF5);
+
+  // Each signal is one microsecond longer than the last, with 2us between them. Five fit in a 32us frame.
+  check(output_b.read_signal_capacity() == 5, "signal capacity of a 32us frame", output_b.read_signal_capacity());
+  output_b.reset_signal_counters();
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    output_b.add_signal(signal_index, DIRECTION_FORWARD);
+  }
+  output_b.transmit_frame();
+  uint8_t pulse_starts[NUM_SIGNALS + 1], pulse_lengths[NUM_SIGNALS + 1];
+  uint8_t num_pulses = find_pulses(FLEXIO3_SHIFTBUF1, pulse_starts, pulse_lengths, NUM_SIGNALS + 1);
+  check(num_pulses == 5, "five signals in the first frame", num_pulses);
+  uint8_t expected_start = 2;
+  for(uint8_t pulse_index = 0; (pulse_index < num_pulses) && (pulse_index < 5); pulse_index++){
+    check(pulse_starts[pulse_index] == expected_start, "signal starts after the one before it", pulse_index);
+    check(pulse_lengths[pulse_index] == pulse_index + 2, "signal width", pulse_index);
+    expected_start += pulse_lengths[pulse_index] + 2;
+  }
+  check(output_b.read_carry_count(SIGNAL_E) == 1, "longest signal is carried to the next frame", output_b.read_carry_count(SIGNAL_E));
+
+  // The carried signal goes first in the next frame, even when shorter signals are also waiting.
+  output_b.add_signal(SIGNAL_X, DIRECTION_FORWARD);
+  output_b.transmit_frame();
+  num_pulses = find_pulses(FLEXIO3_SHIFTBUF1, pulse_starts, pulse_lengths, NUM_SIGNALS + 1);
+  check(num_pulses == 2, "carried signal and new signal in the next frame", num_pulses);
+  check((pulse_starts[0] == 2) && (pulse_lengths[0] == 7), "carried signal is packed first", FLEXIO3_SHIFTBUF1);
+  check((pulse_starts[1] == 11) && (pulse_lengths[1] == 2), "new signal follows the carried one", FLEXIO3_SHIFTBUF1);
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == 0, "nothing left pending", FLEXIO3_SHIFTBUF1);
+
+  // A step and a step back cancel before they are sent.
+  output_b.add_signal(SIGNAL_Y, DIRECTION_FORWARD);
+  output_b.add_signal(SIGNAL_Y, DIRECTION_REVERSE);
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == 0, "opposing steps cancel", FLEXIO3_SHIFTBUF1);
+}
+
+// -- DRIVER FORMAT --
+
+void test_encode_driver(){
+  output_b.set_output_format(OUTPUT_FORMAT_DRIVER);
+  output_b.set_driver_timing(1, 1, 1, 1); // 1 bit of setup, high, low and hold time. 15 steps fit in the 30 bits between.
+  output_b.reset_signal_counters();
+  check(output_b.read_max_steps_per_frame() == 15, "driver steps per frame", output_b.read_max_steps_per_frame());
+
+  // Steps are spread evenly over the frame, and DIR is held for the whole frame.
+  for(uint8_t step_index = 0; step_index < 4; step_index++){
+    output_b.add_signal(SIGNAL_Y, DIRECTION_FORWARD);
+  }
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == ((1 << 1) | (1 << 8) | (1 << 15) | (1 << 22)), "four driver steps", FLEXIO3_SHIFTBUF1);
+  check(FLEXIO3_SHIFTBUF5 == 0xFFFFFFFF, "driver dir forward", FLEXIO3_SHIFTBUF5);
+
+  // The driver port belongs to the first signal added to it
+  output_b.add_signal(SIGNAL_X, DIRECTION_FORWARD);
+  check(output_b.read_drop_count(SIGNAL_X) == 1, "second signal on a driver port is dropped", output_b.read_drop_count(SIGNAL_X));
+
+  // Steps beyond the frame's capacity are carried.
+  for(uint8_t step_index = 0; step_index < 20; step_index++){
+    output_b.add_signal(SIGNAL_Y, DIRECTION_REVERSE);
+  }
+  output_b.transmit_frame();
+  uint8_t pulse_starts[OUTPUT_DRIVER_MAX_STEPS_PER_FRAME + 1], pulse_lengths[OUTPUT_DRIVER_MAX_STEPS_PER_FRAME + 1];
+  uint8_t num_pulses = find_pulses(FLEXIO3_SHIFTBUF1, pulse_starts, pulse_lengths, OUTPUT_DRIVER_MAX_STEPS_PER_FRAME + 1);
+  check(num_pulses == 15, "full frame of driver steps", num_pulses);
+  check(FLEXIO3_SHIFTBUF5 == 0, "driver dir reverse", FLEXIO3_SHIFTBUF5);
+  check(output_b.read_carry_count(SIGNAL_Y) == 5, "driver steps carried", output_b.read_carry_count(SIGNAL_Y));
+  output_b.transmit_frame();
+  num_pulses = find_pulses(FLEXIO3_SHIFTBUF1, pulse_starts, pulse_lengths, OUTPUT_DRIVER_MAX_STEPS_PER_FRAME + 1);
+  check(num_pulses == 5, "carried driver steps in the next frame", num_pulses);
+  check(FLEXIO3_SHIFTBUF5 == 0, "driver dir held between frames", FLEXIO3_SHIFTBUF5);
+  output_b.transmit_frame();
+  check(FLEXIO3_SHIFTBUF1 == 0, "no driver steps left", FLEXIO3_SHIFTBUF1);
+
+  output_b.set_output_format(OUTPUT_FORMAT_STEPDANCE);
+}
+
+int main(){
+  output_a.begin(OUTPUT_A);
+  output_b.begin(OUTPUT_B);
+  output_c.begin(OUTPUT_C, OUTPUT_FRAME_32US, OUTPUT_TRANSMIT_MANUAL);
+
+  test_lookahead_ring();
+  test_encode();
+  test_encode_driver();
+
+  printf("%u checks, %u failed\n", num_checks, num_failures);
+  printf(num_failures ? "FAILED\n" : "PASSED\n");
+  return num_failures ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+/*
+Output Tap Test
+
+This example sketch captures every frame transmitted on an output port, and streams
+the captured frames over the second USB serial port.
+
+Press the button on IO D1 to start a capture and move four signals by a known number of steps.
+Record the capture on the host, and then decode it:
+
+  python rpc/frame_tap.py capture /dev/ttyACM1 capture.bin 5
+  python rpc/frame_tap.py decode capture.bin
+
+The decoder should report 1000 steps on each of X, Y, Z, and E, with no lost frames and no errors.
+Captures from two versions of a sketch can be compared with "python rpc/frame_tap.py diff A.bin B.bin".
+
+The Teensy must be compiled with a USB Type of "Dual Serial" for SerialUSB1 to be available.
+
+Example project for the Stepdance control system.
+
+A part of the Mixing Metaphors Project
+
+// (c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#define module_basic   // tells compiler we're using the Stepdance Basic Module PCB
+                        // This configures pin assignments for the Teensy 4.1
+
+#include "stepdance.hpp"  // Import the stepdance library
+
+// -- Define Output Ports --
+// Output ports generate step and direction electrical signals
+
+OutputPort output_a;
+
+// -- Define Motion Channels --
+// Channels track target positions and interface with output ports
+
+Channel channel_x;
+Channel channel_y;
+Channel channel_z;
+Channel channel_e;
+
+// -- Frame Tap --
+// Captures the frames transmitted on output_a
+
+OutputFrameTap tap_a;
+
+// -- Button to trigger test --
+Button button_d1;
+
+void setup() {
+  // -- Configure and start the output port --
+  output_a.begin(OUTPUT_A, OUTPUT_FRAME_32US, OUTPUT_TRANSMIT_ON_FRAME);
+
+  // -- Configure and start the channels --
+  channel_x.begin(&output_a, SIGNAL_X);
+  channel_y.begin(&output_a, SIGNAL_Y);
+  channel_z.begin(&output_a, SIGNAL_Z);
+  channel_e.begin(&output_a, SIGNAL_E);
+
+  // -- Configure the frame tap --
+  SerialUSB1.begin(115200);
+  tap_a.begin(&output_a, &SerialUSB1);
+
+  button_d1.begin(IO_D1, INPUT_PULLDOWN);
+  button_d1.set_mode(BUTTON_MODE_STANDARD);
+  button_d1.set_callback_on_press(&button_press);
+
+  // -- Start Serial Port --
+  Serial.begin(115200);
+
+  // -- Start the stepdance library --
+  // This activates the system.
+  dance_start();
+}
+
+LoopDelay report;
+
+void loop() {
+  dance_loop(); // Stepdance loop
+  report.periodic_call(&report_tap, 500);
+}
+
+void button_press(){
+  tap_a.start();
+  channel_x.input_target_position.write(1000, INCREMENTAL);
+  channel_y.input_target_position.write(-1000, INCREMENTAL);
+  channel_z.input_target_position.write(1000, INCREMENTAL);
+  channel_e.input_target_position.write(-1000, INCREMENTAL);
+}
+
+void report_tap(){
+  Serial.print("Frames Captured: ");
+  Serial.print(tap_a.frames_captured);
+  Serial.print(", Frames Lost: ");
+  Serial.println(tap_a.frames_lost);
+}
@@ -129,9 +129,19 @@ void InputPort::begin(uint8_t port_number){
   output_t.begin(&position_t);
   output_z.begin(&position_z);
   output_e.begin(&position_e);
+  output_velocity_x.begin(&velocity_x);
+  output_velocity_y.begin(&velocity_y);
+  output_velocity_r.begin(&velocity_r);
+  output_velocity_t.begin(&velocity_t);
+  output_velocity_z.begin(&velocity_z);
+  output_velocity_e.begin(&velocity_e);
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    last_pulse_directions[signal_index] = 0;
+  }
 
   // start with all signals enabled
   enable_all_signals();
+  reset_statistics();
 
   // configure teensy pins
   pinMode(port_info[port_number].STEP_TEENSY_PIN, INPUT);
@@ -228,15 +238,38 @@ void InputPort::begin(uint8_t port_number){
 }
 
 void InputPort::run(){
+  // decode all pulses captured since the last frame
+  uint32_t decode_entry_cycle_count = ARM_DWT_CYCCNT;
+  uint8_t write_index = event_fifo_write_index;
+  uint8_t read_index = event_fifo_read_index;
+  while(read_index != write_index){
+    decode_pulse(event_fifo[read_index].pulse_width_count, event_fifo[read_index].dir, event_fifo[read_index].capture_cycle_count);
+    read_index = (read_index + 1) & (INPUT_EVENT_FIFO_SIZE - 1);
+  }
+  event_fifo_read_index = read_index;
+  uint32_t decode_cycles = ARM_DWT_CYCCNT - decode_entry_cycle_count;
+  if(decode_cycles > max_decode_cycles){
+    max_decode_cycles = decode_cycles;
+  }
+
+  decay_velocities();
+
   // iterate over all outputs
   for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
     signal_BlockPort_targets[signal_index]->reverse_update(); //updates the buffers from the positional target
     signal_BlockPort_targets[signal_index]->push(); //pushes results
+    signal_velocity_BlockPort_targets[signal_index]->reverse_update();
+    signal_velocity_BlockPort_targets[signal_index]->push();
   }
 }
 
 void InputPort::isr(){
-  // uint32_t interrupt_entry_cycle_count = ARM_DWT_CYCCNT; //UNCOMMENT FOR INSTRUMENTATION
+  // The pulse is timestamped from the FlexPWM capture of its rising edge, so interrupt latency doesn't add jitter to the
+  // velocity estimate. The 16-bit capture is turned into a CPU cycle count by reading the running FlexPWM counter and the
+  // cycle counter together on entry, and stepping back by the counts that have passed since the edge.
+  uint32_t interrupt_entry_cycle_count = ARM_DWT_CYCCNT;
+  uint16_t counter_now = FLEXPWM->SM[SUBMODULE].CNT;
+  uint16_t rising_edge_count = 0;
   // read the direction pin
   int8_t dir = digitalReadFast(port_info[port_number].DIR_TEENSY_PIN);
   if(dir == 0){
@@ -251,35 +284,168 @@ void InputPort::isr(){
     //   break;
     case FLEXPWM_CHANNEL_A:
       FLEXPWM->SM[SUBMODULE].STS = FLEXPWM_SMSTS_CFA1;
-      last_pulse_width_count = FLEXPWM->SM[SUBMODULE].CVAL3 - FLEXPWM->SM[SUBMODULE].CVAL2;
+      rising_edge_count = FLEXPWM->SM[SUBMODULE].CVAL2;
+      last_pulse_width_count = FLEXPWM->SM[SUBMODULE].CVAL3 - rising_edge_count;
       break;
     case FLEXPWM_CHANNEL_B:
       FLEXPWM->SM[SUBMODULE].STS = FLEXPWM_SMSTS_CFB1;
-      last_pulse_width_count = FLEXPWM->SM[SUBMODULE].CVAL5 - FLEXPWM->SM[SUBMODULE].CVAL4;
+      rising_edge_count = FLEXPWM->SM[SUBMODULE].CVAL4;
+      last_pulse_width_count = FLEXPWM->SM[SUBMODULE].CVAL5 - rising_edge_count;
       break;
   }
+  // the counter runs the full 16 bits, so the subtraction wraps correctly for edges up to 437us ago
+  uint16_t counts_since_edge = counter_now - rising_edge_count;
+  uint32_t capture_cycle_count = interrupt_entry_cycle_count - (uint32_t)(counts_since_edge * INPUT_CYCLES_PER_FLEXPWM_COUNT);
+
+  // -- Queue the pulse for decoding in the frame --
+  uint8_t write_index = event_fifo_write_index;
+  uint8_t next_write_index = (write_index + 1) & (INPUT_EVENT_FIFO_SIZE - 1);
+  if(next_write_index == event_fifo_read_index){
+    event_fifo_overflows ++;
+  }else{
+    event_fifo[write_index].capture_cycle_count = capture_cycle_count;
+    event_fifo[write_index].pulse_width_count = last_pulse_width_count;
+    event_fifo[write_index].dir = dir;
+    event_fifo_write_index = next_write_index;
+  }
+
+  input_interrupt_cycles = ARM_DWT_CYCCNT - interrupt_entry_cycle_count;
+  if(input_interrupt_cycles > max_input_interrupt_cycles){
+    max_input_interrupt_cycles = input_interrupt_cycles;
+  }
+}
+
+void InputPort::decode_pulse(uint16_t pulse_width_count, int8_t dir, uint32_t capture_cycle_count){
+  // record the width
+  uint16_t histogram_bin = pulse_width_count / INPUT_HISTOGRAM_BIN_COUNTS;
+  if(histogram_bin >= INPUT_HISTOGRAM_NUM_BINS){
+    histogram_bin = INPUT_HISTOGRAM_NUM_BINS - 1;
+  }
+  width_histogram[histogram_bin] ++;
+
   // -- Route signals --
   // Calculate nearest whole pulse width
-  uint16_t last_pulse_width_whole_us = last_pulse_width_count / FLEXPWM_CLOCK_MHZ;
-  uint8_t last_pulse_width_remainder_count = last_pulse_width_count % FLEXPWM_CLOCK_MHZ;
+  uint16_t last_pulse_width_whole_us = pulse_width_count / FLEXPWM_CLOCK_MHZ;
+  uint8_t last_pulse_width_remainder_count = pulse_width_count % FLEXPWM_CLOCK_MHZ;
   if(last_pulse_width_remainder_count > (FLEXPWM_CLOCK_MHZ / 2)){
     last_pulse_width_whole_us ++;
   }
+  // Flag widths that are close to rounding the other way
+  if((last_pulse_width_remainder_count > (FLEXPWM_CLOCK_MHZ / 2) - INPUT_MARGINAL_WIDTH_COUNTS) && 
+     (last_pulse_width_remainder_count < (FLEXPWM_CLOCK_MHZ / 2) + INPUT_MARGINAL_WIDTH_COUNTS)){
+    marginal_count ++;
+  }
   // Convert into signal index
   uint8_t last_signal_index = last_pulse_width_whole_us - SIGNAL_MIN_WIDTH_US;
 
   if((last_signal_index >= SIGNAL_X) && (last_signal_index <= SIGNAL_E)){ // check if signal index within range
     if(signal_enable_flags[last_signal_index]){ // check if signal is enabled
       *(signal_BlockPort_targets[last_signal_index]->target) += dir; // increment or decrement based on direction
+      signal_pulse_counts[last_signal_index] ++;
+      estimate_velocity(last_signal_index, capture_cycle_count, dir);
+    }else{
+      disabled_count ++;
+    }
+  }else{
+    out_of_range_count ++;
+  }
+}
+
+// -- VELOCITY ESTIMATION --
+
+void InputPort::estimate_velocity(uint8_t signal_index, uint32_t capture_cycle_count, int8_t dir){
+  // The instantaneous velocity is one pulse over the time since the last pulse. This is low-pass filtered, with a weight
+  // that grows with the pulse interval so that the time constant is the same at any pulse rate.
+  if(last_pulse_directions[signal_index] == dir){
+    float32_t interval_cycles = static_cast<float32_t>(capture_cycle_count - last_pulse_cycle_counts[signal_index]);
+    if(interval_cycles > 0){
+      float32_t pulse_velocity = static_cast<float32_t>(dir) * static_cast<float32_t>(F_CPU) / interval_cycles;
+      float32_t filter_weight = interval_cycles / (velocity_time_constant_cycles + interval_cycles);
+      *(signal_velocity_BlockPort_targets[signal_index]->target) += filter_weight * (pulse_velocity - *(signal_velocity_BlockPort_targets[signal_index]->target));
+    }
+  }else{ // first pulse, or a change in direction. We can't know the velocity until the next pulse.
+    *(signal_velocity_BlockPort_targets[signal_index]->target) = 0;
+  }
+  last_pulse_cycle_counts[signal_index] = capture_cycle_count;
+  last_pulse_directions[signal_index] = dir;
+}
+
+void InputPort::decay_velocities(){
+  // If no pulse has arrived for longer than the current pulse interval, the signal must be moving slower than the estimate.
+  // We cap the estimate at one pulse over the time elapsed, so that it falls smoothly to zero when pulses stop.
+  uint32_t now_cycle_count = ARM_DWT_CYCCNT;
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    if(last_pulse_directions[signal_index] == 0){
+      continue;
     }
+    float32_t elapsed_cycles = static_cast<float32_t>(now_cycle_count - last_pulse_cycle_counts[signal_index]);
+    if(elapsed_cycles > INPUT_VELOCITY_TIMEOUT_S * F_CPU){
+      *(signal_velocity_BlockPort_targets[signal_index]->target) = 0;
+      last_pulse_directions[signal_index] = 0;
+      continue;
+    }
+    float32_t max_speed = static_cast<float32_t>(F_CPU) / elapsed_cycles;
+    DecimalPosition* velocity = signal_velocity_BlockPort_targets[signal_index]->target;
+    if(*velocity > max_speed){
+      *velocity = max_speed;
+    }else if(*velocity < -max_speed){
+      *velocity = -max_speed;
+    }
+  }
+}
+
+void InputPort::set_velocity_time_constant(float32_t time_constant_s){
+  velocity_time_constant_cycles = time_constant_s * F_CPU;
+}
+
+// -- SIGNAL STATISTICS --
+
+uint32_t InputPort::read_pulse_count(uint8_t signal_index){
+  if(signal_index >= NUM_SIGNALS){
+    return 0;
+  }
+  return signal_pulse_counts[signal_index];
+}
+
+uint32_t InputPort::read_out_of_range_count(){
+  return out_of_range_count;
+}
+
+uint32_t InputPort::read_disabled_count(){
+  return disabled_count;
+}
+
+uint32_t InputPort::read_marginal_count(){
+  return marginal_count;
+}
+
+uint32_t InputPort::read_histogram_bin(uint8_t bin_index){
+  if(bin_index >= INPUT_HISTOGRAM_NUM_BINS){
+    return 0;
+  }
+  return width_histogram[bin_index];
+}
+
+void InputPort::reset_statistics(){
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    signal_pulse_counts[signal_index] = 0;
+  }
+  for(uint8_t bin_index = 0; bin_index < INPUT_HISTOGRAM_NUM_BINS; bin_index++){
+    width_histogram[bin_index] = 0;
   }
-  // input_interrupt_cycles = ARM_DWT_CYCCNT - interrupt_entry_cycle_count;
+  out_of_range_count = 0;
+  disabled_count = 0;
+  marginal_count = 0;
+  event_fifo_overflows = 0;
+  max_input_interrupt_cycles = 0;
+  max_decode_cycles = 0;
 }
 
 void InputPort::set_ratio(float output_units, float input_units){
   // sets ratios for ALL input signals.
   for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
     signal_BlockPort_targets[signal_index]->set_ratio(output_units, input_units);
+    signal_velocity_BlockPort_targets[signal_index]->set_ratio(output_units, input_units);
   }  
 }
 
@@ -309,10 +475,26 @@ void InputPort::enroll(RPC *rpc, const String& instance_name){
   rpc->enroll(instance_name, "enable_signal", *this, &InputPort::enable_signal);
   rpc->enroll(instance_name, "disable_signal", *this, &InputPort::disable_signal);
   rpc->enroll(instance_name, "set_ratio", *this, &InputPort::set_ratio);
+  rpc->enroll(instance_name, "read_pulse_count", *this, &InputPort::read_pulse_count);
+  rpc->enroll(instance_name, "read_out_of_range_count", *this, &InputPort::read_out_of_range_count);
+  rpc->enroll(instance_name, "read_disabled_count", *this, &InputPort::read_disabled_count);
+  rpc->enroll(instance_name, "read_marginal_count", *this, &InputPort::read_marginal_count);
+  rpc->enroll(instance_name, "read_histogram_bin", *this, &InputPort::read_histogram_bin);
+  rpc->enroll(instance_name, "reset_statistics", *this, &InputPort::reset_statistics);
+  rpc->enroll(instance_name + ".max_input_interrupt_cycles", max_input_interrupt_cycles);
+  rpc->enroll(instance_name + ".max_decode_cycles", max_decode_cycles);
+  rpc->enroll(instance_name + ".event_fifo_overflows", event_fifo_overflows);
   output_x.enroll(rpc, instance_name + ".output_x");
   output_y.enroll(rpc, instance_name + ".output_y");
   output_r.enroll(rpc, instance_name + ".output_r");
   output_t.enroll(rpc, instance_name + ".output_t");
   output_z.enroll(rpc, instance_name + ".output_z");
   output_e.enroll(rpc, instance_name + ".output_e");
+  rpc->enroll(instance_name, "set_velocity_time_constant", *this, &InputPort::set_velocity_time_constant);
+  output_velocity_x.enroll(rpc, instance_name + ".output_velocity_x");
+  output_velocity_y.enroll(rpc, instance_name + ".output_velocity_y");
+  output_velocity_r.enroll(rpc, instance_name + ".output_velocity_r");
+  output_velocity_t.enroll(rpc, instance_name + ".output_velocity_t");
+  output_velocity_z.enroll(rpc, instance_name + ".output_velocity_z");
+  output_velocity_e.enroll(rpc, instance_name + ".output_velocity_e");
 }
\ No newline at end of file
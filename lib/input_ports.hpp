@@ -29,13 +29,32 @@ A part of the Mixing Metaphors Project
 #define FLEXPWM_CHANNEL_B   2
 
 #define FLEXPWM_CLOCK_MHZ 150
+// CPU cycles per FlexPWM count, for timestamping captures. Worked out in float from the running CPU clock, since that needn't
+// be a whole multiple of FLEXPWM_CLOCK_MHZ (e.g. 528 MHz gives 3.52 cycles per count).
+#define INPUT_CYCLES_PER_FLEXPWM_COUNT ((float32_t)F_CPU_ACTUAL / (FLEXPWM_CLOCK_MHZ * 1000000.0f))
 
 #define SIGNAL_MIN_WIDTH_US 2 //standard input format
 
+#define INPUT_MARGINAL_WIDTH_COUNTS 15 //pulses within this many FlexPWM counts (0.1us) of a rounding boundary are counted as marginal
+#define INPUT_HISTOGRAM_BIN_COUNTS 30 //width of each histogram bin, in FlexPWM counts (0.2us)
+#define INPUT_HISTOGRAM_NUM_BINS 64 //covers pulses up to 12.8us. Longer pulses go in the last bin.
+
+#define INPUT_VELOCITY_TIMEOUT_S 0.1 //velocity estimates fall to zero when no pulse arrives for this long
+#define INPUT_VELOCITY_TIME_CONSTANT_S 0.002 //default smoothing of the velocity estimate
+
+#define INPUT_EVENT_FIFO_SIZE 64 //captured pulses buffered between the capture ISR and the frame. Must be a power of 2.
+                                 //At full rate, six signals produce about six pulses per frame.
+
 /** \cond */
   /**
-   * This struct will be hidden from Doxygen documentation.
+   * These structs will be hidden from Doxygen documentation.
    */
+struct input_event_struct{ //a captured pulse, waiting to be decoded
+  uint32_t capture_cycle_count; //ARM_DWT_CYCCNT at the rising edge of the pulse, from the FlexPWM capture
+  uint16_t pulse_width_count; //pulse width in FlexPWM counts
+  int8_t dir; //1 or -1
+};
+
 struct input_port_info_struct{ //we use this structure to store hardware-specific information for each available port
     // Physical IO
   uint8_t STEP_TEENSY_PIN; //TEENSY Pin #s
@@ -58,7 +77,7 @@ struct input_port_info_struct{ //we use this structure to store hardware-specifi
  * @brief InputPort components receive motion streams on physical Stepdance input ports, and map these signals to downstream components. 
  * @ingroup io
  *
- * Receiving and decoding of input streams occurs asynchronously.
+ * Pulses are captured asynchronously by an interrupt, and decoded in a batch at the start of each frame.
  * Here's an example of how to instantiate and configure an InputPort and map it to an OutputPort:
  * @snippet snippets.cpp InputPort
  */
@@ -102,6 +121,40 @@ class InputPort : public Plugin{
       * @param input_units Number of input units. Default is 1.
       */    
     void set_ratio(float output_units, float input_units = 1.0); 
+        /** 
+      * @brief Sets the smoothing applied to the velocity outputs.
+      * @param time_constant_s Time constant of the low-pass filter, in seconds. Larger values give smoother but slower estimates.
+      */    
+    void set_velocity_time_constant(float32_t time_constant_s);
+
+    // -- SIGNAL STATISTICS --
+    // These help to spot marginal cabling or clock drift between chained modules before steps start to go missing.
+    /** 
+     * @brief Returns the number of pulses decoded on a signal since the last reset.
+     * @param signal_index Index of the signal (SIGNAL_X, SIGNAL_Y, SIGNAL_Z,  SIGNAL_E, SIGNAL_R, SIGNAL_T).
+     */
+    uint32_t read_pulse_count(uint8_t signal_index);
+    /** 
+     * @brief Returns the number of pulses whose width didn't match any signal.
+     */
+    uint32_t read_out_of_range_count();
+    /** 
+     * @brief Returns the number of pulses that were ignored because their signal is disabled.
+     */
+    uint32_t read_disabled_count();
+    /** 
+     * @brief Returns the number of pulses whose width was close to the boundary between two signals.
+     */
+    uint32_t read_marginal_count();
+    /** 
+     * @brief Returns the number of pulses in a bin of the pulse width histogram. Each bin is INPUT_HISTOGRAM_BIN_COUNTS FlexPWM counts wide.
+     * @param bin_index Index of the bin, from 0 to INPUT_HISTOGRAM_NUM_BINS - 1.
+     */
+    uint32_t read_histogram_bin(uint8_t bin_index);
+    /** 
+     * @brief Resets all signal statistics, along with the event FIFO overflow count and interrupt timing measurements.
+     */
+    void reset_statistics();
    /** \cond */
   /**
    * This method and property will be hidden from Doxygen documentation.
@@ -109,6 +162,9 @@ class InputPort : public Plugin{
     void enroll(RPC *rpc, const String& instance_name);
 
     volatile uint32_t input_interrupt_cycles; //measures the number of cycles spent in each input interrupt routine.
+    volatile uint32_t max_input_interrupt_cycles = 0; //longest input interrupt, in CPU cycles
+    volatile uint32_t max_decode_cycles = 0; //longest time spent decoding events in one frame, in CPU cycles
+    volatile uint32_t event_fifo_overflows = 0; //captured pulses that were lost because the event FIFO was full
 /** \endcond */
     
     // BlockPorts
@@ -142,6 +198,34 @@ inputA.output_x.map(channelX.input_target_position); // Map SIGNAL_X to Channel
      */
     BlockPort output_e; // 7us signal
 
+    // Velocity BlockPorts
+    // Velocities are estimated from the time between pulses, and are in the same units as the position outputs, per second.
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_X input, in units per second.
+     * The estimate is filtered (see set_velocity_time_constant()), and falls to zero within INPUT_VELOCITY_TIMEOUT_S when pulses stop.
+     */
+    BlockPort output_velocity_x;
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_Y input, in units per second.
+     */
+    BlockPort output_velocity_y;
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_R input, in units per second.
+     */
+    BlockPort output_velocity_r;
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_T input, in units per second.
+     */
+    BlockPort output_velocity_t;
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_Z input, in units per second.
+     */
+    BlockPort output_velocity_z;
+    /**
+     * @brief BlockPort that outputs the estimated velocity of the SIGNAL_E input, in units per second.
+     */
+    BlockPort output_velocity_e;
+
   
 
 
@@ -158,12 +242,36 @@ inputA.output_x.map(channelX.input_target_position); // Map SIGNAL_X to Channel
     // The following variables are used within the pulse detection and routing ISR, but we declare them here to save ISR run time.
     volatile uint16_t last_pulse_width_count; //important that this is UINT16_T to calculate rollover correctly.
 
+    // Event FIFO
+    // The capture ISR only records each pulse. Pulses are decoded and applied to the output positions in run(), so that
+    // the positions only ever change within the frame, and the ISR stays short. There is a single producer (the ISR) and
+    // a single consumer (the frame), so no locking is needed.
+    volatile struct input_event_struct event_fifo[INPUT_EVENT_FIFO_SIZE];
+    volatile uint8_t event_fifo_write_index = 0; //written by the ISR
+    volatile uint8_t event_fifo_read_index = 0; //written by run()
+
     // State Parameters
     BlockPort *signal_BlockPort_targets[NUM_SIGNALS] = {&output_x, &output_y, &output_r, &output_t, &output_z, &output_e}; //pointers to BlockPorts, indexed by signal number
+    BlockPort *signal_velocity_BlockPort_targets[NUM_SIGNALS] = {&output_velocity_x, &output_velocity_y, &output_velocity_r, &output_velocity_t, &output_velocity_z, &output_velocity_e};
     bool signal_enable_flags[NUM_SIGNALS] = {true, true, true};
 
+    // Velocity Estimation
+    uint32_t last_pulse_cycle_counts[NUM_SIGNALS]; //capture time of the last pulse on each signal
+    int8_t last_pulse_directions[NUM_SIGNALS]; //direction of the last pulse on each signal. 0 if there is no recent pulse.
+    float32_t velocity_time_constant_cycles = INPUT_VELOCITY_TIME_CONSTANT_S * F_CPU;
+    void estimate_velocity(uint8_t signal_index, uint32_t capture_cycle_count, int8_t dir); //updates the velocity estimate with a new pulse
+    void decay_velocities(); //limits velocity estimates by the time since the last pulse
+
+    // Signal Statistics
+    volatile uint32_t signal_pulse_counts[NUM_SIGNALS]; //decoded pulses, by signal
+    volatile uint32_t out_of_range_count = 0; //pulses too short or too long to be any signal
+    volatile uint32_t disabled_count = 0; //pulses on disabled signals
+    volatile uint32_t marginal_count = 0; //pulses close to a rounding boundary
+    volatile uint32_t width_histogram[INPUT_HISTOGRAM_NUM_BINS]; //pulse widths, binned in FlexPWM counts
+
     // Private Methods
     void isr(); //this is the actual ISR function
+    void decode_pulse(uint16_t pulse_width_count, int8_t dir, uint32_t capture_cycle_count); //converts a pulse width into a signal, and applies it
     static void input_A_isr();
     static void input_B_isr();
     static void input_C_isr();
@@ -180,6 +288,14 @@ inputA.output_x.map(channelX.input_target_position); // Map SIGNAL_X to Channel
     DecimalPosition position_z;
     DecimalPosition position_e;
 
+    // Input Velocity Registers, in pulses per second
+    DecimalPosition velocity_x;
+    DecimalPosition velocity_y;
+    DecimalPosition velocity_r;
+    DecimalPosition velocity_t;
+    DecimalPosition velocity_z;
+    DecimalPosition velocity_e;
+
   protected:
   /** \cond */
   /**
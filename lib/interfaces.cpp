@@ -26,6 +26,8 @@ A part of the Mixing Metaphors Project
 
 #include "interfaces.hpp"
 #include "interpolators.hpp"
+#include "recording.hpp"
+#include "rpc.hpp"
 
 #define EBB_INPUT_IDLE 0 //waiting on a new line
 #define EBB_INPUT_IN_COMMAND 1 //reading the one or two-character command
@@ -34,8 +36,12 @@ A part of the Mixing Metaphors Project
 // DEFINE ALL COMMANDS
 // We put high-frequency commands such as "SM" first, to improve search time.
 struct Eibotboard::command Eibotboard::all_commands[] = {
-  {.command_string = "SM", .command_function = &Eibotboard::command_stepper_move, .execution = EBB_EXECUTE_TO_QUEUE},
-  {.command_string = "SP", .command_function = &Eibotboard::command_set_pen, .execution = EBB_EXECUTE_TO_QUEUE},
+  {.command_string = "SM", .command_function = &Eibotboard::command_stepper_move, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 1},
+  {.command_string = "LM", .command_function = &Eibotboard::command_low_level_move, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 6},
+  {.command_string = "LT", .command_function = &Eibotboard::command_low_level_time, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 5},
+  {.command_string = "XM", .command_function = &Eibotboard::command_mixed_axis_move, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 3},
+  {.command_string = "HM", .command_function = &Eibotboard::command_home_move, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 1, .check_function = &Eibotboard::check_home_move},
+  {.command_string = "SP", .command_function = &Eibotboard::command_set_pen, .execution = EBB_EXECUTE_TO_QUEUE, .min_parameters = 1},
   {.command_string = "V", .command_function = &Eibotboard::command_version, .execution = EBB_EXECUTE_IMMEDIATE}, //Version Query
   {.command_string = "QC", .command_function = &Eibotboard::command_query_current, .execution = EBB_EXECUTE_IMMEDIATE},
   {.command_string = "QB", .command_function = &Eibotboard::command_query_button, .execution = EBB_EXECUTE_IMMEDIATE},
@@ -53,12 +59,17 @@ void Eibotboard::begin(){
 
 void Eibotboard::begin(usb_serial_class *target_usb_serial){
   target_usb_serial -> begin(115200);
+  begin((Stream*)target_usb_serial);
+}
+
+void Eibotboard::begin(Stream *target_stream){
   reset_input_buffer();
   initialize_all_commands_struct();
-  ebb_serial_port = target_usb_serial;
+  ebb_serial_port = target_stream;
   debug_serial_port = &SerialNone; //dummy function for now
   register_plugin(PLUGIN_LOOP);
   target_interpolator.begin();
+  reset_latency_statistics();
 }
 
 void Eibotboard::set_ratio_xy(float output_units_mm, float input_units_steps){
@@ -90,8 +101,14 @@ void Eibotboard::loop(){
   // }else{
     if(block_pending_flag){ // if a block is pending, call that function first
       (this->*pending_block_function)();
+      if(block_pending_flag == 0){
+        record_latency(EBB_LATENCY_QUEUED_TO_INTERPOLATOR, executing_command_receipt_time_us);
+      }
+    }
+    if(input_line_waiting){
+      process_input_line();
     }
-    while(ebb_serial_port->available() > 0){
+    while((ebb_serial_port->available() > 0) && !input_line_waiting){
       uint8_t character = ebb_serial_port->read();
       debug_serial_port->write(character);
       if(character == 13){ //carriage return, let's add a new line for debugging
@@ -99,14 +116,16 @@ void Eibotboard::loop(){
       }
       process_character(character);
     }
+    run_command_ring();
+    release_held_command();
   // }
 }
 
 void Eibotboard::process_character(uint8_t character){
   if(character == 13){ //carriage return; done receiving the entire command string
     input_buffer[input_buffer_write_index] = 0; //indicate end of string
-    process_command(input_command_value); //process the command
-    reset_input_buffer();
+    input_line_receipt_time_us = micros();
+    process_input_line();
 
   }else{ //still in command
     if(input_state == EBB_INPUT_IDLE){ //if this is the first character, mark that we're now receiving the command
@@ -126,22 +145,132 @@ void Eibotboard::process_character(uint8_t character){
   }
 }
 
-void Eibotboard::process_command(uint16_t command_value){
-  // Find and call the command.
+void Eibotboard::process_input_line(){
+  if(process_command(input_command_value, input_line_receipt_time_us)){
+    input_line_waiting = false;
+    reset_input_buffer();
+  }else{ //left in the input buffer until there's room
+    input_line_waiting = true;
+  }
+}
+
+bool Eibotboard::process_command(uint16_t command_value, uint32_t receipt_time_us){
+  // Find the command, and either run it now or add it to the command ring.
   uint8_t num_commands = sizeof(Eibotboard::all_commands) / sizeof(Eibotboard::all_commands[0]);
   for(uint8_t command_index = 0; command_index < num_commands; command_index++){ //iterate over all commands
-    if(command_value == Eibotboard::all_commands[command_index].command_value){
-      if((block_pending_flag == 0) || (Eibotboard::all_commands[command_index].execution == EBB_EXECUTE_EMERGENCY)){
-        //we run the command if either nothing is waiting to get into the queue, or the command will execute immediately under emergency status
-        (this->*all_commands[command_index].command_function)(); //call the function
-        return;
-      }else{ //a block is pending and it is not an emergency, so we'll ignore the command
-        return;
+    struct command *found_command = &Eibotboard::all_commands[command_index];
+    if(command_value == found_command->command_value){
+      if(found_command->execution == EBB_EXECUTE_TO_QUEUE){
+        if(command_held){ //the ring is full, and there's already a command waiting on it
+          return false;
+        }
+        process_string_int32(); //parse string into integers in input_parameters
+        if(num_input_parameters < found_command->min_parameters){
+          ebb_serial_port->print("!8 Err: Missing parameter(s)\r\n");
+          return true;
+        }
+        if(found_command->check_function && !(this->*found_command->check_function)()){ //rejected before it's acknowledged
+          return true;
+        }
+        queue_command(command_index, receipt_time_us);
+      }else{ //immediate and emergency commands don't wait behind queued commands
+        process_string_int32();
+        (this->*found_command->command_function)(); //call the function
+        record_latency(EBB_LATENCY_IMMEDIATE, receipt_time_us);
       }
+      return true;
     }   
   }
   // didn't find the requested command
   command_generic();
+  record_latency(EBB_LATENCY_IMMEDIATE, receipt_time_us);
+  return true;
+}
+
+void Eibotboard::queue_command(uint8_t command_index, uint32_t receipt_time_us){
+  struct queued_command new_command;
+  new_command.command_index = command_index;
+  new_command.num_parameters = num_input_parameters;
+  memcpy(new_command.parameters, input_parameters, sizeof(input_parameters));
+  new_command.receipt_time_us = receipt_time_us;
+  if(command_ring_count < EBB_COMMAND_RING_SIZE){
+    add_to_command_ring(&new_command);
+  }else{ //acknowledged once it's in the ring
+    held_command = new_command;
+    command_held = true;
+  }
+}
+
+void Eibotboard::add_to_command_ring(struct queued_command* new_command){
+  command_ring[command_ring_write_index] = *new_command;
+  command_ring_write_index = (command_ring_write_index + 1) % EBB_COMMAND_RING_SIZE;
+  command_ring_count ++;
+  ebb_serial_port->print("OK\r\n");
+  record_latency(EBB_LATENCY_QUEUED, new_command->receipt_time_us);
+}
+
+void Eibotboard::release_held_command(){
+  if(command_held && (command_ring_count < EBB_COMMAND_RING_SIZE)){
+    add_to_command_ring(&held_command);
+    command_held = false;
+  }
+}
+
+void Eibotboard::run_command_ring(){
+  while((block_pending_flag == 0) && (command_ring_count > 0)){
+    struct queued_command *next_command = &command_ring[command_ring_read_index];
+    memcpy(input_parameters, next_command->parameters, sizeof(input_parameters));
+    num_input_parameters = next_command->num_parameters;
+    executing_command_receipt_time_us = next_command->receipt_time_us;
+    uint8_t command_index = next_command->command_index;
+    command_ring_read_index = (command_ring_read_index + 1) % EBB_COMMAND_RING_SIZE;
+    command_ring_count --;
+
+    (this->*all_commands[command_index].command_function)();
+    if(block_pending_flag == 0){ //went straight into the interpolator. Otherwise loop() records it once it does.
+      record_latency(EBB_LATENCY_QUEUED_TO_INTERPOLATOR, executing_command_receipt_time_us);
+    }
+  }
+}
+
+void Eibotboard::record_latency(uint8_t latency_class, uint32_t receipt_time_us){
+  uint32_t latency_us = micros() - receipt_time_us;
+  struct latency_statistics *statistics = &latency_statistics[latency_class];
+  statistics->count ++;
+  statistics->total_us += latency_us;
+  statistics->max_us = std::max(statistics->max_us, latency_us);
+}
+
+float32_t Eibotboard::read_mean_latency_us(uint8_t latency_class){
+  if((latency_class >= EBB_NUM_LATENCY_CLASSES) || (latency_statistics[latency_class].count == 0)){
+    return 0;
+  }
+  return static_cast<float32_t>(latency_statistics[latency_class].total_us) / latency_statistics[latency_class].count;
+}
+
+uint32_t Eibotboard::read_max_latency_us(uint8_t latency_class){
+  if(latency_class >= EBB_NUM_LATENCY_CLASSES){
+    return 0;
+  }
+  return latency_statistics[latency_class].max_us;
+}
+
+uint32_t Eibotboard::read_latency_count(uint8_t latency_class){
+  if(latency_class >= EBB_NUM_LATENCY_CLASSES){
+    return 0;
+  }
+  return latency_statistics[latency_class].count;
+}
+
+void Eibotboard::reset_latency_statistics(){
+  memset(latency_statistics, 0, sizeof(latency_statistics));
+}
+
+void Eibotboard::enroll(RPC *rpc, const String& instance_name){
+  rpc->enroll(instance_name, "read_mean_latency_us", *this, &Eibotboard::read_mean_latency_us);
+  rpc->enroll(instance_name, "read_max_latency_us", *this, &Eibotboard::read_max_latency_us);
+  rpc->enroll(instance_name, "read_latency_count", *this, &Eibotboard::read_latency_count);
+  rpc->enroll(instance_name, "reset_latency_statistics", *this, &Eibotboard::reset_latency_statistics);
 }
 
 void Eibotboard::process_string_int32(){
@@ -217,7 +346,6 @@ void Eibotboard::set_servo_rate(uint16_t pulse_rate_us_per_ms, float *servo_rate
 }
 
 void Eibotboard::command_stepper_servo_configure(){
-  process_string_int32(); //parse string into integers in input_parameters
   uint8_t parameter_index = static_cast<uint8_t>(input_parameters[0]);
   uint16_t parameter_value = static_cast<uint16_t>(input_parameters[1]);
   switch(parameter_index){
@@ -246,7 +374,6 @@ void Eibotboard::command_set_pen(){
   static uint16_t delay_ms = 0;
 
   if(block_pending_flag == 0){ //lets load a position block
-    process_string_int32();
     uint8_t command_value = static_cast<uint8_t>(input_parameters[0]);
     delay_ms = static_cast<uint16_t>(input_parameters[1]);
     
@@ -268,10 +395,9 @@ void Eibotboard::command_set_pen(){
 
     if(move_time_s == 0){
       //we're already in position, do nothing
-      ebb_serial_port->print("OK\r\n");
       return;
     }else{ //load up the pending block
-      pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = 0, .y_mm = 0, .z_mm = servo_delta_steps * z_conversion_mm_per_step, .e_mm = 0, .r_mm = 0, .t_rad = 0}};
+      pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = 0, .y_mm = 0, .z_mm = servo_delta_steps * z_conversion_mm_per_step, .e_mm = 0, .r_mm = 0, .t_rad = 0}, .block_flags = TBI_BLOCK_EXACT_TIMING};
       block_pending_flag = EBB_BLOCK_PENDING;
       pending_block_function = &Eibotboard::command_set_pen; // tag this function as having originated the pending block
     }
@@ -282,14 +408,12 @@ void Eibotboard::command_set_pen(){
 
   if(available_slots >= 0){ //move successfully added
     if(delay_ms == 0){ //we don't need to add a delay
-      ebb_serial_port->print("OK\r\n");
       block_pending_flag = 0; //release the hold on the pending block
       debug_buffer_full_flag = 0;
       debug_serial_port->println("PEN MOVE");
       debug_report_pending_block(false);
     }else{ // a delay was requested
       if(loading_delay_flag){ //the queued move was the delay move
-        ebb_serial_port->print("OK\r\n");
         loading_delay_flag = 0;
         block_pending_flag = 0;
         debug_serial_port->println("PEN DELAY");
@@ -298,7 +422,7 @@ void Eibotboard::command_set_pen(){
         debug_serial_port->println("PEN MOVE");
         debug_report_pending_block(false);
         float move_time_s = static_cast<float>(delay_ms) / 1000;
-        pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = 0, .y_mm = 0, .z_mm = 0, .e_mm = 0, .r_mm = 0, .t_rad = 0}};
+        pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = 0, .y_mm = 0, .z_mm = 0, .e_mm = 0, .r_mm = 0, .t_rad = 0}, .block_flags = TBI_BLOCK_EXACT_TIMING};
         block_pending_flag = EBB_BLOCK_PENDING;
         pending_block_function = &Eibotboard::command_set_pen; // tag this function as having originated the pending block
         loading_delay_flag = 1;       
@@ -308,54 +432,199 @@ void Eibotboard::command_set_pen(){
 }
 
 void Eibotboard::command_stepper_move(){
-  if(block_pending_flag == 0){ //let's load up a block
-    // Step 1:  Convert motion block string into parameters
-    //          These get placed in the input_parameters array
-    process_string_int32();
-
-    // Step 2:  Read in parameters, and set defaults when needed
-    float32_t move_time_ms;
-    float64_t motor_1_delta_steps;
-    float64_t motor_2_delta_steps;
-
-    if(num_input_parameters > 0){
-      move_time_ms = static_cast<float32_t>(input_parameters[0]);
-    }else{
-      return;
-    }
+  // Step 1:  Read in parameters from the input_parameters array, and set defaults when needed
+  float32_t move_time_ms = static_cast<float32_t>(input_parameters[0]);
+  float64_t motor_1_delta_steps;
+  float64_t motor_2_delta_steps;
 
-    if(num_input_parameters > 1){
-      motor_1_delta_steps = static_cast<float64_t>(input_parameters[1]);
-    }else{
-      motor_1_delta_steps = 0.0;
-    }
+  if(num_input_parameters > 1){
+    motor_1_delta_steps = static_cast<float64_t>(input_parameters[1]);
+  }else{
+    motor_1_delta_steps = 0.0;
+  }
 
-    if(num_input_parameters > 2){
-      motor_2_delta_steps = static_cast<float64_t>(input_parameters[2]);
-    }else{
-      motor_2_delta_steps = 0.0;
-    }
+  if(num_input_parameters > 2){
+    motor_2_delta_steps = static_cast<float64_t>(input_parameters[2]);
+  }else{
+    motor_2_delta_steps = 0.0;
+  }
+
+  // Step 2:  Load the move into a motion block, and try adding it to the queue
+  motor_1_position_steps += static_cast<int32_t>(motor_1_delta_steps);
+  motor_2_position_steps += static_cast<int32_t>(motor_2_delta_steps);
+  load_motor_move(move_time_ms / 1000, motor_1_delta_steps, motor_2_delta_steps);
+  queue_pending_move();
+}
+
+void Eibotboard::command_mixed_axis_move(){
+  // 'XM,duration_ms,AxisStepsA,AxisStepsB' moves motor 1 by A+B and motor 2 by A-B
+  float32_t move_time_ms = static_cast<float32_t>(input_parameters[0]);
+  int32_t motor_1_delta_steps = input_parameters[1] + input_parameters[2];
+  int32_t motor_2_delta_steps = input_parameters[1] - input_parameters[2];
+  motor_1_position_steps += motor_1_delta_steps;
+  motor_2_position_steps += motor_2_delta_steps;
+  load_motor_move(move_time_ms / 1000, motor_1_delta_steps, motor_2_delta_steps);
+  queue_pending_move();
+}
 
-    // Step 3: Convert parameters from command space (motor steps, move time in ms) to standard space (xy mm, move time in sec)
-    //          NOTE: We assume an h-bot transform, which we hardcode here rather than use the kinematics module, for simplicity.
-    float32_t move_time_s = move_time_ms / 1000;
-    float64_t motor_1_delta_mm = motor_1_delta_steps * xy_conversion_mm_per_step;
-    float64_t motor_2_delta_mm = motor_2_delta_steps * xy_conversion_mm_per_step;
-    float64_t x_delta_mm = 0.5*(motor_1_delta_mm + motor_2_delta_mm);
-    float64_t y_delta_mm = 0.5*(motor_1_delta_mm - motor_2_delta_mm);
+bool Eibotboard::check_home_move(){
+  if(input_parameters[0] <= 0){ //no speed to move at
+    ebb_serial_port->print("!8 Err: Invalid step frequency\r\n");
+    return false;
+  }
+  return true;
+}
 
-    // Step 4:  Load parameters into a motion block
-    pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = x_delta_mm, .y_mm = y_delta_mm, .z_mm = 0, .e_mm = 0, .r_mm = 0, .t_rad = 0}};
-    block_pending_flag = EBB_BLOCK_PENDING;
-    pending_block_function = &Eibotboard::command_stepper_move; // tag this function as having originated the pending block
+void Eibotboard::command_home_move(){
+  // 'HM,StepFrequency[,Position1,Position2]' moves in a straight line to an absolute step position (home by default), with
+  // the motor that has furthest to go stepping at StepFrequency.
+  if(input_parameters[0] <= 0){ //no speed to move at
+    return;
   }
-  
-  // Step 5:  Try adding the pending block to queue.
+  float32_t step_frequency = static_cast<float32_t>(input_parameters[0]);
+  int32_t motor_1_delta_steps = input_parameters[1] - motor_1_position_steps; //parameters default to 0, i.e. home
+  int32_t motor_2_delta_steps = input_parameters[2] - motor_2_position_steps;
+  uint32_t most_steps = std::max(std::abs(motor_1_delta_steps), std::abs(motor_2_delta_steps));
+  if(most_steps == 0){ //already there
+    return;
+  }
+  motor_1_position_steps += motor_1_delta_steps;
+  motor_2_position_steps += motor_2_delta_steps;
+  load_motor_move(most_steps / step_frequency, motor_1_delta_steps, motor_2_delta_steps);
+  queue_pending_move();
+}
+
+void Eibotboard::command_low_level_move(){
+  // 'LM,Rate1,Steps1,Accel1,Rate2,Steps2,Accel2[,Clear]' moves each motor Steps, starting at Rate and adding Accel to the rate
+  // every tick. The move ends when both motors have finished.
+  float64_t most_ticks = 0;
+  for(uint8_t axis_index = 0; axis_index < 2; axis_index++){
+    struct low_level_axis* axis = &low_level_axes[axis_index];
+    int32_t steps = input_parameters[3 * axis_index + 1];
+    axis->rate_steps_per_tick = static_cast<uint32_t>(input_parameters[3 * axis_index]) / EBB_RATE_SCALE;
+    axis->acceleration_steps_per_tick2 = input_parameters[3 * axis_index + 2] / EBB_RATE_SCALE;
+    axis->step_limit = std::abs(steps);
+    axis->direction = (steps < 0) ? -1 : 1;
+    most_ticks = std::max(most_ticks, low_level_ticks_to_travel(axis->rate_steps_per_tick, axis->acceleration_steps_per_tick2, axis->step_limit));
+  }
+  low_level_move_ticks = static_cast<uint32_t>(std::ceil(most_ticks));
+  // An axis that slows to a stop before reaching its Steps ends at the last whole step it reaches, so we count what it takes.
+  int32_t* motor_position_steps[2] = {&motor_1_position_steps, &motor_2_position_steps};
+  for(uint8_t axis_index = 0; axis_index < 2; axis_index++){
+    struct low_level_axis* axis = &low_level_axes[axis_index];
+    axis->step_limit = std::floor(std::abs(low_level_axis_steps(axis_index, low_level_move_ticks)));
+    *motor_position_steps[axis_index] += axis->direction * static_cast<int32_t>(axis->step_limit);
+  }
+  start_low_level_move();
+}
+
+void Eibotboard::command_low_level_time(){
+  // 'LT,Intervals,Rate1,Accel1,Rate2,Accel2[,Clear]' runs each motor for Intervals ticks, starting at Rate and adding Accel to
+  // the rate every tick. Rates are signed, and give the direction.
+  low_level_move_ticks = static_cast<uint32_t>(input_parameters[0]);
+  int32_t* motor_position_steps[2] = {&motor_1_position_steps, &motor_2_position_steps};
+  for(uint8_t axis_index = 0; axis_index < 2; axis_index++){
+    struct low_level_axis* axis = &low_level_axes[axis_index];
+    int32_t rate = input_parameters[2 * axis_index + 1];
+    axis->direction = (rate < 0) ? -1 : 1;
+    axis->rate_steps_per_tick = std::abs(rate) / EBB_RATE_SCALE;
+    axis->acceleration_steps_per_tick2 = axis->direction * input_parameters[2 * axis_index + 2] / EBB_RATE_SCALE;
+    // The EBB only takes whole steps, so the axis stops at the last whole step it reaches.
+    axis->step_limit = INFINITY;
+    axis->step_limit = std::floor(std::abs(low_level_axis_steps(axis_index, low_level_move_ticks)));
+    *motor_position_steps[axis_index] += axis->direction * static_cast<int32_t>(axis->step_limit);
+  }
+  start_low_level_move();
+}
+
+float64_t Eibotboard::low_level_ticks_to_travel(float64_t rate_steps_per_tick, float64_t acceleration_steps_per_tick2, float64_t steps){
+  // Solves rate * t + acceleration * t * (t - 1) / 2 = steps for t, the sum of the rates over t ticks.
+  if(steps <= 0){
+    return 0;
+  }
+  if(acceleration_steps_per_tick2 == 0){
+    return (rate_steps_per_tick > 0) ? steps / rate_steps_per_tick : 0;
+  }
+  float64_t linear_term = rate_steps_per_tick - 0.5 * acceleration_steps_per_tick2;
+  float64_t discriminant = linear_term * linear_term + 2 * acceleration_steps_per_tick2 * steps;
+  if(discriminant < 0){ //slows to a stop before getting there, so we stop there too
+    return (linear_term > 0) ? -linear_term / acceleration_steps_per_tick2 : 0;
+  }
+  return (-linear_term + std::sqrt(discriminant)) / acceleration_steps_per_tick2;
+}
+
+float64_t Eibotboard::low_level_axis_steps(uint8_t axis_index, uint32_t tick){
+  struct low_level_axis* axis = &low_level_axes[axis_index];
+  float64_t ticks = tick;
+  if(axis->acceleration_steps_per_tick2 < 0){ //an axis that's slowing down doesn't reverse once it stops
+    ticks = std::min(ticks, 0.5 - axis->rate_steps_per_tick / axis->acceleration_steps_per_tick2);
+  }
+  float64_t steps = axis->rate_steps_per_tick * ticks + 0.5 * axis->acceleration_steps_per_tick2 * ticks * (ticks - 1);
+  steps = std::min(std::max(steps, 0.0), axis->step_limit);
+  return axis->direction * steps;
+}
+
+void Eibotboard::start_low_level_move(){
+  if(low_level_move_ticks == 0){ //nothing to do
+    return;
+  }
+  // Moves at a constant rate fit in one block. Ramps are split, but not so finely that they crowd the queue.
+  if((low_level_axes[0].acceleration_steps_per_tick2 == 0) && (low_level_axes[1].acceleration_steps_per_tick2 == 0)){
+    low_level_num_segments = 1;
+  }else{
+    low_level_num_segments = std::min(std::max(low_level_move_ticks / EBB_LOW_LEVEL_SEGMENT_TICKS, (uint32_t)1), (uint32_t)EBB_LOW_LEVEL_MAX_SEGMENTS);
+  }
+  low_level_next_segment = 0;
+  low_level_segment_loaded = false;
+  block_pending_flag = EBB_BLOCK_PENDING;
+  pending_block_function = &Eibotboard::queue_low_level_move;
+  queue_low_level_move();
+}
+
+void Eibotboard::queue_low_level_move(){
+  while(low_level_next_segment < low_level_num_segments){
+    if(!low_level_segment_loaded){
+      // Segments are measured from the start of the move, so that rounding doesn't build up across them.
+      uint32_t start_tick = static_cast<uint64_t>(low_level_move_ticks) * low_level_next_segment / low_level_num_segments;
+      uint32_t end_tick = static_cast<uint64_t>(low_level_move_ticks) * (low_level_next_segment + 1) / low_level_num_segments;
+      float64_t motor_1_delta_steps = low_level_axis_steps(0, end_tick) - low_level_axis_steps(0, start_tick);
+      float64_t motor_2_delta_steps = low_level_axis_steps(1, end_tick) - low_level_axis_steps(1, start_tick);
+      load_motor_move((end_tick - start_tick) * EBB_TICK_S, motor_1_delta_steps, motor_2_delta_steps);
+      low_level_segment_loaded = true;
+    }
+    if(target_interpolator.add_block(&pending_block) < 0){ //queue is full, loop() will call back in to try again
+      if(debug_buffer_full_flag == 0){
+        debug_report_pending_block(true);
+        debug_buffer_full_flag = 1;
+      }
+      return;
+    }
+    debug_buffer_full_flag = 0;
+    debug_report_pending_block(false);
+    low_level_segment_loaded = false;
+    low_level_next_segment ++;
+  }
+  block_pending_flag = 0;
+}
+
+void Eibotboard::load_motor_move(float32_t move_time_s, float64_t motor_1_delta_steps, float64_t motor_2_delta_steps){
+  // Convert from command space (motor steps) to standard space (xy mm)
+  //  NOTE: We assume an h-bot transform, which we hardcode here rather than use the kinematics module, for simplicity.
+  float64_t motor_1_delta_mm = motor_1_delta_steps * xy_conversion_mm_per_step;
+  float64_t motor_2_delta_mm = motor_2_delta_steps * xy_conversion_mm_per_step;
+  float64_t x_delta_mm = 0.5*(motor_1_delta_mm + motor_2_delta_mm);
+  float64_t y_delta_mm = 0.5*(motor_1_delta_mm - motor_2_delta_mm);
+  pending_block = {.block_id = block_id++, .block_time_s = move_time_s, .block_position = {.x_mm = x_delta_mm, .y_mm = y_delta_mm, .z_mm = 0, .e_mm = 0, .r_mm = 0, .t_rad = 0}, .block_flags = TBI_BLOCK_EXACT_TIMING};
+}
+
+void Eibotboard::queue_pending_move(){
+  // Try adding the pending block to queue. If there's no room, loop() calls back in until there is.
+  block_pending_flag = EBB_BLOCK_PENDING;
+  pending_block_function = &Eibotboard::queue_pending_move;
   int16_t available_slots = target_interpolator.add_block(&pending_block);
 
-  // Step 6: Check if block was added, and respond
+  // Check if block was added
   if(available_slots >= 0){ //move successfully added
-    ebb_serial_port->print("OK\r\n");
     block_pending_flag = 0; //release the hold on the pending block
     debug_buffer_full_flag = 0;
     debug_report_pending_block(false);
@@ -363,7 +632,6 @@ void Eibotboard::command_stepper_move(){
     debug_report_pending_block(true);
     debug_buffer_full_flag = 1;
   }
-  //debug
 }
 
 void Eibotboard::command_generic(){
@@ -395,19 +663,6 @@ void Eibotboard::debug_report_pending_block(bool waiting_for_slot){
 }
 
 // ---- GCODE INTERFACE ----
-struct GCodeInterface::code GCodeInterface::all_codes[] = {
-  {.code_string = "G0", .code_function = &GCodeInterface::g0_rapid, .execution = EXECUTE_INTERPOLATOR},
-  {.code_string = "G1", .code_function = &GCodeInterface::g1_move, .execution = EXECUTE_INTERPOLATOR},
-  {.code_string = "$", .code_function = &GCodeInterface::_help, .execution = EXECUTE_NOW},
-  {.code_string = "$$", .code_function = &GCodeInterface::_report_parameters, .execution = EXECUTE_NOW},
-  {.code_string = "\x18", .code_function = &GCodeInterface::_soft_reset, .execution = EXECUTE_NOW},
-  {.code_string = "?", .code_function = &GCodeInterface::_status_report, .execution = EXECUTE_NOW},
-  {.code_string = "~", .code_function = &GCodeInterface::_cycle_start, .execution = EXECUTE_NOW},
-  {.code_string = "!", .code_function = &GCodeInterface::_feed_hold, .execution = EXECUTE_NOW},
-  {.code_string = "$G", .code_function = &GCodeInterface::_parser_state, .execution = EXECUTE_NOW},
-  {.code_string = "G4", .code_function = &GCodeInterface::g4_dwell, .execution = EXECUTE_QUEUE}
-};
-
 GCodeInterface::GCodeInterface(){};
 
 void GCodeInterface::begin(){
@@ -417,6 +672,7 @@ void GCodeInterface::begin(){
 void GCodeInterface::begin(Stream *target_stream){
   this->gcode_stream = target_stream; //sets the RPC interface
   register_plugin(PLUGIN_LOOP); //this runs in the main program loop
+  reset_receive_ring();
   reset_input_line_buffer();
   target_interpolator.begin();
 }
@@ -425,6 +681,7 @@ void GCodeInterface::begin(usb_serial_class *target_usb_serial){
   target_usb_serial -> begin(115200); //baud rate is unused
   this->gcode_stream = target_usb_serial; //sets the RPC interface
   register_plugin(PLUGIN_LOOP); //this runs in the main program loop
+  reset_receive_ring();
   reset_input_line_buffer();
   target_interpolator.begin();
 };
@@ -433,84 +690,212 @@ void GCodeInterface::begin(HardwareSerialIMXRT *target_serial, uint32_t baud, ui
   target_serial->begin(baud, format);
   this->gcode_stream = target_serial; //sets the RPC interface
   register_plugin(PLUGIN_LOOP); //this runs in the main program loop
+  reset_receive_ring();
   reset_input_line_buffer();
   target_interpolator.begin();
 }
 
 void GCodeInterface::reset_input_line_buffer(){
   input_line_buffer_index = 0;
+  input_line_overflow = false;
 }
 
-void GCodeInterface::loop(){
-  if(receiver_state == RECEIVER_READY){
-    reset_input_line_buffer();
-    receiver_state = RECEIVER_READING; //kick over to reading state immediately   
-  }
+void GCodeInterface::reset_receive_ring(){
+  receive_ring_read_index = 0;
+  receive_ring_write_index = 0;
+  receive_ring_count = 0;
+}
 
-  if(receiver_state == RECEIVER_READING){ //read in a line
-    while(gcode_stream->available() > 0){
-      uint8_t character = gcode_stream->read();
+void GCodeInterface::receive_stream(){
+  // Reads in chunks rather than a character at a time. Realtime commands never enter the ring, so they run right away,
+  // even while a block is waiting on the queue. If the ring is full, characters wait on the stream, except for realtime
+  // commands at the front of it, which are still taken. (A sender that streams ahead of the "ok"s should send them
+  // between lines, not behind a line that doesn't fit.)
+  char chunk[RECEIVE_CHUNK_SIZE];
+  while(true){
+    uint16_t num_to_read = std::min(gcode_stream->available(), (int)RECEIVE_CHUNK_SIZE);
+    if(!file_running){ //while a file runs, only realtime commands are kept, so there's always room
+      num_to_read = std::min(num_to_read, receive_ring_free());
+    }
+    if(num_to_read == 0){
+      while(gcode_stream->available() > 0){
+        int character = gcode_stream->peek();
+        if((character <= 0) || !strchr(REALTIME_LETTERS, character)){
+          break;
+        }
+        gcode_stream->read();
+        execute_realtime(character);
+      }
+      return;
+    }
+    num_to_read = gcode_stream->readBytes(chunk, num_to_read);
+    for(uint16_t chunk_index = 0; chunk_index < num_to_read; chunk_index++){
+      char character = chunk[chunk_index];
       if(strchr(REALTIME_LETTERS, character)){ //it's a realtime command. We extract and process seperately.
         execute_realtime(character);
         continue;
       }
-      if(process_character(character)){ //newline character received, done with line
-        receiver_state = RECEIVER_PROCESSING;
-        break;
+      if(file_running){ //the file has the receive ring
+        continue;
       }
+      receive_ring[receive_ring_write_index] = character;
+      receive_ring_write_index = (receive_ring_write_index + 1) % RECEIVE_RING_SIZE;
+      receive_ring_count ++;
     }
   }
+}
 
-  if(receiver_state == RECEIVER_PROCESSING){
-    for (int i = 0; i<20; i++){
-      SerialUSB1.printf("%02X ", (unsigned char)input_line_buffer[i]);
+void GCodeInterface::receive_file(){
+  // The receive ring doubles as the read-ahead buffer. We read straight into it, whenever there's room for a whole sector.
+  if(!file_running || file_paused){
+    return;
+  }
+  while((receive_ring_free() >= FILE_READ_SIZE) && (file_bytes_read < file_size)){
+    uint16_t num_to_read = std::min((uint16_t)(RECEIVE_RING_SIZE - receive_ring_write_index), FILE_READ_SIZE);
+    num_to_read = std::min((uint64_t)num_to_read, file_size - file_bytes_read);
+    int num_read = active_file.read(&receive_ring[receive_ring_write_index], num_to_read);
+    if(num_read <= 0){ //read error, so treat this as the end of the file
+      file_size = file_bytes_read;
+      break;
     }
-    SerialUSB1.print('\n');
-    if(tokenize_block()){ //a block with tokens, and at least one key token, was returned.
-      if(preprocess_block()){  //load block with target function and execution scope. Returns false if no matching function
-        if(dispatch_block()){ //block was successfully dispatched
-          send_ok();
-          receiver_state = RECEIVER_READY;
-        }else{
-          receiver_state = RECEIVER_BLOCKED;
-        };
-      }else{
-        send_error(ERROR_UNSUPPORTED_CODE);
-        receiver_state = RECEIVER_READY;
+    receive_ring_write_index = (receive_ring_write_index + num_read) % RECEIVE_RING_SIZE;
+    receive_ring_count += num_read;
+    file_bytes_read += num_read;
+  }
+  if((file_bytes_read == file_size) && (receive_ring_count == 0)){ //everything in the file has been read
+    if((receiver_state == RECEIVER_READING) && (input_line_buffer_index > 0)){ //the last line has no newline
+      receiver_state = RECEIVER_PROCESSING;
+    }else if(receiver_state == RECEIVER_READING){
+      finish_file();
+    }
+  }
+}
+
+void GCodeInterface::loop(){
+  receive_stream();
+  receive_file();
+  if(status_report_requested){
+    send_status_report();
+  }
+  if(file_aborting && !finish_file_abort()){ //lines wait until the aborted file's moves have stopped and been cleared
+    return;
+  }
+
+  for(uint8_t line_count = 0; line_count < MAX_LINES_PER_LOOP; line_count++){
+    if(receiver_state == RECEIVER_READY){
+      reset_input_line_buffer();
+      receiver_state = RECEIVER_READING; //kick over to reading state immediately   
+    }
+
+    if(receiver_state == RECEIVER_READING){ //read in a line
+      while(receive_ring_count > 0){
+        char character = receive_ring[receive_ring_read_index];
+        receive_ring_read_index = (receive_ring_read_index + 1) % RECEIVE_RING_SIZE;
+        receive_ring_count --;
+        if(process_character(character)){ //newline character received, done with line
+          receiver_state = RECEIVER_PROCESSING;
+          break;
+        }
       }
-    }else{
-      if(input_line_buffer_index != 0){ //don't send an error if line is empty (as when only a realtime command is received)
-        send_error(ERROR_NO_KEY);
+    }
+
+    if(receiver_state == RECEIVER_PROCESSING){
+      process_line();
+    }
+
+    if(receiver_state == RECEIVER_BLOCKED){
+      if(dispatch_block()){
+        send_ok();
+        receiver_state = RECEIVER_READY;      
       }
-      receiver_state = RECEIVER_READY;
+    }
+
+    run_block_queue();
+    if(receiver_state != RECEIVER_READY){ //waiting on the rest of a line, or on space in the queue
+      break;
     }
   }
+}
 
-  if(receiver_state == RECEIVER_BLOCKED){
-    if(dispatch_block()){
+void GCodeInterface::process_line(){
+  // Every line gets exactly one response, so that hosts can count characters. Blank and comment-only lines are ok.
+  if(file_running){
+    file_line_count ++;
+  }
+  if(input_line_overflow){
+    send_error(ERROR_LINE_OVERFLOW);
+    receiver_state = RECEIVER_READY;
+    return;
+  }
+  if(!check_line()){
+    receiver_state = RECEIVER_READY;
+    return;
+  }
+  uint32_t parse_entry_cycle_count = ARM_DWT_CYCCNT;
+  bool block_has_key = tokenize_block();
+  bool sets_line_number = block_has_key && (read_code_key(inbound_block.key_string) == code_key('M', 110));
+  if(line_has_number && !file_running && !sets_line_number && !check_line_number()){
+    receiver_state = RECEIVER_READY;
+    return;
+  }
+  if(token_overflow){
+    send_error(ERROR_BAD_FORMAT);
+    receiver_state = RECEIVER_READY;
+    return;
+  }
+  bool block_has_code = block_has_key && preprocess_block();
+  if(block_has_code){
+    parse_cycles += ARM_DWT_CYCCNT - parse_entry_cycle_count;
+    parsed_line_count ++;
+  }
+  if(block_has_key){ //a block with tokens, and at least one key token, was returned.
+    if(block_has_code){  //load block with target function and execution scope. Returns false if no matching function
+      if(!prepare_block()){ //the block can't run, and the error has been sent
+        receiver_state = RECEIVER_READY;
+      }else if(dispatch_block()){ //block was successfully dispatched
+        send_ok();
+        receiver_state = RECEIVER_READY;
+      }else{
+        receiver_state = RECEIVER_BLOCKED;
+      };
+    }else{
+      send_error(ERROR_UNSUPPORTED_CODE);
+      receiver_state = RECEIVER_READY;
+    }
+  }else{
+    if(inbound_block.num_words > 0){ //words without a key to go with them
+      send_error(ERROR_NO_KEY);
+    }else{
       send_ok();
-      receiver_state = RECEIVER_READY;      
     }
+    receiver_state = RECEIVER_READY;
   }
+}
 
-  if(!queue_is_empty()){ //start to execute on the queue
+void GCodeInterface::run_block_queue(){
+  while(!queue_is_empty()){ //start to execute on the queue
     if(next_block_execution() == EXECUTE_INTERPOLATOR){ //run if the interpolator has space
-      if(!target_interpolator.queue_is_full()){
-        struct block *target_block = pull_block();
-        execute_block(target_block);
+      if(target_interpolator.queue_is_full()){
+        return;
       }
     }else{ //run if the interpolator is idle
-      if(target_interpolator.is_idle()){
-        struct block *target_block = pull_block();
-        execute_block(target_block);
+      if(!target_interpolator.is_idle()){
+        return;
       }
     }
+    struct block *target_block = pull_block();
+    execute_block(target_block);
   }
 }
 
 bool GCodeInterface::process_character(uint8_t character){
   if(character == '\n'){
     return true;
+  }else if(character == '\r'){ //ignore carriage returns, for hosts that send CRLF line endings
+    return false;
+  }else if(input_line_buffer_index == INPUT_LINE_BUFFER_SIZE){ //too long. We read to the end of the line and then report it.
+    input_line_overflow = true;
+    return false;
   }else{
     input_line_buffer[input_line_buffer_index] = character;
     input_line_buffer_index ++;
@@ -518,17 +903,93 @@ bool GCodeInterface::process_character(uint8_t character){
   }
 }
 
+bool GCodeInterface::check_line(){
+  // Reads a leading line number, and checks and strips a trailing checksum.
+  uint8_t index = 0;
+  while((index < input_line_buffer_index) && (input_line_buffer[index] == ' ')){
+    index ++;
+  }
+  line_has_number = (index < input_line_buffer_index) && (toupper(input_line_buffer[index]) == 'N');
+  if(line_has_number){
+    line_number = 0;
+    for(index ++; (index < input_line_buffer_index) && isdigit(input_line_buffer[index]); index ++){
+      line_number = line_number * 10 + (input_line_buffer[index] - '0');
+    }
+  }
+  input_line_start_index = index;
+
+  uint8_t checksum = 0;
+  uint8_t checksum_index = 0; //where the '*' is. Comments can't carry a checksum, so we stop looking at a ';'.
+  for(; checksum_index < input_line_buffer_index; checksum_index ++){
+    char this_char = input_line_buffer[checksum_index];
+    if(this_char == '*' || this_char == ';'){
+      break;
+    }
+    checksum ^= this_char;
+  }
+  bool line_has_checksum = (checksum_index < input_line_buffer_index) && (input_line_buffer[checksum_index] == '*');
+
+  if(!line_has_checksum){
+    if(line_has_number && !file_running){
+      request_resend("No Checksum with line number");
+      return false;
+    }
+    return true;
+  }
+
+  uint16_t received_checksum = 0;
+  for(index = checksum_index + 1; (index < input_line_buffer_index) && isdigit(input_line_buffer[index]); index ++){
+    received_checksum = received_checksum * 10 + (input_line_buffer[index] - '0');
+  }
+  input_line_buffer_index = checksum_index; //the block ends at the checksum
+  if(!file_running && (received_checksum != checksum)){
+    request_resend("checksum mismatch");
+    return false;
+  }
+  return true;
+}
+
+bool GCodeInterface::check_line_number(){
+  uint32_t expected_line_number = last_line_number + 1;
+  if(line_number == expected_line_number){
+    last_line_number = line_number;
+    line_resend_requested = false;
+    return true;
+  }
+  if((line_number < expected_line_number) && (expected_line_number - line_number <= LINE_NUMBER_WINDOW)){
+    send_ok(); //already ran. The host is resending from further back than it needed to.
+  }else if(!line_resend_requested){
+    request_resend("Line Number is not Last Line Number+1");
+  }else{
+    send_ok(); //this line was already in flight when we asked for the resend, and will come around again.
+  }
+  return false;
+}
+
+void GCodeInterface::request_resend(const char* reason){
+  gcode_stream->print("Error:");
+  gcode_stream->print(reason);
+  gcode_stream->print(", Last Line: ");
+  gcode_stream->println(last_line_number);
+  gcode_stream->print("Resend: ");
+  gcode_stream->println(last_line_number + 1);
+  send_ok();
+  line_resend_requested = true;
+}
+
 bool GCodeInterface::tokenize_block(){
-  // processes the input line buffer into block tokens.
+  // processes the input line buffer into the block's key and words.
   
   //reset state
-  int8_t token_index = -1;
-  inbound_block.key_token_index = -1;
-  uint8_t char_index = 0;
+  inbound_block.num_words = 0;
+  inbound_block.key_string[0] = '\0';
+  token_overflow = false;
+  char token_string[MAX_TOKEN_SIZE + 1];
+  int8_t token_length = -1; //-1 until the first token starts
   bool token_lock = false; //if True, we'll stay in the current token until the lock is released.
 
-  //iterate through the input line buffer
-  for(uint8_t index = 0; index < input_line_buffer_index; index ++){
+  //iterate through the input line buffer, after the line number
+  for(uint8_t index = input_line_start_index; index < input_line_buffer_index; index ++){
     char this_char = toupper(input_line_buffer[index]);
     if(this_char == ' '){ //skip spaces
       continue;
@@ -542,57 +1003,152 @@ bool GCodeInterface::tokenize_block(){
     }
 
     if(strchr(TOKEN_LETTERS, this_char) && !token_lock){ //new token, if token lock is not enabled
-      if(token_index > -1){ //close out the old token
-        inbound_block.tokens[token_index].token_string[char_index] = '\0';
+      if(token_length > -1){ //close out the old token
+        close_token(token_string, token_length);
       }
-      token_index ++;
-      char_index = 0;
-      if(token_index == MAX_NUM_TOKENS){ //stop processing when we reach the max num tokens.
+      token_length = 0;
+      if(inbound_block.num_words == MAX_NUM_TOKENS){ //stop processing when we reach the max num tokens.
         break;
       }
-      if(this_char == 'G' || this_char == 'M' || this_char == '$'){ //identify the "key" token so we don't need to do it later.
-        inbound_block.key_token_index = token_index;
-      }
       if(this_char == '$'){
         token_lock = true; //we'll enter a token lock until we receive an '='
       }
     }
-    inbound_block.tokens[token_index].token_string[char_index] = this_char;
-    char_index++;
-    if(char_index == MAX_TOKEN_SIZE){
-      break;
+    if(token_length == MAX_TOKEN_SIZE){ //too long to keep. Cutting it short would change its value, so the line is rejected.
+      token_overflow = true;
+    }else if(token_length > -1){
+      token_string[token_length] = this_char;
+      token_length++;
     }
   }
-  inbound_block.tokens[token_index].token_string[char_index] = '\0'; //close out the last token
-  inbound_block.num_tokens = token_index + 1;
-  if(token_index > -1 && inbound_block.key_token_index > -1){
-    return true;
-  }else{
-    return false;
+  if((token_length > -1) && (inbound_block.num_words < MAX_NUM_TOKENS)){
+    close_token(token_string, token_length); //close out the last token
   }
+  return (inbound_block.key_string[0] != '\0');
 }
 
-int8_t GCodeInterface::find_code(char *code_string){
-  uint8_t num_codes = sizeof(GCodeInterface::all_codes) / sizeof(GCodeInterface::all_codes[0]);
-  for(uint8_t code_index = 0; code_index < num_codes; code_index++){ //iterate over all codes
-    if(strcmp(code_string, all_codes[code_index].code_string) == 0){ //found the code
-      return code_index;
+void GCodeInterface::close_token(char* token_string, uint8_t token_length){
+  // G, M, and $ tokens are keys. If a block has several, the last one is the key, and any others are kept as words.
+  token_string[token_length] = '\0';
+  char letter = token_string[0];
+  if(letter == 'G' || letter == 'M' || letter == '$'){
+    if((inbound_block.key_string[0] == 'G') || (inbound_block.key_string[0] == 'M')){
+      inbound_block.words[inbound_block.num_words].letter = inbound_block.key_string[0];
+      inbound_block.words[inbound_block.num_words].value = parse_decimal(&inbound_block.key_string[1]);
+      inbound_block.num_words ++;
+    }
+    memcpy(inbound_block.key_string, token_string, token_length + 1);
+  }else if(letter >= 'A' && letter <= 'Z'){ //only lettered words are kept. Nothing reads '=' values yet.
+    inbound_block.words[inbound_block.num_words].letter = letter;
+    inbound_block.words[inbound_block.num_words].value = parse_decimal(&token_string[1]);
+    inbound_block.num_words ++;
+  }
+}
+
+float64_t GCodeInterface::parse_decimal(const char* decimal_string){
+  // Parses a number like "-12.345", stopping at the first character that isn't part of it. Exponents aren't supported.
+  // Tokens are at most MAX_TOKEN_SIZE characters, so the digits always fit in the mantissa. Because both the mantissa and the
+  // power of ten are exact, the division rounds the same way as strtod.
+  static const float64_t POWERS_OF_TEN[MAX_TOKEN_SIZE + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+  bool is_negative = false;
+  if(*decimal_string == '-'){
+    is_negative = true;
+    decimal_string++;
+  }else if(*decimal_string == '+'){
+    decimal_string++;
+  }
+  uint64_t mantissa = 0;
+  uint8_t decimal_places = 0;
+  bool in_fraction = false;
+  for(; *decimal_string; decimal_string++){
+    char this_char = *decimal_string;
+    if(this_char >= '0' && this_char <= '9'){
+      mantissa = mantissa * 10 + (this_char - '0');
+      if(in_fraction){
+        decimal_places ++;
+      }
+    }else if(this_char == '.' && !in_fraction){
+      in_fraction = true;
+    }else{
+      break;
     }
-  }  
-  return -1; //code not found 
+  }
+  float64_t value = (float64_t)mantissa / POWERS_OF_TEN[decimal_places];
+  return is_negative ? -value : value;
+}
+
+uint16_t GCodeInterface::read_code_key(const char* code_string){
+  // G and M codes are keyed by their number, so that e.g. "G01" matches G1. Other codes are at most two characters.
+  char letter = code_string[0];
+  if(letter == 'G' || letter == 'M'){
+    uint16_t number = 0;
+    const char* digit = &code_string[1];
+    if(*digit == '\0'){
+      return 0;
+    }
+    for(; *digit; digit++){
+      if(*digit < '0' || *digit > '9'){
+        return 0;
+      }
+      number = number * 10 + (*digit - '0');
+      if(number > 255){
+        return 0;
+      }
+    }
+    return code_key(letter, number);
+  }
+  if(letter == '\0' || ((code_string[1] != '\0') && (code_string[2] != '\0'))){
+    return 0;
+  }
+  return code_key(letter, code_string[1]);
+}
+
+bool GCodeInterface::find_code(const char* code_string, struct code* found_code){
+  // stores all available codes.
+  switch(read_code_key(code_string)){
+    case code_key('G', 0): *found_code = {&GCodeInterface::g0_rapid, EXECUTE_INTERPOLATOR, &GCodeInterface::prepare_rapid}; return true;
+    case code_key('G', 1): *found_code = {&GCodeInterface::g1_move, EXECUTE_INTERPOLATOR, &GCodeInterface::prepare_move}; return true;
+    case code_key('G', 2): *found_code = {&GCodeInterface::g2_arc_cw, EXECUTE_INTERPOLATOR, &GCodeInterface::prepare_arc}; return true;
+    case code_key('G', 3): *found_code = {&GCodeInterface::g3_arc_ccw, EXECUTE_INTERPOLATOR, &GCodeInterface::prepare_arc}; return true;
+    case code_key('G', 4): *found_code = {&GCodeInterface::g4_dwell, EXECUTE_QUEUE}; return true;
+    case code_key('G', 5): *found_code = {&GCodeInterface::g5_bezier, EXECUTE_INTERPOLATOR, &GCodeInterface::prepare_bezier}; return true;
+    case code_key('M', 110): *found_code = {&GCodeInterface::m110_set_line_number, EXECUTE_NOW}; return true;
+    case code_key('$', 0): *found_code = {&GCodeInterface::_help, EXECUTE_NOW}; return true;
+    case code_key('$', '$'): *found_code = {&GCodeInterface::_report_parameters, EXECUTE_NOW}; return true;
+    case code_key('$', 'G'): *found_code = {&GCodeInterface::_parser_state, EXECUTE_NOW}; return true;
+    case code_key('\x18', 0): *found_code = {&GCodeInterface::_soft_reset, EXECUTE_NOW}; return true;
+    case code_key('?', 0): *found_code = {&GCodeInterface::_status_report, EXECUTE_NOW}; return true;
+    case code_key('~', 0): *found_code = {&GCodeInterface::_cycle_start, EXECUTE_NOW}; return true;
+    case code_key('!', 0): *found_code = {&GCodeInterface::_feed_hold, EXECUTE_NOW}; return true;
+    case code_key('\x90', 0): *found_code = {&GCodeInterface::_feed_override_reset, EXECUTE_NOW}; return true;
+    case code_key('\x91', 0): *found_code = {&GCodeInterface::_feed_override_coarse_plus, EXECUTE_NOW}; return true;
+    case code_key('\x92', 0): *found_code = {&GCodeInterface::_feed_override_coarse_minus, EXECUTE_NOW}; return true;
+    case code_key('\x93', 0): *found_code = {&GCodeInterface::_feed_override_fine_plus, EXECUTE_NOW}; return true;
+    case code_key('\x94', 0): *found_code = {&GCodeInterface::_feed_override_fine_minus, EXECUTE_NOW}; return true;
+    default: return false; //code not found 
+  }
 }
 
 bool GCodeInterface::preprocess_block(){
-  int8_t code_index = find_code(inbound_block.tokens[inbound_block.key_token_index].token_string);
-  if(code_index == -1){
+  struct code found_code;
+  if(!find_code(inbound_block.key_string, &found_code)){
     return false;
   }else{
-    inbound_block.code_function = all_codes[code_index].code_function;
-    inbound_block.execution = all_codes[code_index].execution;
+    inbound_block.code_function = found_code.code_function;
+    inbound_block.execution = found_code.execution;
+    inbound_block.prepare_function = found_code.prepare_function;
     return true;
   }
 }
 
+bool GCodeInterface::prepare_block(){
+  if(inbound_block.prepare_function == nullptr){
+    return true;
+  }
+  load_words(&inbound_block);
+  return (this->*inbound_block.prepare_function)();
+}
+
 bool GCodeInterface::dispatch_block(){
   if(inbound_block.execution == EXECUTE_NOW){ //execute now.
     execute_block(&inbound_block);
@@ -639,29 +1195,33 @@ void GCodeInterface::reset_block_queue(){
 }
 
 void GCodeInterface::execute_block(block *target_block){
-  load_tokens(target_block);
+  load_words(target_block);
+  execution_feedrate_mm_per_min = target_block->feedrate_mm_per_min;
+  execution_delta = target_block->delta;
   (this->*target_block->code_function)(); //call code function in target block
 }
 
 void GCodeInterface::execute_realtime(char command){
   char str[2] = { command, '\0' };
-  int8_t code_index = find_code(str);
-  if(code_index > -1){
-    (this->*all_codes[code_index].code_function)(); //run function
+  struct code found_code;
+  if(find_code(str, &found_code)){
+    (this->*found_code.code_function)(); //run function
   }
 }
 
-void GCodeInterface::load_tokens(block *target_block){
-  execution_tokens.clear();
-  for(uint8_t token_index = 0; token_index < target_block->num_tokens; token_index ++){ //iterate over all tokens in block
-    if(token_index != target_block->key_token_index){ //don't load the key token, b/c it may be non-numeric
-      char letter = target_block->tokens[token_index].token_string[0];
-      DecimalPosition value = std::strtod(&target_block->tokens[token_index].token_string[1], NULL);
-      execution_tokens[String(letter)] = value;
-    }
+void GCodeInterface::load_words(block *target_block){
+  execution_words_present = 0;
+  for(uint8_t word_index = 0; word_index < target_block->num_words; word_index ++){ //iterate over all words in block
+    uint8_t letter_index = target_block->words[word_index].letter - 'A';
+    execution_words[letter_index] = target_block->words[word_index].value;
+    execution_words_present |= (1UL << letter_index);
   }
 }
 
+bool GCodeInterface::has_word(char letter){
+  return execution_words_present & (1UL << (letter - 'A'));
+}
+
 bool GCodeInterface::queue_is_empty(){
   return !(block_queue_slots_remaining < BLOCK_QUEUE_SIZE);
 }
@@ -672,6 +1232,9 @@ uint8_t GCodeInterface::next_block_execution(){
 }
 
 void GCodeInterface::send_ok(){
+  if(file_running){ //nobody is counting lines from a file
+    return;
+  }
   gcode_stream->println("ok");
 }
 
@@ -684,74 +1247,179 @@ void GCodeInterface::send_error(uint8_t error_type){
     case ERROR_BAD_FORMAT:
       gcode_stream->println("2");
       break;
+    case ERROR_LINE_OVERFLOW:
+      gcode_stream->println("11");
+      break;
     case ERROR_UNSUPPORTED_CODE:
       gcode_stream->println("20");
       break;
     case ERROR_NO_FEED_RATE:
       gcode_stream->println("22");
       break;      
+    case ERROR_INVALID_TARGET:
+      gcode_stream->println("33");
+      break;
   }
 }
 
 // --- GCODE FUNCTIONS ---
 
 void GCodeInterface::g0_rapid(){
-  auto result = execution_tokens.find("X"); //find X
-  if(result != execution_tokens.end()){
-    Serial.println(result->second);
+  g1_move(); //prepare_rapid resolved the move at the rapid feedrate
+}
+
+bool GCodeInterface::check_feedrate(){
+  if(read_word('F', modal_feedrate_mm_per_min) <= 0){ //feed must be positive
+    send_error(ERROR_NO_FEED_RATE);
+    return false;
   }
+  return true;
 }
-void GCodeInterface::g1_move(){
-  struct TimeBasedInterpolator::motion_block interpolator_block;
-  const char* AXES = "XYZE"; //need to be in same order as TimeBasedInterpolator::position
-  const char* FEED_AXES = "XYZ";
-  DecimalPosition sum_feed_delta_squared = 0; //used for calculating euclidean distance of "feed" axes (i.e. axes whose distance is used in feed rate calc.)
-  DecimalPosition* current_position = &machine_position.x_mm; //pointer to first member of machine position
-  DecimalPosition* delta_position = &interpolator_block.block_position.x_mm; //pointer to first member of block delta position
 
-  // 1. Update feedrate
-  auto feed_token = execution_tokens.find("F");
-  if(feed_token != execution_tokens.end()){
-    modal_feedrate_mm_per_min = feed_token->second;
+bool GCodeInterface::prepare_move(){
+  // Loads a new modal feedrate if one was provided, and the distances to the end of the move. Returns false, and reports an
+  // error, if there is no feedrate to move at.
+  if(!check_feedrate()){
+    return false;
   }
-  if(modal_feedrate_mm_per_min <= 0){ //feed must be positive
-    send_error(ERROR_NO_FEED_RATE);
-    return;
+  modal_feedrate_mm_per_min = read_word('F', modal_feedrate_mm_per_min);
+  inbound_block.feedrate_mm_per_min = modal_feedrate_mm_per_min;
+  load_delta_positions(&inbound_block.delta);
+  return true;
+}
+
+bool GCodeInterface::prepare_rapid(){
+  // Rapids move at rapid_feedrate_mm_per_min, and don't need a feedrate of their own. As in GRBL, an F word on the line
+  // still sets the modal feedrate of the moves that follow.
+  if(has_word('F') && !check_feedrate()){
+    return false;
   }
+  modal_feedrate_mm_per_min = read_word('F', modal_feedrate_mm_per_min);
+  inbound_block.feedrate_mm_per_min = rapid_feedrate_mm_per_min;
+  load_delta_positions(&inbound_block.delta);
+  return true;
+}
 
-  // 2. Load all delta positions
-  for(uint8_t axis_index =0; axis_index < sizeof(AXES); axis_index ++){
-    auto result = execution_tokens.find(String(AXES[axis_index]));
-    if(result != execution_tokens.end()){ //token was found
-      delta_position[axis_index] = result->second - current_position[axis_index];
-      current_position[axis_index] = result->second; //update current position
-      if(strchr(FEED_AXES, AXES[axis_index])){ //feeding axis
-        sum_feed_delta_squared += (delta_position[axis_index] * delta_position[axis_index]);
-      }
-    }else{
-      delta_position[axis_index] = 0; //not moving in this axis
+void GCodeInterface::load_delta_positions(struct TimeBasedInterpolator::position* delta){
+  // Converts the target positions in the block into distances from the machine position, and updates the machine position.
+  const char* AXES = "XYZE"; //need to be in same order as TimeBasedInterpolator::position
+  DecimalPosition* current_position = &machine_position.x_mm; //pointer to first member of machine position
+  DecimalPosition* delta_position = &delta->x_mm; //pointer to first member of block delta position
+  *delta = {}; //not moving in any axis that isn't given
+  for(uint8_t axis_index =0; axis_index < strlen(AXES); axis_index ++){
+    if(has_word(AXES[axis_index])){ //word was found
+      DecimalPosition target_position = execution_words[AXES[axis_index] - 'A'];
+      delta_position[axis_index] = target_position - current_position[axis_index];
+      current_position[axis_index] = target_position; //update current position
     }
   }
+}
+
+DecimalPosition GCodeInterface::read_word(char letter, DecimalPosition default_value){
+  if(has_word(letter)){
+    return execution_words[letter - 'A'];
+  }
+  return default_value;
+}
 
-  // 3. Calculate move time
+void GCodeInterface::g1_move(){
+  struct TimeBasedInterpolator::motion_block interpolator_block = {}; //block type defaults to incremental
+  struct TimeBasedInterpolator::position* delta = &interpolator_block.block_position;
+
+  // 1. Load all delta positions, resolved by prepare_move
+  *delta = execution_delta;
+  //used for calculating euclidean distance of "feed" axes (i.e. axes whose distance is used in feed rate calc.)
+  DecimalPosition sum_feed_delta_squared = (delta->x_mm * delta->x_mm) + (delta->y_mm * delta->y_mm) + (delta->z_mm * delta->z_mm);
+
+  // 2. Calculate move time
   float move_time_s = 0;
   if(sum_feed_delta_squared > 0){ //we're moving in the XYZ plane, so base move time on that.
-    move_time_s = std::sqrt(sum_feed_delta_squared) / (modal_feedrate_mm_per_min / 60);
+    move_time_s = std::sqrt(sum_feed_delta_squared) / (execution_feedrate_mm_per_min / 60);
   }else if(interpolator_block.block_position.e_mm != 0){ //we're moving in E, base move time on that
-    move_time_s = fabs(interpolator_block.block_position.e_mm) / (modal_feedrate_mm_per_min / 60);
+    move_time_s = fabs(interpolator_block.block_position.e_mm) / (execution_feedrate_mm_per_min / 60);
   }
   interpolator_block.block_time_s = move_time_s;
 
-  // 4. Load block
+  // 3. Load block
   if(move_time_s > 0){
     target_interpolator.add_block(&interpolator_block);
   }
 };
 
+void GCodeInterface::g2_arc_cw(){
+  arc_move(TBI_ARC_CW);
+}
+
+void GCodeInterface::g3_arc_ccw(){
+  arc_move(TBI_ARC_CCW);
+}
+
+bool GCodeInterface::prepare_arc(){
+  // Arcs in the XY plane, with the center given by I and J relative to the start. The radius form (R) isn't supported.
+  if(!check_feedrate()){
+    return false;
+  }
+  if(!has_word('I') && !has_word('J')){
+    send_error(has_word('R') ? ERROR_UNSUPPORTED_CODE : ERROR_INVALID_TARGET); //the radius form is refused, not read as a center at the start
+    return false;
+  }
+  DecimalPosition center_x = read_word('I', 0);
+  DecimalPosition center_y = read_word('J', 0);
+  if((center_x == 0) && (center_y == 0)){ //zero radius
+    send_error(ERROR_INVALID_TARGET);
+    return false;
+  }
+  // the end point has to be as far from the center as the start point is, or there's no arc that joins them
+  DecimalPosition end_x = read_word('X', machine_position.x_mm) - machine_position.x_mm;
+  DecimalPosition end_y = read_word('Y', machine_position.y_mm) - machine_position.y_mm;
+  DecimalPosition start_radius = std::sqrt(center_x * center_x + center_y * center_y);
+  DecimalPosition end_radius = std::sqrt((end_x - center_x) * (end_x - center_x) + (end_y - center_y) * (end_y - center_y));
+  DecimalPosition radius_error = std::fabs(end_radius - start_radius);
+  if((radius_error > ARC_RADIUS_MAX_ERROR_MM) ||
+     ((radius_error > ARC_RADIUS_TOLERANCE_MM) && (radius_error > ARC_RADIUS_RELATIVE_TOLERANCE * start_radius))){
+    send_error(ERROR_INVALID_TARGET);
+    return false;
+  }
+  return prepare_move();
+}
+
+void GCodeInterface::arc_move(int8_t direction){
+  target_interpolator.add_arc(execution_feedrate_mm_per_min / 60, execution_delta.x_mm, execution_delta.y_mm, read_word('I', 0), read_word('J', 0),
+                              direction, execution_delta.z_mm, execution_delta.e_mm);
+}
+
+bool GCodeInterface::prepare_bezier(){
+  if(!check_feedrate()){
+    return false;
+  }
+  if(!has_word('P') || !has_word('Q')){
+    send_error(ERROR_INVALID_TARGET);
+    return false;
+  }
+  return prepare_move();
+}
+
+void GCodeInterface::g5_bezier(){
+  // Cubic Bezier in the XY plane. I and J give the first control point relative to the start,
+  // P and Q give the second control point relative to the end.
+  const struct TimeBasedInterpolator::position* delta = &execution_delta;
+  target_interpolator.add_bezier(execution_feedrate_mm_per_min / 60, read_word('I', 0), read_word('J', 0),
+                                 delta->x_mm + read_word('P', 0), delta->y_mm + read_word('Q', 0), delta->x_mm, delta->y_mm, delta->z_mm, delta->e_mm);
+}
+
 void GCodeInterface::g4_dwell(){
   //need to implement
 }
 
+void GCodeInterface::m110_set_line_number(){
+  if(has_word('N')){
+    last_line_number = (uint32_t)read_word('N', 0);
+  }else{
+    last_line_number = line_has_number ? line_number : 0;
+  }
+  line_resend_requested = false;
+}
+
 // -- SYSTEM FUNCTIONS --
 void GCodeInterface::_help(){
   Serial.println("HELP");
@@ -766,20 +1434,64 @@ void GCodeInterface::_soft_reset(){
 }
 
 void GCodeInterface::_status_report(){
-  gcode_stream->print("<");
-  if(target_interpolator.is_idle()){
-    gcode_stream->print("Idle|MPos:");
+  status_report_requested = true;
+}
+
+// Collects a report in a fixed buffer, so it can be written to the stream all at once.
+class StatusReportBuffer : public Print{
+  public:
+    size_t write(uint8_t character){
+      if(length == sizeof(buffer)){
+        return 0;
+      }
+      buffer[length++] = character;
+      return 1;
+    }
+    using Print::write;
+    uint8_t buffer[160]; //longest report is about 130 characters
+    uint16_t length = 0;
+};
+
+void GCodeInterface::send_status_report(){
+  // e.g. <Run|MPos:10.000,5.000,0.000|Bf:92,1011|FS:1200.0,0|Ov:100,100,100>
+  status_report_requested = false;
+
+  // Machine position is read through the BlockPort graph, so it reflects where the downstream channels are (e.g. through
+  // kinematics), not just where the interpolator is. Unmapped outputs read back the interpolator's own position.
+  DecimalPosition machine_position_mm[3];
+  read_machine_position(machine_position_mm, 3, true);
+  float32_t feedrate_mm_per_min = target_interpolator.read_speed_per_s() * 60;
+
+  StatusReportBuffer report;
+  if(target_interpolator.feed_hold_requested()){
+    report.print(target_interpolator.is_held() ? "<Hold:0" : "<Hold:1");
+  }else if(target_interpolator.is_idle() && queue_is_empty()){
+    report.print("<Idle");
   }else{
-    gcode_stream->print("Run|MPos:");
+    report.print("<Run");
   }
-  gcode_stream->print(target_interpolator.output_x.read_target(),3);
-  gcode_stream->print(",");
-  gcode_stream->print(target_interpolator.output_y.read_target(),3);
-  gcode_stream->print(",");
-  gcode_stream->print(target_interpolator.output_z.read_target(),3);
-  gcode_stream->print(",|FS:");
-  gcode_stream->print(modal_feedrate_mm_per_min, 1);
-  gcode_stream->println(">");
+  report.print("|MPos:");
+  for(uint8_t axis_index = 0; axis_index < 3; axis_index++){
+    if(axis_index > 0){
+      report.print(",");
+    }
+    report.print(machine_position_mm[axis_index], 3);
+  }
+  report.print("|Bf:");
+  report.print(target_interpolator.slots_remaining);
+  report.print(",");
+  report.print(receive_ring_free());
+  report.print("|FS:");
+  report.print(feedrate_mm_per_min, 1);
+  report.print(",0|Ov:"); //no spindle
+  report.print((int)(target_interpolator.speed_overide * 100 + 0.5));
+  report.print(",100,100");
+  if(++reports_since_work_offset >= WORK_OFFSET_REPORT_INTERVAL){
+    report.print("|WCO:0.000,0.000,0.000"); //work offsets (e.g. G92) aren't supported yet, so work and machine positions match
+    reports_since_work_offset = 0;
+  }
+  report.print(">\r\n");
+  gcode_stream->write(report.buffer, report.length);
 }
 
 void GCodeInterface::_parser_state(){
@@ -787,9 +1499,423 @@ void GCodeInterface::_parser_state(){
 }
 
 void GCodeInterface::_cycle_start(){
-
+  if(file_aborting){ //the abort holds until the queue is cleared, then resumes
+    file_abort_hold_requested = false;
+    return;
+  }
+  if(file_running){ //also picks up a file paused by pause_file()
+    resume_file();
+    return;
+  }
+  target_interpolator.resume();
 }
 
 void GCodeInterface::_feed_hold(){
+  if(file_aborting){ //stay held once the abort has cleared the queue
+    file_abort_hold_requested = true;
+  }
+  target_interpolator.feed_hold();
+}
+
+void GCodeInterface::_feed_override_reset(){
+  target_interpolator.speed_overide = 1.0;
+}
+
+void GCodeInterface::_feed_override_coarse_plus(){
+  adjust_feed_override(FEED_OVERRIDE_COARSE_STEP);
+}
+
+void GCodeInterface::_feed_override_coarse_minus(){
+  adjust_feed_override(-FEED_OVERRIDE_COARSE_STEP);
+}
+
+void GCodeInterface::_feed_override_fine_plus(){
+  adjust_feed_override(FEED_OVERRIDE_FINE_STEP);
+}
+
+void GCodeInterface::_feed_override_fine_minus(){
+  adjust_feed_override(-FEED_OVERRIDE_FINE_STEP);
+}
+
+void GCodeInterface::adjust_feed_override(float32_t delta){
+  // GRBL limits feed overrides to between 10% and 200%
+  float32_t feed_override = target_interpolator.speed_overide + delta;
+  feed_override = std::max(feed_override, FEED_OVERRIDE_MIN);
+  feed_override = std::min(feed_override, FEED_OVERRIDE_MAX);
+  target_interpolator.speed_overide = feed_override;
+}
+
+// -- FILE SOURCE --
+
+bool GCodeInterface::start_file(const char* filename){
+  if(file_running){
+    return false;
+  }
+  if(!sd_card_initialized){
+    initialize_sd_card();
+    sd_card_initialized = true;
+  }
+  active_file = SD.sdfs.open(filename, O_READ);
+  if(!active_file){
+    return false;
+  }
+  file_size = active_file.fileSize();
+  file_bytes_read = 0;
+  file_line_count = 0;
+  file_paused = false;
+  file_running = true;
+  return true;
+}
+
+void GCodeInterface::pause_file(){
+  if(file_running){
+    file_paused = true;
+    target_interpolator.feed_hold();
+  }
+}
+
+void GCodeInterface::resume_file(){
+  if(file_running){
+    file_paused = false;
+    target_interpolator.resume();
+  }
+}
+
+void GCodeInterface::abort_file(){
+  if(!file_running){
+    return;
+  }
+  // Stops reading the file right away, but lets the machine decelerate to a hold before the queued moves are cleared, rather
+  // than stopping dead. Lines from the stream wait until then. See finish_file_abort().
+  file_abort_hold_requested = target_interpolator.feed_hold_requested(); //restored once the queue is cleared
+  target_interpolator.feed_hold();
+  finish_file();
+  file_aborting = true;
+  // drop everything read from the file
+  reset_receive_ring();
+  reset_input_line_buffer();
+  reset_block_queue();
+  receiver_state = RECEIVER_READY;
+}
+
+bool GCodeInterface::finish_file_abort(){
+  if(!target_interpolator.is_held()){
+    return false;
+  }
+  noInterrupts(); //the frame mustn't pull a block while the queue is being cleared
+  target_interpolator.reset_block_queue();
+  interrupts();
+  if(!file_abort_hold_requested){
+    target_interpolator.resume();
+  }
+  file_aborting = false;
+  // pick up from wherever the machine stopped
+  DecimalPosition stopped_position_mm[4];
+  read_machine_position(stopped_position_mm, 4, false);
+  machine_position.x_mm = stopped_position_mm[TBI_AXIS_X];
+  machine_position.y_mm = stopped_position_mm[TBI_AXIS_Y];
+  machine_position.z_mm = stopped_position_mm[TBI_AXIS_Z];
+  machine_position.e_mm = stopped_position_mm[TBI_AXIS_E];
+  return true;
+}
+
+void GCodeInterface::read_machine_position(DecimalPosition* position_mm, uint8_t num_axes, bool read_downstream){
+  // Positions are read with interrupts off, so the frame can't change them partway through. The downstream read is short:
+  // a few BlockPorts and at most a kinematic transform per axis.
+  noInterrupts();
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    if(read_downstream){
+      position_mm[axis_index] = target_interpolator.output_axes[axis_index].read_deep_quiet(); //already in world units
+    }else{
+      position_mm[axis_index] = target_interpolator.output_axes[axis_index].read_target();
+    }
+  }
+  interrupts();
+  if(!read_downstream){
+    for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+      position_mm[axis_index] = target_interpolator.output_axes[axis_index].convert_block_to_world_units(position_mm[axis_index]);
+    }
+  }
+}
+
+void GCodeInterface::finish_file(){
+  active_file.close();
+  file_running = false;
+  file_paused = false;
+}
+
+bool GCodeInterface::is_running_file(){
+  return file_running;
+}
+
+float32_t GCodeInterface::read_file_progress(){
+  if(!file_running || (file_size == 0)){
+    return 0;
+  }
+  return (float32_t)(file_bytes_read - receive_ring_count) / file_size;
+}
+
+uint32_t GCodeInterface::read_file_line_count(){
+  return file_line_count;
+}
+
+void GCodeInterface::enroll(RPC *rpc, const String& instance_name){
+  rpc->enroll(instance_name, "start_file", *this, &GCodeInterface::start_file);
+  rpc->enroll(instance_name, "pause_file", *this, &GCodeInterface::pause_file);
+  rpc->enroll(instance_name, "resume_file", *this, &GCodeInterface::resume_file);
+  rpc->enroll(instance_name, "abort_file", *this, &GCodeInterface::abort_file);
+  rpc->enroll(instance_name, "is_running_file", *this, &GCodeInterface::is_running_file);
+  rpc->enroll(instance_name, "read_file_progress", *this, &GCodeInterface::read_file_progress);
+  rpc->enroll(instance_name, "read_file_line_count", *this, &GCodeInterface::read_file_line_count);
+  rpc->enroll(instance_name, "set_acceleration", *this, &GCodeInterface::set_acceleration);
+  rpc->enroll(instance_name, "set_junction_deviation", *this, &GCodeInterface::set_junction_deviation);
+  rpc->enroll(instance_name, "set_rapid_feedrate", *this, &GCodeInterface::set_rapid_feedrate);
+}
+
+
+// ---- BLOCK STREAM INTERFACE ----
+
+BlockStreamInterface::BlockStreamInterface(){};
+
+void BlockStreamInterface::begin(Stream *target_stream){
+  this->block_stream = target_stream;
+  register_plugin(PLUGIN_LOOP); //this runs in the main program loop
+  target_interpolator.begin();
+  last_reported_slots = target_interpolator.slots_remaining;
+}
+
+void BlockStreamInterface::loop(){
+  // Read whatever has arrived in chunks, up to a few frames' worth per pass so other loop plugins still get a turn.
+  uint8_t receive_chunk[RECEIVE_CHUNK_SIZE];
+  for(uint8_t chunk_count = 0; chunk_count < 8; chunk_count++){
+    int bytes_available = block_stream->available();
+    if(bytes_available <= 0){
+      break;
+    }
+    if(bytes_available > RECEIVE_CHUNK_SIZE){
+      bytes_available = RECEIVE_CHUNK_SIZE;
+    }
+    size_t bytes_read = block_stream->readBytes((char*)receive_chunk, bytes_available);
+    for(size_t byte_index = 0; byte_index < bytes_read; byte_index++){
+      process_byte(receive_chunk[byte_index]);
+    }
+  }
+
+  // The host only learns about credit when we tell it, so report once the queue has drained by enough to be worth a frame.
+  uint16_t slots = target_interpolator.slots_remaining;
+  if(slots >= last_reported_slots + BSI_CREDIT_REPORT_INTERVAL){
+    send_status();
+  }
+}
+
+void BlockStreamInterface::process_byte(uint8_t character){
+  switch(frame_state){
+    case FRAME_WAIT_SYNC:
+      if(character == BSI_SYNC){
+        frame_buffer[0] = character;
+        frame_index = 1;
+        frame_state = FRAME_READ_HEADER;
+      }
+      break;
+
+    case FRAME_READ_HEADER:
+      frame_buffer[frame_index++] = character;
+      if(frame_index == BSI_HEADER_SIZE){
+        frame_state = FRAME_READ_PAYLOAD;
+      }
+      break;
+
+    case FRAME_READ_PAYLOAD:
+      frame_buffer[frame_index++] = character;
+      if(frame_index == BSI_HEADER_SIZE + frame_buffer[3] + BSI_CRC_SIZE){
+        process_frame();
+        frame_state = FRAME_WAIT_SYNC;
+      }
+      break;
+  }
+}
+
+void BlockStreamInterface::process_frame(){
+  uint8_t frame_type = frame_buffer[1];
+  uint8_t sequence = frame_buffer[2];
+  uint8_t payload_length = frame_buffer[3];
+  uint8_t* payload = &frame_buffer[BSI_HEADER_SIZE];
+
+  uint16_t received_crc = payload[payload_length] | (payload[payload_length + 1] << 8);
+  if(crc16(&frame_buffer[1], BSI_HEADER_SIZE - 1 + payload_length) != received_crc){
+    crc_error_count++;
+    if(!resend_requested){
+      send_nak(BSI_NAK_CRC);
+    }
+    return;
+  }
+
+  if(frame_type == BSI_FRAME_RESET){
+    expected_sequence = sequence + 1;
+    resend_requested = false;
+    send_status();
+    return;
+  }
 
-}
\ No newline at end of file
+  if(frame_type != BSI_FRAME_BLOCKS){
+    send_nak(BSI_NAK_FORMAT);
+    return;
+  }
+
+  if(sequence != expected_sequence){
+    // Everything the host sent after a lost frame lands here until it goes back. One NAK is enough to tell it to.
+    sequence_error_count++;
+    if(!resend_requested){
+      send_nak(BSI_NAK_SEQUENCE);
+    }
+    return;
+  }
+
+  resend_requested = false;
+  if(add_blocks(payload, payload_length)){
+    expected_sequence++;
+    send_status();
+  }
+}
+
+bool BlockStreamInterface::add_blocks(const uint8_t* payload, uint8_t payload_length){
+  // First pass checks the whole frame, so that a frame is either queued in full or not at all, and the host can simply resend it.
+  uint16_t num_blocks = 0;
+  uint16_t payload_index = 0;
+  while(payload_index < payload_length){
+    if(payload_index + 6 > payload_length){
+      send_nak(BSI_NAK_FORMAT);
+      return false;
+    }
+    uint8_t mode = payload[payload_index] & ~BSI_BLOCK_VELOCITY;
+    uint8_t axis_mask = payload[payload_index + 1];
+    bool has_all_axes = (axis_mask == (1 << BSI_NUM_AXES) - 1);
+    if((mode > GLOBAL) || (axis_mask >> BSI_NUM_AXES) || ((mode != INCREMENTAL) && !has_all_axes)){
+      send_nak(BSI_NAK_FORMAT);
+      return false;
+    }
+    payload_index += 6;
+    for(uint8_t axis_index = 0; axis_index < BSI_NUM_AXES; axis_index++){
+      if(axis_mask & (1 << axis_index)){
+        payload_index += 4;
+      }
+    }
+    if(payload_index > payload_length){
+      send_nak(BSI_NAK_FORMAT);
+      return false;
+    }
+    num_blocks++;
+  }
+
+  if(num_blocks > target_interpolator.slots_remaining){
+    send_nak(BSI_NAK_NO_CREDIT);
+    return false;
+  }
+
+  payload_index = 0;
+  while(payload_index < payload_length){
+    uint8_t mode = payload[payload_index] & ~BSI_BLOCK_VELOCITY;
+    bool is_velocity = payload[payload_index] & BSI_BLOCK_VELOCITY;
+    uint8_t axis_mask = payload[payload_index + 1];
+    float32_t time_or_velocity;
+    memcpy(&time_or_velocity, &payload[payload_index + 2], 4);
+    payload_index += 6;
+
+    float64_t axis_positions[BSI_NUM_AXES] = {0};
+    for(uint8_t axis_index = 0; axis_index < BSI_NUM_AXES; axis_index++){
+      if(axis_mask & (1 << axis_index)){
+        float32_t axis_value;
+        memcpy(&axis_value, &payload[payload_index], 4);
+        axis_positions[axis_index] = axis_value;
+        payload_index += 4;
+      }
+    }
+
+    if(is_velocity){
+      target_interpolator.add_axes_move(mode, time_or_velocity, axis_positions);
+    }else{
+      target_interpolator.add_timed_axes_move(mode, time_or_velocity, axis_positions);
+    }
+    block_count++;
+  }
+  return true;
+}
+
+void BlockStreamInterface::send_status(){
+  uint16_t slots = target_interpolator.slots_remaining;
+  uint16_t depth = target_interpolator.read_queue_depth();
+  uint8_t payload[4] = {(uint8_t)slots, (uint8_t)(slots >> 8), (uint8_t)depth, (uint8_t)(depth >> 8)};
+  send_frame(BSI_FRAME_STATUS, payload, sizeof(payload));
+  last_reported_slots = slots;
+}
+
+void BlockStreamInterface::send_nak(uint8_t reason){
+  uint16_t slots = target_interpolator.slots_remaining;
+  uint8_t payload[3] = {reason, (uint8_t)slots, (uint8_t)(slots >> 8)};
+  send_frame(BSI_FRAME_NAK, payload, sizeof(payload));
+  last_reported_slots = slots;
+  resend_requested = true;
+}
+
+void BlockStreamInterface::send_frame(uint8_t frame_type, const uint8_t* payload, uint8_t payload_length){
+  uint8_t frame[BSI_HEADER_SIZE + 4 + BSI_CRC_SIZE]; //device frames carry at most 4 bytes of payload
+  uint16_t frame_length = encode_frame(frame, frame_type, expected_sequence, payload, payload_length);
+  block_stream->write(frame, frame_length);
+}
+
+uint16_t BlockStreamInterface::crc16(const uint8_t* data, uint16_t length, uint16_t crc){
+  // CRC16-CCITT, polynomial 0x1021
+  for(uint16_t byte_index = 0; byte_index < length; byte_index++){
+    crc ^= (uint16_t)data[byte_index] << 8;
+    for(uint8_t bit = 0; bit < 8; bit++){
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint8_t BlockStreamInterface::encode_block(uint8_t* buffer, uint8_t mode, float32_t time_or_velocity, uint8_t axis_mask, const float32_t* axis_values){
+  buffer[0] = mode;
+  buffer[1] = axis_mask;
+  memcpy(&buffer[2], &time_or_velocity, 4);
+  uint8_t buffer_index = 6;
+  for(uint8_t axis_index = 0; axis_index < BSI_NUM_AXES; axis_index++){
+    if(axis_mask & (1 << axis_index)){
+      memcpy(&buffer[buffer_index], axis_values++, 4);
+      buffer_index += 4;
+    }
+  }
+  return buffer_index;
+}
+
+uint16_t BlockStreamInterface::encode_frame(uint8_t* buffer, uint8_t frame_type, uint8_t sequence, const uint8_t* payload, uint8_t payload_length){
+  buffer[0] = BSI_SYNC;
+  buffer[1] = frame_type;
+  buffer[2] = sequence;
+  buffer[3] = payload_length;
+  memcpy(&buffer[BSI_HEADER_SIZE], payload, payload_length);
+  uint16_t crc = crc16(&buffer[1], BSI_HEADER_SIZE - 1 + payload_length);
+  buffer[BSI_HEADER_SIZE + payload_length] = (uint8_t)crc;
+  buffer[BSI_HEADER_SIZE + payload_length + 1] = (uint8_t)(crc >> 8);
+  return BSI_HEADER_SIZE + payload_length + BSI_CRC_SIZE;
+}
+
+uint32_t BlockStreamInterface::read_block_count(){
+  return block_count;
+}
+
+uint32_t BlockStreamInterface::read_crc_error_count(){
+  return crc_error_count;
+}
+
+uint32_t BlockStreamInterface::read_sequence_error_count(){
+  return sequence_error_count;
+}
+
+void BlockStreamInterface::enroll(RPC *rpc, const String& instance_name){
+  rpc->enroll(instance_name, "read_block_count", *this, &BlockStreamInterface::read_block_count);
+  rpc->enroll(instance_name, "read_crc_error_count", *this, &BlockStreamInterface::read_crc_error_count);
+  rpc->enroll(instance_name, "read_sequence_error_count", *this, &BlockStreamInterface::read_sequence_error_count);
+  rpc->enroll(instance_name, "set_acceleration", *this, &BlockStreamInterface::set_acceleration);
+  rpc->enroll(instance_name, "set_junction_deviation", *this, &BlockStreamInterface::set_junction_deviation);
+}
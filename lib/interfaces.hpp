@@ -6,8 +6,7 @@
 #include "Arduino.h"
 #include "core.hpp"
 #include "interpolators.hpp"
-#include <map>
-#include <string>
+#include <SD.h>
 
 #ifndef interfaces_h //prevent importing twice
 #define interfaces_h
@@ -44,15 +43,26 @@ A part of the Mixing Metaphors Project
 */
 #define EBB_COMMAND_SIZE  2 //the command portion of the input block is up to two characters long
 #define EBB_MAX_NUM_INPUT_PARAMETERS 10 //maximum allowable number of parameters in an input string
-#define EBB_EXECUTE_IMMEDIATE 0 //command to be executed on receipt, if no other command is pending
-#define EBB_EXECUTE_EMERGENCY 1 //command to be executed on receipt, regardless of whether a command is pending
-#define EBB_EXECUTE_TO_QUEUE 2 //command to be added to the queue
+#define EBB_EXECUTE_IMMEDIATE 0 //command to be executed on receipt, ahead of any commands waiting in the command ring
+#define EBB_EXECUTE_EMERGENCY 1 //command to be executed on receipt, ahead of any commands waiting in the command ring
+#define EBB_EXECUTE_TO_QUEUE 2 //command to be added to the command ring, and executed in order
 #define EBB_BLOCK_PENDING 1 //block is pending
+#define EBB_COMMAND_RING_SIZE 32 //number of queued commands that can wait on space in the interpolator
+
+#define EBB_LATENCY_IMMEDIATE 0 //receipt to response, for commands executed on receipt (e.g. queries)
+#define EBB_LATENCY_QUEUED 1 //receipt to response, for queued commands, which are acknowledged once they're in the command ring
+#define EBB_LATENCY_QUEUED_TO_INTERPOLATOR 2 //receipt to a queued command's motion being added to the interpolator
+#define EBB_NUM_LATENCY_CLASSES 3
 
 #define EBB_SERVO_MAX_POSITION_STEPS 500 // +500us from neutral position (1500us pulse width)
 #define EBB_SERVO_MIN_POSITION_STEPS -500 // -500us from neutral position (1500us pulse width)
 #define EBB_SERVO_MIDPOINT_PULSE_DURATION_US  1500 //pulse duration for the servo midpoint.
 
+#define EBB_TICK_S  0.00004 //the EBB's motion interrupt runs at 25kHz. LT durations, and LM and LT rates, are in these ticks.
+#define EBB_RATE_SCALE  2147483648.0 //LM and LT rates are in steps per tick, scaled by 2^31
+#define EBB_LOW_LEVEL_MAX_SEGMENTS  16 //most blocks that an accelerating LM or LT move is split into
+#define EBB_LOW_LEVEL_SEGMENT_TICKS 125 //shortest block that an accelerating LM or LT move is split into (5ms)
+
 /**
  * @brief Enables using Axidraw commands from over serial as motion stream input.
  * @ingroup interfaces
@@ -74,6 +84,11 @@ class Eibotboard : public Plugin{
      *  @param target_usb_serial A pointer to a communication interface, e.g. &Serial or &SerialUSB1.
      */
     void begin(usb_serial_class *target_usb_serial);
+    /**
+     *  @brief Initialize the EiBotBoard interface on any stream, e.g. a channel of a StreamMultiplexer.
+     *  @param target_stream A pointer to the stream.
+     */
+    void begin(Stream *target_stream);
     /**
      *  @brief Set the conversion ratio between XY steps and millimeters.    
      *  @param output_units_mm The output units in millimeters.
@@ -86,26 +101,46 @@ class Eibotboard : public Plugin{
      * @param input_units_steps The input units in steps.
      */
     void set_ratio_z(float output_units_mm, float input_units_steps); //sets the z conversion between steps and mm
+    // Latency Statistics
+    /**
+     * @brief Returns the mean latency of a class of commands, in microseconds, since the statistics were last reset.
+     * @param latency_class EBB_LATENCY_IMMEDIATE, EBB_LATENCY_QUEUED, or EBB_LATENCY_QUEUED_TO_INTERPOLATOR.
+     */
+    float32_t read_mean_latency_us(uint8_t latency_class);
+    /**
+     * @brief Returns the longest latency of a class of commands, in microseconds, since the statistics were last reset.
+     * @param latency_class EBB_LATENCY_IMMEDIATE, EBB_LATENCY_QUEUED, or EBB_LATENCY_QUEUED_TO_INTERPOLATOR.
+     */
+    uint32_t read_max_latency_us(uint8_t latency_class);
+    /**
+     * @brief Returns the number of commands measured in a class since the statistics were last reset.
+     * @param latency_class EBB_LATENCY_IMMEDIATE, EBB_LATENCY_QUEUED, or EBB_LATENCY_QUEUED_TO_INTERPOLATOR.
+     */
+    uint32_t read_latency_count(uint8_t latency_class);
+    /**
+     * @brief Clears the latency statistics.
+     */
+    void reset_latency_statistics();
+
+    /**
+     * \cond
+     * Hidden from Doxygen: enrollment for RPC exposure.
+     */
+    void enroll(RPC *rpc, const String& instance_name);
+    /** \endcond */
 
     /** 
      * @brief BlockPort for X axis output. Use this to map to downstream components to drive position based on the EiBotBoard x-axis position data.
      */
-    BlockPort& output_x = target_interpolator.output_x;
+    BlockPort& output_x = target_interpolator.output_axes[TBI_AXIS_X];
     /** 
      * @brief BlockPort for Y axis output. Use this to map to downstream components to drive position based on the EiBotBoard y-axis position data.
      */
-    BlockPort& output_y = target_interpolator.output_y;
+    BlockPort& output_y = target_interpolator.output_axes[TBI_AXIS_Y];
     /** 
      * @brief BlockPort for Z axis output. Use this to map to downstream components to drive position based on the EiBotBoard z-axis position data. 
      */
-    BlockPort& output_z = target_interpolator.output_z;
-    /** \cond
-     * hidden from Doxygen. Currently unsure why we need these....
-     */
-    BlockPort& output_e = target_interpolator.output_e;
-    BlockPort& output_r = target_interpolator.output_r;
-    BlockPort& output_t = target_interpolator.output_t;
-    /** \endcond */
+    BlockPort& output_z = target_interpolator.output_axes[TBI_AXIS_Z];
 
     /**
      * @brief Output BlockPort for the generated position signal of a parameter in [0, 1] range.
@@ -127,7 +162,7 @@ class Eibotboard : public Plugin{
     
   private:
       // Interpolator
-    TimeBasedInterpolator target_interpolator;
+    TimeBasedInterpolatorN<3> target_interpolator; //X, Y, and the pen on Z
 
     // Serial Debug State
     uint8_t debug_port_identified; //1 if debug port has been ID'd, otherwise 0
@@ -141,7 +176,10 @@ class Eibotboard : public Plugin{
     // Command Processing
     void process_character(uint8_t character);
     void reset_input_buffer(); //resets the input buffer state
-    void process_command(uint16_t command_value);
+    void process_input_line(); //processes a finished line, unless it has to wait for room in the command ring
+    bool process_command(uint16_t command_value, uint32_t receipt_time_us); //returns false if the command has to wait, unparsed
+    bool input_line_waiting = false; //true if a finished line is waiting in the input buffer. Reading stops until it's processed.
+    uint32_t input_line_receipt_time_us = 0; //when the line in the input buffer ended
     void process_string_int32(); //processes the block string (after the command word) into the input_parameters array.
     static void initialize_all_commands_struct(); //initializes the all_commands struct by pre-calculating the command values.
     struct command{
@@ -149,6 +187,8 @@ class Eibotboard : public Plugin{
       uint16_t command_value; //the command string, converted into a command value during initialization.
       void (Eibotboard::*command_function)(); //pointer to the command function to execute when this command value shows up.
       uint8_t execution; //0 -- immediate execution, 1 -- emergency execution, 2 -- add to queue
+      uint8_t min_parameters; //queued commands with fewer parameters are answered with an error, rather than queued
+      bool (Eibotboard::*check_function)(); //optional. Checks a queued command's parameters before it's acknowledged, and reports any error.
     };
     char input_buffer[255]; //pre-allocate a string buffer to store the serial input stream.
     uint8_t input_buffer_write_index; //stores the current index of the write buffer
@@ -157,12 +197,70 @@ class Eibotboard : public Plugin{
     int32_t input_parameters[EBB_MAX_NUM_INPUT_PARAMETERS]; // parameters that have been parsed from the input string
     uint8_t num_input_parameters; // number of parameters in the string
 
+    // Command Ring
+    //  Queued commands are parsed, checked, and acknowledged as they arrive, and wait here for room in the interpolator. This way
+    //  the host is never held up by a full motion queue, and queries are answered straight away. If the ring is full, one more
+    //  queued command is held, unacknowledged, until there's room, and reading carries on so that queries still run. Only a
+    //  second queued command waits in the input buffer, and stops reading.
+    struct queued_command{
+      uint8_t command_index; //index into all_commands
+      uint8_t num_parameters;
+      int32_t parameters[EBB_MAX_NUM_INPUT_PARAMETERS];
+      uint32_t receipt_time_us; //when the command's line ended
+    };
+    struct queued_command command_ring[EBB_COMMAND_RING_SIZE];
+    uint8_t command_ring_read_index = 0;
+    uint8_t command_ring_write_index = 0;
+    uint8_t command_ring_count = 0;
+    uint32_t executing_command_receipt_time_us = 0; //receipt time of the queued command that's running
+    struct queued_command held_command; //arrived while the ring was full
+    bool command_held = false;
+    void queue_command(uint8_t command_index, uint32_t receipt_time_us); //adds the command in input_parameters to the ring, or holds it
+    void add_to_command_ring(struct queued_command* new_command); //adds a command to the ring, and acknowledges it
+    void release_held_command(); //moves the held command into the ring once there's room
+    void run_command_ring(); //runs queued commands until one has to wait for room in the interpolator
+
+    // Latency Statistics
+    struct latency_statistics{
+      uint32_t count;
+      uint64_t total_us;
+      uint32_t max_us;
+    };
+    struct latency_statistics latency_statistics[EBB_NUM_LATENCY_CLASSES];
+    void record_latency(uint8_t latency_class, uint32_t receipt_time_us);
+
     // Block Generation
     uint16_t block_id = 0; //stores the current block ID, which simply increments each time a new motion-containing block is received
     TimeBasedInterpolator::motion_block pending_block; //stores motion block information that is pending being added to the queue
     uint8_t block_pending_flag = 0; //1 if a block is pending addition to the queue
     uint8_t debug_buffer_full_flag = 0; //1 if already sent a debug message
     void (Eibotboard::*pending_block_function)(); //pointer to the command function whose block is pending
+    void load_motor_move(float32_t move_time_s, float64_t motor_1_delta_steps, float64_t motor_2_delta_steps); //loads pending_block
+    void queue_pending_move(); //tries to add pending_block to the queue, and responds once it's in
+
+    // Motor Positions
+    int32_t motor_1_position_steps = 0; //global step positions, which HM moves relative to
+    int32_t motor_2_position_steps = 0;
+
+    // Low-Level Moves
+    //  LM and LT give each motor a step rate that changes by a fixed acceleration every tick, just as the EBB's motion interrupt
+    //  runs them. We follow the same profile as constant-speed blocks, short enough that the ramps are closely reproduced, while
+    //  the move as a whole takes exactly as many ticks, and steps, as it would on the EBB.
+    struct low_level_axis{
+      float64_t rate_steps_per_tick; //speed at the start of the move
+      float64_t acceleration_steps_per_tick2; //added to the rate each tick. Negative values slow the axis down.
+      float64_t step_limit; //the axis stops once it has taken this many steps
+      int8_t direction; //1 or -1
+    };
+    struct low_level_axis low_level_axes[2];
+    uint32_t low_level_move_ticks; //duration of the move
+    uint8_t low_level_num_segments;
+    uint8_t low_level_next_segment; //next segment to queue
+    bool low_level_segment_loaded = false; //true if the next segment is already in pending_block
+    float64_t low_level_axis_steps(uint8_t axis_index, uint32_t tick); //signed steps taken by an axis after a number of ticks
+    static float64_t low_level_ticks_to_travel(float64_t rate_steps_per_tick, float64_t acceleration_steps_per_tick2, float64_t steps);
+    void start_low_level_move(); //splits the move into segments, and starts queueing them
+    void queue_low_level_move(); //queues as many segments as will fit, and responds once they're all in
     
     // Servo State
     int32_t servo_position_steps = 0; //tracks the current servo position. Unlike other moves, this one is provided in absolute coordinates.
@@ -179,6 +277,11 @@ class Eibotboard : public Plugin{
     void command_query_pen(); //'QL' returns the pen state
     void command_stepper_servo_configure(); //'SC' configures the stepper and servo motors
     void command_stepper_move(); //'SM' moves the stepper motors
+    void command_low_level_move(); //'LM' moves the stepper motors a number of steps, with a starting rate and acceleration for each
+    void command_low_level_time(); //'LT' moves the stepper motors for a number of ticks, with a starting rate and acceleration for each
+    void command_mixed_axis_move(); //'XM' moves the stepper motors, with steps given along the A+B and A-B axes (i.e. X and Y)
+    void command_home_move(); //'HM' moves the stepper motors to an absolute step position, or home
+    bool check_home_move(); //rejects an HM without a step frequency to move at
     void command_set_pen(); //'SP' sets pen position
     void command_version(); //'V' returns the version of the EBB Board
     void command_generic(); //simply returns an OK
@@ -224,30 +327,93 @@ class GCodeInterface : public Plugin{
     void begin(usb_serial_class *target_usb_serial);
     void begin(HardwareSerialIMXRT *target_serial, uint32_t baud, uint16_t format = 0); //hardware serial
     /** \endcond */
+    /**
+     * @brief Sets the acceleration limit of an axis of the internal interpolator. Setting any limit turns on lookahead planning.
+     * @param axis_index The axis to limit, e.g. TBI_AXIS_X.
+     * @param acceleration_per_s2 Maximum acceleration in mm per second squared. 0 removes the limit.
+     */
+    inline void set_acceleration(uint8_t axis_index, float32_t acceleration_per_s2){
+      target_interpolator.set_acceleration(axis_index, acceleration_per_s2);
+    }
+    /**
+     * @brief Sets the cornering tolerance of the internal interpolator.
+     * @param junction_deviation Deviation in mm.
+     */
+    inline void set_junction_deviation(float32_t junction_deviation){
+      target_interpolator.set_junction_deviation(junction_deviation);
+    }
+    /**
+     * @brief Sets the feedrate of rapid (G0) moves.
+     * @param rapid_feedrate_mm_per_min Feedrate in mm per minute. Must be positive.
+     */
+    inline void set_rapid_feedrate(float32_t rapid_feedrate_mm_per_min){
+      if(rapid_feedrate_mm_per_min > 0){
+        this->rapid_feedrate_mm_per_min = rapid_feedrate_mm_per_min;
+      }
+    }
+
+    // File Source
+    /**
+     * @brief Runs a G-code program from the SD card. The file is read ahead into the receive buffer and parsed in loop(), so the
+     * job runs at full speed no matter what the host is doing. While a file runs, realtime commands (e.g. ? and !) still work
+     * over the stream, but lines sent over the stream are ignored. Only errors are reported back.
+     * @code
+     * gcode.start_file("part.gcode");
+     * @endcode
+     * @param filename Name of the file on the SD card.
+     * @return false if the file couldn't be opened, or a file is already running.
+     */
+    bool start_file(const char* filename);
+    /**
+     * @brief Pauses a running file. Stops reading the file, and decelerates to a feed hold.
+     */
+    void pause_file();
+    /**
+     * @brief Resumes a paused file. A cycle start (~) from the stream does the same.
+     */
+    void resume_file();
+    /**
+     * @brief Stops a running file, and clears every queued move. The machine decelerates to a stop first, and a feed hold
+     * that was in effect beforehand is kept. Lines sent over the stream wait until the queue has been cleared.
+     */
+    void abort_file();
+    /**
+     * @brief Returns true while a file is running, including while it is paused.
+     */
+    bool is_running_file();
+    /**
+     * @brief Returns how far through the running file the parser has read, from 0 to 1.
+     */
+    float32_t read_file_progress();
+    /**
+     * @brief Returns the number of lines read from the running file so far.
+     */
+    uint32_t read_file_line_count();
+
+    /**
+     * \cond
+     * Hidden from Doxygen: enrollment for RPC exposure.
+     */
+    void enroll(RPC *rpc, const String& instance_name);
+    /** \endcond */
+
     //BlockPorts
     /** 
      * @brief BlockPort for X axis output. Use this to map to downstream components to drive position based on G-code X-axis commands.
      */     
-    BlockPort& output_x = target_interpolator.output_x;
+    BlockPort& output_x = target_interpolator.output_axes[TBI_AXIS_X];
     /** 
      * @brief BlockPort for Y axis output. Use this to map to downstream components to drive position based on G-code Y-axis commands.
      */ 
-    BlockPort& output_y = target_interpolator.output_y;
+    BlockPort& output_y = target_interpolator.output_axes[TBI_AXIS_Y];
     /** 
      * @brief BlockPort for Z axis output. Use this to map to downstream components to drive position based on G-code Z-axis commands.
      */
-    BlockPort& output_z = target_interpolator.output_z;
+    BlockPort& output_z = target_interpolator.output_axes[TBI_AXIS_Z];
     /** 
      * @brief BlockPort for extruder output. Use this to map to downstream components to drive position based on G-code E-axis commands.
      */
-    BlockPort& output_e = target_interpolator.output_e;
- /**
-    * \cond
-    * hidden from Doxygen.
-    */
-    BlockPort& output_r = target_interpolator.output_r;
-    BlockPort& output_t = target_interpolator.output_t;
-    /** \endcond */
+    BlockPort& output_e = target_interpolator.output_axes[TBI_AXIS_E];
 
     /**
      * @brief Output BlockPort for the generated position signal of a parameter in [0, 1] range.
@@ -262,6 +428,10 @@ class GCodeInterface : public Plugin{
      */
     BlockPort& output_duration = target_interpolator.output_duration;
 
+    /** \cond */
+    uint32_t parsed_line_count = 0; //lines tokenized and matched to a code
+    uint64_t parse_cycles = 0; //total CPU cycles spent tokenizing and matching lines
+    /** \endcond */
 
   protected:
     void loop();
@@ -280,33 +450,75 @@ class GCodeInterface : public Plugin{
 
     uint8_t receiver_state = RECEIVER_READY;
 
+    // 0. Receive Ring
+    //   Characters are read from the stream in bulk, into a ring that the line reader drains. Hosts can stream using GRBL-style
+    //   character counting: every line gets exactly one "ok" or "error" once it has left the ring, and the free space is reported
+    //   in the status report, as Bf:<interpolator slots>,<ring bytes>.
+    static const uint16_t RECEIVE_RING_SIZE = 1024;
+    static const uint8_t RECEIVE_CHUNK_SIZE = 64; //most characters read from the stream at once
+    static const uint8_t MAX_LINES_PER_LOOP = 8; //most lines handled in one pass of loop(), so other loop plugins still get a turn
+    char receive_ring[RECEIVE_RING_SIZE];
+    uint16_t receive_ring_read_index = 0;
+    uint16_t receive_ring_write_index = 0;
+    uint16_t receive_ring_count = 0; //number of characters waiting in the ring
+    void receive_stream(); //moves available characters into the receive ring, running realtime commands as they arrive
+    void reset_receive_ring();
+    void receive_file(); //reads ahead from the running file into the receive ring
+    inline uint16_t receive_ring_free(){
+      return RECEIVE_RING_SIZE - receive_ring_count;
+    }
+
     // 1. Receiving Block Lines
     //   We assume that each line contains at most one block, and that a newline represents the end of a block
-    char input_line_buffer[255]; //pre-allocate a string buffer to store the serial input stream.
+    static const uint16_t INPUT_LINE_BUFFER_SIZE = 255;
+    char input_line_buffer[INPUT_LINE_BUFFER_SIZE]; //pre-allocate a string buffer to store the serial input stream.
     uint8_t input_line_buffer_index; //stores the next position to write to in the input_line_buffer.
+    bool input_line_overflow = false; //true if the line was too long to fit in the buffer
     void reset_input_line_buffer(); //resets the input line buffer.
     bool process_character(uint8_t character);
+    void process_line(); //tokenizes and dispatches a received line, and responds to it
+
+    // 1a. Line Numbers and Checksums
+    //   Hosts may send Marlin-style "N<line> <block>*<checksum>", where the checksum is the XOR of every character before the '*'.
+    //   Numbered lines must arrive in order. A line that fails its checksum or skips ahead is answered with "Resend: <line>",
+    //   and later lines are dropped until that line arrives. Lines resent after they've already run are acknowledged and skipped.
+    //   M110 sets the line number. Lines from a file aren't checked, since there's nobody to resend them.
+    static const uint8_t LINE_NUMBER_WINDOW = 64; //how far back a line number is recognized as having already run
+    uint32_t last_line_number = 0;
+    bool line_resend_requested = false; //true once we've asked for a resend, until the line arrives
+    bool line_has_number = false; //set by check_line() for the current line
+    uint32_t line_number = 0;
+    uint8_t input_line_start_index = 0; //first character of the block, after any line number
+    bool check_line(); //reads the line number and strips the checksum. Returns false, and asks for a resend, if the checksum fails
+    bool check_line_number(); //returns false, and responds, if the line is out of order
+    void request_resend(const char* reason);
 
     // 2. Tokenize Block
-    const char *REALTIME_LETTERS = "\x18?~!";
-    const char *TOKEN_LETTERS = "GMXYZEABCSTHDFPN$="; //a string containing all token letters. Most are G-code except for $ and =.
+    const char *REALTIME_LETTERS = "\x18?~!\x90\x91\x92\x93\x94"; //includes the GRBL feed override characters
+    const char *TOKEN_LETTERS = "GMXYZEABCSTHDFPNIJKQR$="; //a string containing all token letters. Most are G-code except for $ and =.
     static const uint8_t MAX_NUM_TOKENS = 10; //support up to 10 phrases in the incoming block
     static const uint8_t MAX_TOKEN_SIZE = 15; //max characters in a given token. For example, "E110292.6186" is 12 characters.
-    struct token{ //stores a gcode phrase in the incoming block
-      char token_string[MAX_TOKEN_SIZE + 1]; //up to 15 characters. 
+    struct word{ //a lettered value in the incoming block, e.g. X10.5
+      char letter;
+      float64_t value;
     };
 
-  
     struct block{
-      struct token tokens[MAX_NUM_TOKENS]; //all tokens in the block
-      int num_tokens = 0;
-      int key_token_index = -1; //index of the "key" token (i.e. G or M) for the block.
+      struct word words[MAX_NUM_TOKENS]; //all words in the block, except for the key
+      uint8_t num_words = 0;
+      char key_string[MAX_TOKEN_SIZE + 1]; //the "key" token (i.e. G, M, or $) for the block, e.g. "G1". Empty if there isn't one.
       uint8_t execution; //context for execution (e.g. immediate, queue, interpolator)
       void (GCodeInterface::*code_function)(); //pointer to the command function to execute when this command value shows up.
+      bool (GCodeInterface::*prepare_function)(); //checks and resolves the block before it's acknowledged. nullptr if there's nothing to check.
+      float64_t feedrate_mm_per_min; //moves: resolved by the prepare function
+      struct TimeBasedInterpolator::position delta; //moves: XYZE distances from the end of the previous move, resolved by the prepare function
     };
 
     struct block inbound_block; //stores an inbound block
     bool tokenize_block(); //places the input line buffer into inbound_block. Returns true if block has tokens and at least one is a key token.
+    bool token_overflow = false; //true if the last line tokenized had a token longer than MAX_TOKEN_SIZE, which is rejected rather than cut short
+    void close_token(char* token_string, uint8_t token_length); //files a finished token as the key or a word of inbound_block
+    static float64_t parse_decimal(const char* decimal_string); //parses a plain decimal number, without allocating
 
     // 3. Pre-Process Block
     enum{
@@ -316,21 +528,29 @@ class GCodeInterface : public Plugin{
     };
 
     struct code{
-      char code_string[MAX_TOKEN_SIZE + 1]; //e.g. G0, G1, M82
       void (GCodeInterface::*code_function)(); //pointer to the command function to execute when this code shows up.
       uint8_t execution;
+      bool (GCodeInterface::*prepare_function)(); //optional, see prepare_block()
     };
 
-    static struct code all_codes[]; //stores all available codes. This is defined in the .cpp file
+    // Codes are matched by a key packing the letter with its number (for G and M) or its second character (e.g. "$G").
+    static constexpr uint16_t code_key(char letter, uint8_t suffix){
+      return ((uint16_t)(uint8_t)letter << 8) | suffix;
+    }
+    static uint16_t read_code_key(const char* code_string); //returns the key of a code string, or 0 if it can't be a code
 
     bool preprocess_block(); //determines the target function for the block, and the execution scope. Returns true if the block matches to an existant code
-    int8_t find_code(char *code_string); //returns the index of the code in all_codes, or -1 if not found
+    bool find_code(const char* code_string, struct code* found_code); //looks up all available codes. Returns false if not found
+    // Moves are checked, and their feedrates and distances resolved, when the line is received rather than when the block
+    // runs, so that any error is sent in place of the line's ok rather than after it. The parser state (machine_position and
+    // modal_feedrate_mm_per_min) follows the lines received, ahead of the blocks waiting in the queue.
+    bool prepare_block(); //runs the block's prepare function. Returns false, and reports an error, if the block can't run
 
     // 4. Dispatch
     bool dispatch_block(); //dispatches the inbound_block
 
     // 5. Queue
-    static const uint8_t BLOCK_QUEUE_SIZE = 6;
+    static const uint8_t BLOCK_QUEUE_SIZE = 16;
     uint8_t block_queue_read_index = 0; //next block to read
     uint8_t block_queue_write_index = 0; //next block to write
     uint8_t block_queue_slots_remaining = BLOCK_QUEUE_SIZE;
@@ -341,18 +561,26 @@ class GCodeInterface : public Plugin{
     void advance_head(uint8_t* target_head);
     void reset_block_queue();
     uint8_t next_block_execution();
+    void run_block_queue(); //executes queued blocks while the interpolator can take them
 
     // 6. Execution
-    std::map<String, DecimalPosition> execution_tokens;
+    // The words of the executing block, indexed by letter. Bit n of execution_words_present is set if letter 'A' + n was given.
+    DecimalPosition execution_words[26];
+    uint32_t execution_words_present = 0;
+    float64_t execution_feedrate_mm_per_min = 0; //feedrate and distances of the executing move, resolved by its prepare function
+    struct TimeBasedInterpolator::position execution_delta = {};
     void execute_block(block *target_block);
-    void load_tokens(block *target_block); //loads tokens into the execution_tokens map.
+    void load_words(block *target_block); //loads the block's words into execution_words
+    bool has_word(char letter);
 
     // 7. Responses
     enum{
       ERROR_NO_KEY, //GRBL 1
       ERROR_BAD_FORMAT, //GRBL 2
+      ERROR_LINE_OVERFLOW, //GRBL 11
       ERROR_UNSUPPORTED_CODE, //GRBL 20
-      ERROR_NO_FEED_RATE //GRBL 22
+      ERROR_NO_FEED_RATE, //GRBL 22
+      ERROR_INVALID_TARGET //GRBL 33
     };
 
     void send_ok();
@@ -361,26 +589,274 @@ class GCodeInterface : public Plugin{
     // GCode Commands
     void g0_rapid();
     void g1_move();
+    void g2_arc_cw();
+    void g3_arc_ccw();
     void g4_dwell();
+    void g5_bezier(); //cubic Bezier: I J is the first control point relative to the start, P Q the second relative to the end
+    void m110_set_line_number(); //sets the number of the last line received, from N, e.g. "M110 N0" or "N100 M110*<checksum>"
+    void arc_move(int8_t direction);
+    // As in GRBL, an arc's end point must lie on its radius: within 0.005mm, or within 0.1% of the radius up to 0.5mm.
+    static constexpr float32_t ARC_RADIUS_TOLERANCE_MM = 0.005;
+    static constexpr float32_t ARC_RADIUS_RELATIVE_TOLERANCE = 0.001;
+    static constexpr float32_t ARC_RADIUS_MAX_ERROR_MM = 0.5;
+    bool check_feedrate(); //returns false, and reports an error, if there's no feedrate to move at
+    bool prepare_move(); //resolves the feedrate and distances of a move, and advances the parser state to its end
+    bool prepare_rapid(); //prepares a move at the rapid feedrate
+    bool prepare_arc(); //checks the center and end point of an arc, then prepares it as a move
+    bool prepare_bezier(); //checks that a Bezier has both control points, then prepares it as a move
+    void load_delta_positions(struct TimeBasedInterpolator::position* delta); //loads XYZE distances and updates the machine position
+    DecimalPosition read_word(char letter, DecimalPosition default_value);
 
     // system commands
     void _help();
     void _report_parameters();
     void _soft_reset();
-    void _status_report();
+    void _status_report(); //asks for a status report, which loop() sends
     void _cycle_start();
     void _feed_hold();
+    void _feed_override_reset(); //0x90, back to 100%
+    void _feed_override_coarse_plus(); //0x91, +10%
+    void _feed_override_coarse_minus(); //0x92, -10%
+    void _feed_override_fine_plus(); //0x93, +1%
+    void _feed_override_fine_minus(); //0x94, -1%
+    void adjust_feed_override(float32_t delta);
+    static constexpr float32_t FEED_OVERRIDE_COARSE_STEP = 0.1;
+    static constexpr float32_t FEED_OVERRIDE_FINE_STEP = 0.01;
+    static constexpr float32_t FEED_OVERRIDE_MIN = 0.1;
+    static constexpr float32_t FEED_OVERRIDE_MAX = 2.0;
     void _parser_state();
 
+    // Status Reports
+    //   '?' can arrive at any rate, so it only sets a flag, and loop() sends at most one report per pass. Each report is built
+    //   in a fixed buffer and written in one go, so that it doesn't allocate and a polling GUI costs one write per report.
+    static const uint8_t WORK_OFFSET_REPORT_INTERVAL = 10; //like GRBL, WCO is only included in every few reports
+    bool status_report_requested = false;
+    uint8_t reports_since_work_offset = WORK_OFFSET_REPORT_INTERVAL; //the first report includes WCO
+    void send_status_report();
+    // Snapshots the position of the first num_axes interpolator outputs, in mm. If read_downstream is true, it's read through the
+    // BlockPort graph from wherever the outputs are mapped (see BlockPort::read_deep_quiet), otherwise from the outputs themselves.
+    void read_machine_position(DecimalPosition* position_mm, uint8_t num_axes, bool read_downstream);
+
     // 8. "Realtime Commands"
     void execute_realtime(char command);
 
+    // 9. File Source
+    static const uint16_t FILE_READ_SIZE = 512; //read the file a whole SD sector at a time
+    FsFile active_file;
+    bool file_running = false;
+    bool file_paused = false;
+    bool sd_card_initialized = false;
+    uint64_t file_size = 0;
+    uint64_t file_bytes_read = 0; //bytes moved from the file into the receive ring
+    uint32_t file_line_count = 0;
+    void finish_file(); //closes the file and returns to streaming
+    bool file_aborting = false; //true from abort_file() until the machine has stopped and the queue has been cleared
+    bool file_abort_hold_requested = false; //whether a feed hold was requested before the abort, so it can be restored
+    bool finish_file_abort(); //clears the queue once the machine is held. Returns false while it's still decelerating.
+
     // Interpolator
-    TimeBasedInterpolator target_interpolator; 
+    TimeBasedInterpolatorN<4> target_interpolator; //XYZE
 
-    // Execution State
+    // Parser State, as of the last line received (see prepare_block)
     struct TimeBasedInterpolator::position machine_position; //interpreter machine positional state
     float64_t modal_feedrate_mm_per_min = 0; // sets the current feedrate, which persists across blocks
+    float64_t rapid_feedrate_mm_per_min = 3000; // feedrate of G0 moves, see set_rapid_feedrate()
+};
+
+/*
+Block Stream Interface
+
+A framed binary protocol for streaming motion blocks from a host, without the cost of parsing text.
+
+Frame: SYNC, type, sequence, payload length, payload (up to 255 bytes), CRC16-CCITT (little-endian) over type through payload.
+The host sends BLOCKS frames in sequence, and may only send as many blocks as it has credit for. The device answers each frame
+with a STATUS frame, carrying the next sequence it expects and the number of free slots in its queue, which is the host's credit.
+Frames that fail the CRC or arrive out of sequence are answered with a NAK, and the host resends from the expected sequence.
+
+A BLOCKS payload holds one or more blocks, each:
+  mode (INCREMENTAL, ABSOLUTE, or GLOBAL, OR'd with BSI_BLOCK_VELOCITY if a velocity is given instead of a duration)
+  axis mask (bit n set if axis n follows)
+  float32 duration in seconds, or velocity in units per second
+  float32 value for each axis in the mask, in axis order
+Absolute and global blocks must include every axis.
+
+See rpc/block_stream.py for a host-side encoder.
+*/
+#define BSI_SYNC  0x7E
+#define BSI_HEADER_SIZE 4 //sync, type, sequence, payload length
+#define BSI_CRC_SIZE  2
+#define BSI_MAX_PAYLOAD_SIZE  255
+#define BSI_NUM_AXES  6
+
+#define BSI_FRAME_BLOCKS  0x01 //host to device: motion blocks
+#define BSI_FRAME_RESET   0x02 //host to device: restart the sequence at the sequence of this frame
+#define BSI_FRAME_STATUS  0x81 //device to host: next expected sequence, free slots, and queue depth
+#define BSI_FRAME_NAK     0x82 //device to host: next expected sequence, reason, and free slots
+
+#define BSI_NAK_CRC       1 //frame was corrupted
+#define BSI_NAK_SEQUENCE  2 //frame was out of sequence, likely because an earlier frame was lost
+#define BSI_NAK_NO_CREDIT 3 //frame held more blocks than there were free slots
+#define BSI_NAK_FORMAT    4 //frame couldn't be decoded
+
+#define BSI_BLOCK_VELOCITY  0x80 //set in the mode byte if the block gives a velocity rather than a duration
+#define BSI_CREDIT_REPORT_INTERVAL  16 //send a STATUS whenever this many more slots have freed up since the last one
+
+/**
+ * @brief Streams motion blocks from a host over a framed binary protocol, with CRC checks and credit-based flow control.
+ * @ingroup interfaces
+ * 
+ * The BlockStreamInterface feeds an internal TimeBasedInterpolator from a compact binary stream, for CAM tools that generate
+ * dense paths and would otherwise spend most of their time formatting and parsing text. See rpc/block_stream.py for a host-side
+ * encoder.
+ * @code
+ * BlockStreamInterface block_stream;
+ * 
+ * void setup(){
+ *   block_stream.begin(&SerialUSB1);
+ *   block_stream.output_x.map(&axidraw_kinematics.input_x);
+ *   block_stream.output_y.map(&axidraw_kinematics.input_y);
+ * }
+ * @endcode
+ */
+class BlockStreamInterface : public Plugin{
+  public:
+    BlockStreamInterface();
+    /**
+     * @brief Initialize the block stream interface.
+     * @param target_stream The stream to receive frames on, e.g. &SerialUSB1.
+     */
+    void begin(Stream *target_stream);
+    /**
+     * @brief Sets the acceleration limit of an axis of the internal interpolator. Setting any limit turns on lookahead planning.
+     * @param axis_index The axis to limit, e.g. TBI_AXIS_X.
+     * @param acceleration_per_s2 Maximum acceleration in output units per second squared. 0 removes the limit.
+     */
+    inline void set_acceleration(uint8_t axis_index, float32_t acceleration_per_s2){
+      target_interpolator.set_acceleration(axis_index, acceleration_per_s2);
+    }
+    /**
+     * @brief Sets the cornering tolerance of the internal interpolator.
+     * @param junction_deviation Deviation in output units.
+     */
+    inline void set_junction_deviation(float32_t junction_deviation){
+      target_interpolator.set_junction_deviation(junction_deviation);
+    }
+
+    // Link Statistics
+    /**
+     * @brief Returns the number of motion blocks received and queued.
+     */
+    uint32_t read_block_count();
+    /**
+     * @brief Returns the number of frames dropped because they failed the CRC check.
+     */
+    uint32_t read_crc_error_count();
+    /**
+     * @brief Returns the number of frames dropped because they arrived out of sequence.
+     */
+    uint32_t read_sequence_error_count();
+
+    // Encoding
+    // These mirror rpc/block_stream.py, for sketches that generate frames on the device, e.g. to loop them back in a test.
+    /**
+     * @brief Calculates the CRC16-CCITT of a run of bytes.
+     * @param data The bytes to check.
+     * @param length Number of bytes.
+     * @param crc Running CRC, to continue a calculation across several runs.
+     */
+    static uint16_t crc16(const uint8_t* data, uint16_t length, uint16_t crc = 0xFFFF);
+    /**
+     * @brief Encodes a block into a BLOCKS payload.
+     * @param buffer Where to write the block. Needs room for 6 bytes plus 4 per axis.
+     * @param mode INCREMENTAL, ABSOLUTE, or GLOBAL, OR'd with BSI_BLOCK_VELOCITY if time_or_velocity is a velocity.
+     * @param time_or_velocity Duration of the block in seconds, or velocity in units per second.
+     * @param axis_mask Bit n is set if axis n is part of the block.
+     * @param axis_values One value per axis in the mask, in axis order.
+     * @return The number of bytes written.
+     */
+    static uint8_t encode_block(uint8_t* buffer, uint8_t mode, float32_t time_or_velocity, uint8_t axis_mask, const float32_t* axis_values);
+    /**
+     * @brief Wraps a payload in a frame.
+     * @param buffer Where to write the frame. Needs room for the payload plus BSI_HEADER_SIZE + BSI_CRC_SIZE bytes.
+     * @return The number of bytes written.
+     */
+    static uint16_t encode_frame(uint8_t* buffer, uint8_t frame_type, uint8_t sequence, const uint8_t* payload, uint8_t payload_length);
+
+    /**
+     * \cond
+     * Hidden from Doxygen: enrollment for RPC exposure.
+     */
+    void enroll(RPC *rpc, const String& instance_name);
+    /** \endcond */
+
+    //BlockPorts
+    /** 
+     * @brief BlockPort for X axis output.
+     */
+    BlockPort& output_x = target_interpolator.output_x;
+    /** 
+     * @brief BlockPort for Y axis output.
+     */
+    BlockPort& output_y = target_interpolator.output_y;
+    /** 
+     * @brief BlockPort for Z axis output.
+     */
+    BlockPort& output_z = target_interpolator.output_z;
+    /** 
+     * @brief BlockPort for E axis output.
+     */
+    BlockPort& output_e = target_interpolator.output_e;
+    /** 
+     * @brief BlockPort for R axis output.
+     */
+    BlockPort& output_r = target_interpolator.output_r;
+    /** 
+     * @brief BlockPort for T axis output.
+     */
+    BlockPort& output_t = target_interpolator.output_t;
+    /**
+     * @brief Output BlockPort for the generated position signal of a parameter in [0, 1] range.
+     * The parameter varies from 0 to 1 along each block.
+     */
+    BlockPort& output_parameter = target_interpolator.output_parameter;
+    /**
+     * @brief Output BlockPort for the duration of the active block.
+     */
+    BlockPort& output_duration = target_interpolator.output_duration;
+
+  protected:
+    void loop();
+
+  private:
+    Stream *block_stream;
+    TimeBasedInterpolator target_interpolator;
+
+    // Receiving Frames
+    enum{
+      FRAME_WAIT_SYNC,
+      FRAME_READ_HEADER,
+      FRAME_READ_PAYLOAD
+    };
+    static const uint8_t RECEIVE_CHUNK_SIZE = 64; //most bytes read from the stream at once
+    uint8_t frame_state = FRAME_WAIT_SYNC;
+    uint8_t frame_buffer[BSI_HEADER_SIZE + BSI_MAX_PAYLOAD_SIZE + BSI_CRC_SIZE];
+    uint16_t frame_index = 0; //next byte to write in frame_buffer
+    void process_byte(uint8_t character);
+    void process_frame();
+    bool add_blocks(const uint8_t* payload, uint8_t payload_length); //returns false, and sends a NAK, if the blocks can't be queued
+
+    // Flow Control
+    uint8_t expected_sequence = 0;
+    bool resend_requested = false; //true once we've sent a NAK, until the expected frame arrives. Avoids a NAK for every frame in flight.
+    uint16_t last_reported_slots = 0;
+    void send_status();
+    void send_nak(uint8_t reason);
+    void send_frame(uint8_t frame_type, const uint8_t* payload, uint8_t payload_length);
+
+    // Link Statistics
+    uint32_t block_count = 0;
+    uint32_t crc_error_count = 0;
+    uint32_t sequence_error_count = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
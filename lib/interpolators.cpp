@@ -1,5 +1,6 @@
 #include <iterator>
 #include <cmath>
+#include <cstring>
 #include "arm_math.h"
 /*
 Interpolator Module of the StepDance Control System
@@ -18,19 +19,55 @@ A part of the Mixing Metaphors Project
 #include "core.hpp"
 #include "rpc.hpp"
 
+TimeBasedInterpolatorBase::TimeBasedInterpolatorBase(uint8_t num_axes, BlockPort* axis_ports, struct axis_state* axes, struct queued_block_header* default_block_queue, uint16_t block_stride){
+  this->num_axes = num_axes;
+  this->axis_ports = axis_ports;
+  this->axes = axes;
+  this->block_queue = default_block_queue;
+  this->block_stride = block_stride;
+};
+
 TimeBasedInterpolator::TimeBasedInterpolator(){};
 
-int16_t TimeBasedInterpolator::add_block(struct motion_block* block_to_add){
+int16_t TimeBasedInterpolatorBase::add_block(struct motion_block* block_to_add){
   // Adds a motion block to the interpolator
   //
   // block_to_add -- a pointer to a TimeBasedInterpolator::motion_block struct.
   //
   // Returns the number of available slots in the motion queue AFTER the block was added.
   // A return value of -1 indicates that the block was not loaded due to lack of space.
-  if(slots_remaining){
-    block_queue[next_write_index] = *block_to_add; //shallow copy, not positive this will work
+  struct position* block_position = &block_to_add->block_position;
+  float64_t axis_values[TBI_MAX_AXES] = {block_position->x_mm, block_position->y_mm, block_position->z_mm,
+                                         block_position->e_mm, block_position->r_mm, block_position->t_rad}; //in axis order
+  return queue_block(block_to_add->block_type, block_to_add->block_id, block_to_add->block_time_s, block_to_add->block_velocity_per_s, axis_values, block_to_add->curve_values, block_to_add->block_flags);
+}
+
+int16_t TimeBasedInterpolatorBase::queue_block(uint8_t block_type, uint32_t block_id, float32_t block_time_s, float32_t block_velocity_per_s, const float64_t* axis_values, const float32_t* curve_values, uint8_t block_flags){
+  if(!queue_is_full()){
+    // With nothing queued, the frame won't look at the pulled end positions until this block is published, so both ends of
+    // the queue can be re-synced to where the axes are now. That keeps queued values small, whatever's been moving the axes.
+    noInterrupts();
+    if(slots_remaining == block_queue_depth){
+      for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+        axes[axis_index].queued_end_position = axes[axis_index].output_position;
+        axes[axis_index].pulled_end_position = axes[axis_index].output_position;
+      }
+    }
+    interrupts();
+    struct queued_block_header* block = queued_block_at(next_write_index);
+    encode_block(block_type, block_id, block_time_s, block_velocity_per_s, axis_values, curve_values, block_flags, block);
+    float32_t* bezier_table = nullptr;
+    if(block_type == BLOCK_TYPE_BEZIER){ //the arc-length table is built here rather than in the frame, where it would be too slow
+      bezier_table = bezier_tables[bezier_tables_queued % TBI_BEZIER_TABLE_SLOTS];
+      build_bezier_table(block, bezier_table);
+    }
+    plan_block(block, bezier_table); //must be planned before the frame can see it
+    if(bezier_table){
+      bezier_tables_queued ++;
+    }
     slots_remaining --;
     advance_head(&next_write_index);
+    plan_reverse_pass();
     return (int16_t)slots_remaining;
   }
   else{
@@ -38,121 +75,423 @@ int16_t TimeBasedInterpolator::add_block(struct motion_block* block_to_add){
   }
 }
 
-int16_t TimeBasedInterpolator::add_move(uint8_t mode, float32_t move_velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
+void TimeBasedInterpolatorBase::encode_block(uint8_t block_type, uint32_t block_id, float32_t block_time_s, float32_t block_velocity_per_s, const float64_t* axis_values, const float32_t* curve_values, uint8_t block_flags, struct queued_block_header* encoded_block){
+  // Packs a motion block into the compact form stored in the queue.
+  // Positions are stored as float32, along with a mask of the axes that take part in the move. Absolute targets are stored
+  // relative to the queued end position, and incremental distances carry their rounding into the next block, so neither
+  // loses precision far from the origin or over many blocks.
+  encoded_block->block_type = block_type;
+  encoded_block->block_flags = block_flags;
+  encoded_block->block_id = (uint16_t)block_id;
+  encoded_block->block_time_s = block_time_s;
+  encoded_block->block_velocity_per_s = block_velocity_per_s;
+
+  float32_t* encoded_axis_values = block_axis_values(encoded_block);
+  bool is_absolute = (block_type == BLOCK_TYPE_ABSOLUTE) || (block_type == BLOCK_TYPE_GLOBAL);
+  bool is_curve = (block_type == BLOCK_TYPE_ARC) || (block_type == BLOCK_TYPE_BEZIER);
+  encoded_block->axis_mask = 0;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    if(is_absolute || (axis_values[axis_index] != 0)){ //absolute blocks always specify every axis
+      encoded_block->axis_mask |= (1 << axis_index);
+    }
+  }
+  if(is_curve){ //curves move in X and Y even if they end where they started
+    encoded_block->axis_mask |= (1 << TBI_AXIS_X) | (1 << TBI_AXIS_Y);
+  }
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    struct axis_state* axis = &axes[axis_index];
+    if(!(encoded_block->axis_mask & (1 << axis_index))){
+      encoded_axis_values[axis_index] = 0;
+      continue;
+    }
+    float32_t encoded_value;
+    if(is_absolute){
+      encoded_value = axis_values[axis_index] - axis->queued_end_position;
+      axis->rounding_carry = 0; //the target is exact, whatever came before it
+    }else{
+      float64_t exact_value = axis_values[axis_index] + axis->rounding_carry;
+      encoded_value = exact_value;
+      axis->rounding_carry = exact_value - encoded_value;
+    }
+    encoded_axis_values[axis_index] = encoded_value;
+    axis->queued_end_position += encoded_value; //pull_block adds the same values, in the same order
+  }
+  for(uint8_t value_index = 0; value_index < 4; value_index++){
+    encoded_block->curve_values[value_index] = curve_values[value_index];
+  }
+}
+
+int16_t TimeBasedInterpolatorBase::add_move(uint8_t mode, float32_t move_velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
   return _add_move(mode, 0, move_velocity_per_s, x, y, z, e, r, t);
 }
 
-int16_t TimeBasedInterpolator::add_timed_move(uint8_t mode, float32_t move_time_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
+int16_t TimeBasedInterpolatorBase::add_timed_move(uint8_t mode, float32_t move_time_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
   return _add_move(mode, move_time_s, 0, x, y, z, e, r, t);
 }
 
+int16_t TimeBasedInterpolatorBase::add_axes_move(uint8_t mode, float32_t move_velocity_per_s, const float64_t* axis_positions){
+  return _add_axes_move(mode, 0, move_velocity_per_s, axis_positions);
+}
 
-int16_t TimeBasedInterpolator::_add_move(uint8_t mode, float32_t move_time_s, float32_t move_velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
-  struct motion_block new_block;
-  new_block.block_position.x_mm = x;
-  new_block.block_position.y_mm = y;
-  new_block.block_position.z_mm = z;
-  new_block.block_position.e_mm = e;
-  new_block.block_position.r_mm = r;
-  new_block.block_position.t_rad = t;
-  new_block.block_time_s = move_time_s;
-  new_block.block_velocity_per_s = move_velocity_per_s;
+int16_t TimeBasedInterpolatorBase::add_timed_axes_move(uint8_t mode, float32_t move_time_s, const float64_t* axis_positions){
+  return _add_axes_move(mode, move_time_s, 0, axis_positions);
+}
+
+int16_t TimeBasedInterpolatorBase::_add_move(uint8_t mode, float32_t move_time_s, float32_t move_velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t){
+  float64_t axis_positions[TBI_MAX_AXES] = {x, y, z, e, r, t};
+  return _add_axes_move(mode, move_time_s, move_velocity_per_s, axis_positions);
+}
+
+int16_t TimeBasedInterpolatorBase::_add_axes_move(uint8_t mode, float32_t move_time_s, float32_t move_velocity_per_s, const float64_t* axis_positions){
+  uint8_t block_type = BLOCK_TYPE_INCREMENTAL;
   switch(mode){
     case INCREMENTAL:
-      new_block.block_type = BLOCK_TYPE_INCREMENTAL;
+      block_type = BLOCK_TYPE_INCREMENTAL;
       break;
     case ABSOLUTE:
-      new_block.block_type = BLOCK_TYPE_ABSOLUTE;
+      block_type = BLOCK_TYPE_ABSOLUTE;
       break;
     case GLOBAL:
-      new_block.block_type = BLOCK_TYPE_GLOBAL;
+      block_type = BLOCK_TYPE_GLOBAL;
       break;
   }
+  const float32_t curve_values[4] = {0, 0, 0, 0};
+  return queue_block(block_type, 0, move_time_s, move_velocity_per_s, axis_positions, curve_values);
+}
+
+int16_t TimeBasedInterpolatorBase::add_arc(float32_t velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition center_x, DecimalPosition center_y, int8_t direction, DecimalPosition z, DecimalPosition e){
+  if(num_axes < 2){ //arcs are in the XY plane
+    return -1;
+  }
+  struct motion_block new_block = {};
+  new_block.block_type = BLOCK_TYPE_ARC;
+  new_block.block_velocity_per_s = velocity_per_s;
+  new_block.block_position.x_mm = x;
+  new_block.block_position.y_mm = y;
+  new_block.block_position.z_mm = z;
+  new_block.block_position.e_mm = e;
+
+  // the sweep runs from the start angle to the end angle in the given direction. If they're the same, we make a full circle.
+  float64_t start_angle = std::atan2(-center_y, -center_x);
+  float64_t end_angle = std::atan2(y - center_y, x - center_x);
+  float64_t sweep_rad = end_angle - start_angle;
+  if(direction == TBI_ARC_CW){
+    if(sweep_rad >= 0){
+      sweep_rad -= 2 * M_PI;
+    }
+  }else{
+    if(sweep_rad <= 0){
+      sweep_rad += 2 * M_PI;
+    }
+  }
+  new_block.curve_values[0] = center_x;
+  new_block.curve_values[1] = center_y;
+  new_block.curve_values[2] = sweep_rad;
+  return add_block(&new_block);
+}
 
+int16_t TimeBasedInterpolatorBase::add_bezier(float32_t velocity_per_s, DecimalPosition control_1_x, DecimalPosition control_1_y, DecimalPosition control_2_x, DecimalPosition control_2_y, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e){
+  if(num_axes < 2){ //curves are in the XY plane
+    return -1;
+  }
+  struct motion_block new_block = {};
+  new_block.block_type = BLOCK_TYPE_BEZIER;
+  new_block.block_velocity_per_s = velocity_per_s;
+  new_block.block_position.x_mm = x;
+  new_block.block_position.y_mm = y;
+  new_block.block_position.z_mm = z;
+  new_block.block_position.e_mm = e;
+  new_block.curve_values[0] = control_1_x;
+  new_block.curve_values[1] = control_1_y;
+  new_block.curve_values[2] = control_2_x;
+  new_block.curve_values[3] = control_2_y;
   return add_block(&new_block);
 }
 
-void TimeBasedInterpolator::advance_head(volatile uint16_t* target_head){
+void TimeBasedInterpolatorBase::advance_head(volatile uint16_t* target_head){
   (*target_head)++;
-  if(*target_head == TBI_BLOCK_QUEUE_SIZE){
+  if(*target_head == block_queue_depth){
     *target_head = 0;
   }
 }
 
-void TimeBasedInterpolator::reset_block_queue(){
-  slots_remaining = TBI_BLOCK_QUEUE_SIZE;
+void TimeBasedInterpolatorBase::reset_block_queue(){
+  slots_remaining = block_queue_depth;
   next_read_index = 0;
   next_write_index = 0;
+  bezier_tables_queued = 0;
+  bezier_tables_released = 0;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){ //end positions are re-synced by the next block queued
+    axes[axis_index].rounding_carry = 0;
+  }
 
   // cancel current block
   in_block = 0;
+  carried_frame_fraction = 0;
+  active_speed_per_frame = 0;
+  last_block_plannable = false;
+  job_running = false;
+  idle_frames = 0;
 }
 
-bool TimeBasedInterpolator::is_idle(){
+bool TimeBasedInterpolatorBase::is_idle(){
   //returns true if the interpolator is idle
-  if(slots_remaining == TBI_BLOCK_QUEUE_SIZE && in_block == 0){
+  if(slots_remaining == block_queue_depth && in_block == 0){
     return true;
   }else{
     return false;
   }
 }
 
-bool TimeBasedInterpolator::queue_is_full(){
-  return (slots_remaining == 0);
+bool TimeBasedInterpolatorBase::queue_is_full(){
+  uint16_t bezier_tables_in_use = bezier_tables_queued - bezier_tables_released;
+  return (slots_remaining == 0) || (bezier_tables_in_use == TBI_BEZIER_TABLE_SLOTS);
 };
 
-void TimeBasedInterpolator::run(){
-  if((in_block == 0) && (slots_remaining < TBI_BLOCK_QUEUE_SIZE)){ //idle, but a new block is available
-    pull_block();
+void TimeBasedInterpolatorBase::run(){
+  // A block usually ends partway through a frame. Rather than rounding its time to whole frames, the rest of the frame
+  // carries into the next block, so that block timing stays exact over any number of blocks. Time carried over because we
+  // ran out of blocks for a frame is paid back a little each frame, so that it doesn't show up as a jump in speed.
+  ramp_override();
+  float32_t carry_used = std::min((float32_t)carried_frame_fraction, (float32_t)TBI_MAX_CARRY_PER_FRAME);
+  float32_t frame_fraction = 1.0 + carry_used;
+  carried_frame_fraction -= carry_used;
+  bool frame_has_run = false;
+  for(uint8_t block_count = 0; block_count < TBI_MAX_BLOCKS_PER_FRAME; block_count++){
+    if((in_block == 0) && (slots_remaining < block_queue_depth)){ //idle, but a new block is available
+      uint32_t pull_entry_cycle_count = ARM_DWT_CYCCNT;
+      pull_block();
+      uint32_t pull_cycles = ARM_DWT_CYCCNT - pull_entry_cycle_count;
+      if(pull_cycles > max_pull_block_cycles){
+        max_pull_block_cycles = pull_cycles;
+      }
+      if(in_block){
+        record_block_pulled();
+      }
+    }
+    if(!in_block){
+      if(slots_remaining < block_queue_depth){
+        continue; //the block was skipped, so try the next one
+      }
+      break; //queue is empty
+    }
+    //when a block is first loaded, we're already at the end of the move's first frame, so we need to do something.
+    frame_fraction = run_frame_on_active_block(frame_fraction);
+    frame_has_run = true;
+    active_block_frames ++;
+    if(!in_block){
+      record_block_finished();
+    }
+    if(frame_fraction <= 0){
+      break;
+    }
+  }
+  if((frame_fraction > 0) && (slots_remaining < block_queue_depth)){ //ran out of blocks we're allowed to run this frame
+    // Capped at a frame, so that a backlog of very short blocks can't build up an ever-growing debt. Blocks shorter than
+    // 1/TBI_MAX_BLOCKS_PER_FRAME of a frame reach the cap if they keep coming, and then run slower than their block time.
+    // The time dropped here is how far they fall behind, and is kept in lost_frame_time.
+    float32_t carry = carried_frame_fraction + frame_fraction;
+    if(carry > 1.0f){
+      lost_frame_time += carry - 1.0f;
+      carry = 1.0f;
+    }
+    carried_frame_fraction = carry;
+  }else if(!in_block && (slots_remaining == block_queue_depth)){ //out of blocks, so there's nothing to pay the carry back into
+    carried_frame_fraction = 0;
+  }
+
+  if(!frame_has_run){
+    active_speed_per_frame = 0; //nothing to run, so we've come to a stop
+    if(job_running){
+      idle_frames ++;
+      if(idle_frames > TBI_JOB_IDLE_TIMEOUT_FRAMES){ //waited long enough that this is the end of the job
+        job_running = false;
+      }
+    }
+  }
+}
+
+// -- SPEED OVERRIDE AND FEED HOLD --
+
+void TimeBasedInterpolatorBase::ramp_override(){
+  float32_t target_override = feed_hold_active ? 0 : (float32_t)speed_overide;
+  if(!in_block && (active_speed_per_frame == 0)){ //not moving, so the override can change immediately
+    active_override = target_override;
+    return;
+  }
+  float32_t override_step = override_ramp_rate_per_s * CORE_FRAME_PERIOD_S;
+  if(planner_enabled && (active_nominal_speed_per_frame > 0)){ //change speed at the acceleration of the active move
+    override_step = active_acceleration_per_frame2 / active_nominal_speed_per_frame;
+  }
+  if(active_override < target_override){
+    active_override = std::min(active_override + override_step, target_override);
+  }else{
+    active_override = std::max(active_override - override_step, target_override);
+  }
+}
+
+void TimeBasedInterpolatorBase::set_override_ramp_rate(float32_t ramp_rate_per_s){
+  override_ramp_rate_per_s = ramp_rate_per_s;
+}
+
+void TimeBasedInterpolatorBase::feed_hold(){
+  feed_hold_active = true;
+}
+
+void TimeBasedInterpolatorBase::resume(){
+  feed_hold_active = false;
+}
+
+bool TimeBasedInterpolatorBase::is_held(){
+  return feed_hold_active && (active_override == 0);
+}
+
+bool TimeBasedInterpolatorBase::feed_hold_requested(){
+  return feed_hold_active;
+}
+
+float32_t TimeBasedInterpolatorBase::read_speed_per_s(){
+  if(!in_block || active_block_is_dwell){
+    return 0;
+  }
+  return active_speed_per_frame * CORE_FRAME_FREQ_HZ;
+}
+
+// -- QUEUE HEALTH --
+
+void TimeBasedInterpolatorBase::record_block_pulled(){
+  if(job_running && idle_frames){ //the queue ran dry mid-job
+    starved_frame_count += idle_frames;
+    starvation_count ++;
+  }
+  job_running = true;
+  idle_frames = 0;
+  active_block_frames = 0;
+
+  uint16_t queue_fill = block_queue_depth - slots_remaining;
+  if(queue_fill < min_queue_fill){
+    min_queue_fill = queue_fill;
+  }
+  uint32_t fill_bin = ((uint32_t)queue_fill * TBI_FILL_HISTOGRAM_NUM_BINS) / (block_queue_depth + 1);
+  fill_histogram[fill_bin] ++;
+}
+
+void TimeBasedInterpolatorBase::record_block_finished(){
+  uint8_t duration_bin = 0;
+  while((active_block_frames >> (duration_bin + 1)) && (duration_bin < (TBI_DURATION_HISTOGRAM_NUM_BINS - 1))){
+    duration_bin ++;
+  }
+  duration_histogram[duration_bin] ++;
+}
+
+uint32_t TimeBasedInterpolatorBase::read_starved_frame_count(){
+  return starved_frame_count;
+}
+
+uint32_t TimeBasedInterpolatorBase::read_starvation_count(){
+  return starvation_count;
+}
+
+uint16_t TimeBasedInterpolatorBase::read_min_queue_fill(){
+  return min_queue_fill;
+}
+
+float32_t TimeBasedInterpolatorBase::read_lost_time_s(){
+  return lost_frame_time * CORE_FRAME_PERIOD_S;
+}
+
+uint32_t TimeBasedInterpolatorBase::read_skipped_block_count(){
+  return skipped_block_count;
+}
+
+uint32_t TimeBasedInterpolatorBase::read_duration_histogram_bin(uint8_t bin_index){
+  if(bin_index >= TBI_DURATION_HISTOGRAM_NUM_BINS){
+    return 0;
+  }
+  return duration_histogram[bin_index];
+}
+
+uint32_t TimeBasedInterpolatorBase::read_fill_histogram_bin(uint8_t bin_index){
+  if(bin_index >= TBI_FILL_HISTOGRAM_NUM_BINS){
+    return 0;
+  }
+  return fill_histogram[bin_index];
+}
+
+void TimeBasedInterpolatorBase::reset_statistics(){
+  for(uint8_t bin_index = 0; bin_index < TBI_DURATION_HISTOGRAM_NUM_BINS; bin_index++){
+    duration_histogram[bin_index] = 0;
   }
-  if(in_block){ //when a block is first loaded, we're already at the end of the move's first frame, so we need to do something.
-    run_frame_on_active_block();
+  for(uint8_t bin_index = 0; bin_index < TBI_FILL_HISTOGRAM_NUM_BINS; bin_index++){
+    fill_histogram[bin_index] = 0;
   }
+  starved_frame_count = 0;
+  starvation_count = 0;
+  min_queue_fill = block_queue_depth;
+  skipped_block_count = 0;
+  lost_frame_time = 0;
+  max_pull_block_cycles = 0;
 }
 
-void TimeBasedInterpolator::pull_block(){
+void TimeBasedInterpolatorBase::pull_block(){
   //Pulls a block from the queue and configures active registers for a move
 
   // Step 1: calculate remaining distance, based on mode
-  uint8_t block_type = block_queue[next_read_index].block_type;
-  if(block_type == BLOCK_TYPE_INCREMENTAL){ //INCREMENTAL positions were provided, copy directly
-    active_axes_remaining_distance_mm[TBI_AXIS_X] = block_queue[next_read_index].block_position.x_mm;
-    active_axes_remaining_distance_mm[TBI_AXIS_Y] = block_queue[next_read_index].block_position.y_mm;
-    active_axes_remaining_distance_mm[TBI_AXIS_Z] = block_queue[next_read_index].block_position.z_mm;
-    active_axes_remaining_distance_mm[TBI_AXIS_E] = block_queue[next_read_index].block_position.e_mm;
-    active_axes_remaining_distance_mm[TBI_AXIS_R] = block_queue[next_read_index].block_position.r_mm;
-    active_axes_remaining_distance_mm[TBI_AXIS_T] = block_queue[next_read_index].block_position.t_rad;
-    active_axes_remaining_distance_mm[TBI_AXIS_V] = 1; //virtual axis, always set to 1mm    
-  }else{ //ABSOLUTE OR GLOBAL positions provided
-    if(block_type == BLOCK_TYPE_GLOBAL){ //synchronize state on all positions
-      output_x.pull_deep();
-      output_y.pull_deep();
-      output_z.pull_deep();
-      output_e.pull_deep();
-      output_r.pull_deep();
-      output_t.pull_deep();
-    }
-    active_axes_remaining_distance_mm[TBI_AXIS_X] = block_queue[next_read_index].block_position.x_mm - output_position_x;
-    active_axes_remaining_distance_mm[TBI_AXIS_Y] = block_queue[next_read_index].block_position.y_mm - output_position_y;
-    active_axes_remaining_distance_mm[TBI_AXIS_Z] = block_queue[next_read_index].block_position.z_mm - output_position_z;
-    active_axes_remaining_distance_mm[TBI_AXIS_E] = block_queue[next_read_index].block_position.e_mm - output_position_e;
-    active_axes_remaining_distance_mm[TBI_AXIS_R] = block_queue[next_read_index].block_position.r_mm - output_position_r;
-    active_axes_remaining_distance_mm[TBI_AXIS_T] = block_queue[next_read_index].block_position.t_rad - output_position_t;
-    active_axes_remaining_distance_mm[TBI_AXIS_V] = 1; //virtual axis, always set to 1mm   
-  }
-
-  float32_t block_time_s = block_queue[next_read_index].block_time_s;
-  float32_t block_velocity_per_s = block_queue[next_read_index].block_velocity_per_s;
+  struct queued_block_header* block = queued_block_at(next_read_index);
+  float32_t* axis_values = block_axis_values(block);
+  uint8_t block_type = block->block_type;
+  if(block_type == BLOCK_TYPE_BEZIER){ //take the curve's table, which frees its slot even if the block is skipped
+    memcpy(active_bezier_table, bezier_tables[bezier_tables_released % TBI_BEZIER_TABLE_SLOTS], sizeof(active_bezier_table));
+    bezier_tables_released ++;
+  }
+  if(block_type == BLOCK_TYPE_GLOBAL){ //synchronize state on all positions
+    for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+      axis_ports[axis_index].pull_deep();
+    }
+  }
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    if(!(block->axis_mask & (1 << axis_index))){ //axis isn't part of the block
+      axes[axis_index].remaining_distance_mm = 0;
+      continue;
+    }
+    float64_t target_position = axes[axis_index].pulled_end_position + axis_values[axis_index];
+    if((block_type != BLOCK_TYPE_ABSOLUTE) && (block_type != BLOCK_TYPE_GLOBAL)){ //INCREMENTAL positions were provided, copy directly
+      axes[axis_index].remaining_distance_mm = axis_values[axis_index];
+    }else{ //ABSOLUTE OR GLOBAL positions provided, relative to the end of the previous block
+      axes[axis_index].remaining_distance_mm = target_position - axes[axis_index].output_position;
+    }
+    axes[axis_index].pulled_end_position = target_position; //as encode_block added it
+  }
+
+  // Step 2: calculate the path length.
+  // Along a curve, X and Y together travel the length of the curve rather than the distance between its ends.
+  active_curve_type = 0;
+  float32_t planar_length = 0;
+  if((block_type == BLOCK_TYPE_ARC) || (block_type == BLOCK_TYPE_BEZIER)){
+    planar_length = curve_planar_length(block, active_bezier_table);
+  }
+  float64_t axis_distances[TBI_MAX_AXES];
+  float64_t path_length = 0;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){ //iterate over all axes to calc distance^2
+    axis_distances[axis_index] = axes[axis_index].remaining_distance_mm;
+    if((planar_length > 0) && ((axis_index == TBI_AXIS_X) || (axis_index == TBI_AXIS_Y))){
+      axis_distances[axis_index] = planar_length; //either axis could take the full length of the curve
+      continue;
+    }
+    path_length += (axis_distances[axis_index] * axis_distances[axis_index]);
+  }
+  path_length = std::sqrt(path_length + planar_length * planar_length);
+
+  float32_t block_time_s = block->block_time_s;
+  float32_t block_velocity_per_s = block->block_velocity_per_s;
   if(block_time_s == 0){ //velocity-based move
-    if(block_velocity_per_s > 0){ //need to calculate block time based on velocity and distance
-      float64_t move_distance = 0;
-      for(uint8_t axis_index = 0; axis_index < TBI_NUM_AXES; axis_index++){ //iterate over all axes to calc distance^2
-        move_distance += (active_axes_remaining_distance_mm[axis_index] * active_axes_remaining_distance_mm[axis_index]);
-      }
-      move_distance = std::sqrt(move_distance);
-      block_time_s = move_distance / block_velocity_per_s;
-    }else{
-      return; //both time and velocity are zero, skip block.
+    if((block_velocity_per_s > 0) && (path_length > 0)){ //need to calculate block time based on velocity and distance
+      block_time_s = path_length / block_velocity_per_s;
+    }else{ //nothing to do, skip block.
+      skipped_block_count ++;
+      slots_remaining ++;
+      advance_head(&next_read_index);
+      return;
     }
   }
 
@@ -163,14 +502,50 @@ void TimeBasedInterpolator::pull_block(){
   output_parameter.set(0, ABSOLUTE);
   output_parameter.push();
 
+  // Step 3: configure the path. Blocks without motion run along a virtual path of length 1.
+  if(active_block_is_dwell){ //speed along a virtual path doesn't carry over into a real one
+    active_speed_per_frame = 0;
+  }
+  if(path_length > 0){
+    active_block_is_dwell = false;
+    active_remaining_path_length = path_length;
+    active_acceleration_per_frame2 = path_acceleration(axis_distances, path_length) * CORE_FRAME_PERIOD_S * CORE_FRAME_PERIOD_S;
+  }else{
+    active_block_is_dwell = true;
+    active_remaining_path_length = 1;
+    active_acceleration_per_frame2 = TBI_UNLIMITED_ACCELERATION;
+  }
+  active_path_length = active_remaining_path_length;
+  active_block_is_exact = block->block_flags & TBI_BLOCK_EXACT_TIMING;
+  active_nominal_speed_per_frame = (active_remaining_path_length / block_time_s) * CORE_FRAME_PERIOD_S;
+  if(planner_enabled && (block->nominal_speed_per_s > 0)){ //the planner may have limited the speed, e.g. around a tight curve
+    active_nominal_speed_per_frame = std::min((float32_t)active_nominal_speed_per_frame, block->nominal_speed_per_s * (float32_t)CORE_FRAME_PERIOD_S);
+  }
+
+  // configure the curve
+  if(planar_length > 0){
+    active_curve_type = block_type;
+    active_planar_length = planar_length;
+    active_curve_end[0] = axes[TBI_AXIS_X].remaining_distance_mm;
+    active_curve_end[1] = axes[TBI_AXIS_Y].remaining_distance_mm;
+    active_curve_position[0] = 0;
+    active_curve_position[1] = 0;
+    for(uint8_t value_index = 0; value_index < 4; value_index++){
+      active_curve_values[value_index] = block->curve_values[value_index];
+    }
+    active_arc_radius = std::sqrt(active_curve_values[0] * active_curve_values[0] + active_curve_values[1] * active_curve_values[1]);
+    active_arc_start_angle = std::atan2(-active_curve_values[1], -active_curve_values[0]);
+    active_bezier_segment = 0;
+  }
+
   // configure the other active move registers
-  for(uint8_t axis_index = 0; axis_index < TBI_NUM_AXES; axis_index++){ //iterate over all axes
-    float64_t axis_distance_mm = active_axes_remaining_distance_mm[axis_index];
-    if(axis_distance_mm != 0){
-      active_axes[axis_index] = TBI_AXIS_ACTIVE; //flag active axes
-      active_axes_velocity_mm_per_frame[axis_index] = (axis_distance_mm / block_time_s) * CORE_FRAME_PERIOD_S; //set velocity of each axis, in mm/frame
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    float64_t axis_distance_mm = axes[axis_index].remaining_distance_mm;
+    if((axis_distance_mm != 0) || (active_curve_type && ((axis_index == TBI_AXIS_X) || (axis_index == TBI_AXIS_Y)))){
+      axes[axis_index].active = TBI_AXIS_ACTIVE; //flag active axes
+      axes[axis_index].distance_per_path_unit = axis_distance_mm / active_remaining_path_length;
     }else{
-      active_axes[axis_index] = TBI_AXIS_INACTIVE; //clear active flag
+      axes[axis_index].active = TBI_AXIS_INACTIVE; //clear active flag
     }
   }
 
@@ -179,60 +554,411 @@ void TimeBasedInterpolator::pull_block(){
   in_block = 1; //flag that we are now in a block
 }
 
-void TimeBasedInterpolator::run_frame_on_active_block(){
-  //Run a frame of the active block
+float32_t TimeBasedInterpolatorBase::run_frame_on_active_block(float32_t frame_fraction){
+  //Run a frame, or the remaining fraction of a frame, of the active block.
+  //Returns the fraction of the frame left over if the block ends, otherwise 0.
+
+  // calculate the path speed for this frame
+  float32_t speed_per_frame = active_nominal_speed_per_frame * active_override;
+  if(planner_enabled && !active_block_is_exact){
+    // accelerate towards the nominal speed, but never faster than we can still brake to the planned exit speed.
+    // Overriding the speed up doesn't change how fast we can take the junction with the next block.
+    float32_t exit_speed_per_frame = read_exit_speed_per_s() * CORE_FRAME_PERIOD_S * std::min((float32_t)active_override, 1.0f);
+    float32_t accelerating_speed_per_frame = active_speed_per_frame + active_acceleration_per_frame2 * frame_fraction;
+    float32_t braking_speed_per_frame = std::sqrt(exit_speed_per_frame * exit_speed_per_frame + 2 * active_acceleration_per_frame2 * (float32_t)active_remaining_path_length);
+    speed_per_frame = std::min(speed_per_frame, std::min(accelerating_speed_per_frame, braking_speed_per_frame));
+  }
+  active_speed_per_frame = speed_per_frame;
+  float32_t path_increment = speed_per_frame * frame_fraction;
   
-  //check for end of move
+  //check for end of move. If the move ends within this frame, we work out how much of the frame it took, and hand the rest back.
   uint8_t end_of_move = 0;
-  active_axes_remaining_distance_mm[TBI_AXIS_V] -= (speed_overide*active_axes_velocity_mm_per_frame[TBI_AXIS_V]);
-  if((active_axes_remaining_distance_mm[TBI_AXIS_V]) < (0.5*active_axes_velocity_mm_per_frame[TBI_AXIS_V])){ //end of move
+  float32_t remaining_frame_fraction = 0;
+  if((path_increment > 0) && (path_increment >= active_remaining_path_length)){ //end of move
     end_of_move = 1;
     in_block = 0; //flag to exit block
+    remaining_frame_fraction = frame_fraction * (1.0 - active_remaining_path_length / path_increment);
+    active_remaining_path_length = 0;
+  }else{
+    active_remaining_path_length -= path_increment;
   }
 
-  for(uint8_t axis_index = 0; axis_index < (TBI_NUM_AXES-1); axis_index++){ //iterate over all axes EXCEPT the virtual axis
-    if(active_axes[axis_index] == TBI_AXIS_ACTIVE){
+  // along a curve, X and Y step to the next point on the curve
+  float32_t curve_point[2];
+  if(active_curve_type && !end_of_move){
+    float32_t planar_distance = (1.0 - active_remaining_path_length / active_path_length) * active_planar_length;
+    evaluate_active_curve(planar_distance, curve_point);
+  }
+
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    struct axis_state* axis = &axes[axis_index];
+    if(axis->active == TBI_AXIS_ACTIVE){
       if(end_of_move){
-        output_BlockPorts[axis_index]->set(active_axes_remaining_distance_mm[axis_index], INCREMENTAL);
+        axis_ports[axis_index].set(axis->remaining_distance_mm, INCREMENTAL);
       }else{
-        output_BlockPorts[axis_index]->set(speed_overide*active_axes_velocity_mm_per_frame[axis_index], INCREMENTAL);
-        active_axes_remaining_distance_mm[axis_index] -= (speed_overide*active_axes_velocity_mm_per_frame[axis_index]);
+        float32_t axis_increment = axis->distance_per_path_unit * path_increment;
+        if(active_curve_type && (axis_index < 2)){ //TBI_AXIS_X or TBI_AXIS_Y
+          axis_increment = curve_point[axis_index] - active_curve_position[axis_index];
+          active_curve_position[axis_index] = curve_point[axis_index];
+        }
+        axis_ports[axis_index].set(axis_increment, INCREMENTAL);
+        axis->remaining_distance_mm -= axis_increment;
       }
-      output_BlockPorts[axis_index]->push();
+      axis_ports[axis_index].push();
     }
   }  
 
-  // Update the virtual axis value
-  output_parameter.set(1.0 - active_axes_remaining_distance_mm[TBI_AXIS_V], ABSOLUTE);
+  // Update the parameter
+  output_parameter.set(1.0 - active_remaining_path_length / active_path_length, ABSOLUTE);
   output_parameter.push();
+  return remaining_frame_fraction;
+}
+
+// -- CURVES --
+
+static void evaluate_bezier(const float32_t* control_points, const float32_t* end_point, float32_t t, float32_t* point){
+  // Evaluates a cubic Bezier curve that starts at the origin. control_points holds control points 1 and 2.
+  float32_t s = 1.0 - t;
+  float32_t weight_1 = 3 * s * s * t;
+  float32_t weight_2 = 3 * s * t * t;
+  float32_t weight_3 = t * t * t;
+  point[0] = weight_1 * control_points[0] + weight_2 * control_points[2] + weight_3 * end_point[0];
+  point[1] = weight_1 * control_points[1] + weight_2 * control_points[3] + weight_3 * end_point[1];
+}
+
+float32_t TimeBasedInterpolatorBase::curve_planar_length(struct queued_block_header* block, const float32_t* bezier_table){
+  // Returns the length of a curve in the XY plane. A Bezier curve's length is the last entry in its arc-length table.
+  if(block->block_type == BLOCK_TYPE_ARC){
+    float32_t radius = std::sqrt(block->curve_values[0] * block->curve_values[0] + block->curve_values[1] * block->curve_values[1]);
+    return radius * std::fabs(block->curve_values[2]);
+  }
+  return bezier_table[TBI_BEZIER_TABLE_SIZE];
+}
+
+void TimeBasedInterpolatorBase::build_bezier_table(struct queued_block_header* block, float32_t* bezier_table){
+  // Fills bezier_table with the length along the curve at each of TBI_BEZIER_TABLE_SIZE even steps of the curve parameter.
+  // This is what lets us run along the curve at constant speed.
+  float32_t end_point[2] = {block_axis_values(block)[TBI_AXIS_X], block_axis_values(block)[TBI_AXIS_Y]};
+  float32_t last_point[2] = {0, 0};
+  bezier_table[0] = 0;
+  for(uint8_t segment_index = 1; segment_index <= TBI_BEZIER_TABLE_SIZE; segment_index++){
+    float32_t point[2];
+    evaluate_bezier(block->curve_values, end_point, (float32_t)segment_index / TBI_BEZIER_TABLE_SIZE, point);
+    float32_t delta_x = point[0] - last_point[0];
+    float32_t delta_y = point[1] - last_point[1];
+    bezier_table[segment_index] = bezier_table[segment_index - 1] + std::sqrt(delta_x * delta_x + delta_y * delta_y);
+    last_point[0] = point[0];
+    last_point[1] = point[1];
+  }
+}
+
+void TimeBasedInterpolatorBase::describe_curve(struct queued_block_header* block, const float32_t* bezier_table, float32_t* planar_length, float32_t* entry_tangent, float32_t* exit_tangent, float32_t* min_radius){
+  // Calculates what the planner needs to know about a curve: its length, the unit directions in which it starts and ends,
+  // and its tightest radius.
+  *planar_length = curve_planar_length(block, bezier_table);
+  const float32_t* curve_values = block->curve_values;
+  float32_t end_point[2] = {block_axis_values(block)[TBI_AXIS_X], block_axis_values(block)[TBI_AXIS_Y]};
+
+  if(block->block_type == BLOCK_TYPE_ARC){
+    float32_t start_angle = std::atan2(-curve_values[1], -curve_values[0]);
+    float32_t end_angle = start_angle + curve_values[2];
+    float32_t direction = (curve_values[2] < 0) ? -1 : 1;
+    entry_tangent[0] = -direction * std::sin(start_angle);
+    entry_tangent[1] = direction * std::cos(start_angle);
+    exit_tangent[0] = -direction * std::sin(end_angle);
+    exit_tangent[1] = direction * std::cos(end_angle);
+    *min_radius = std::sqrt(curve_values[0] * curve_values[0] + curve_values[1] * curve_values[1]);
+    return;
+  }
+
+  // A Bezier curve leaves towards its first distinct control point, and arrives from its last.
+  float32_t points[4][2] = {{0, 0}, {curve_values[0], curve_values[1]}, {curve_values[2], curve_values[3]}, {end_point[0], end_point[1]}};
+  entry_tangent[0] = 0;
+  entry_tangent[1] = 0;
+  exit_tangent[0] = 0;
+  exit_tangent[1] = 0;
+  for(uint8_t point_index = 1; point_index < 4; point_index++){
+    float32_t length = std::sqrt(points[point_index][0] * points[point_index][0] + points[point_index][1] * points[point_index][1]);
+    if(length > 0){
+      entry_tangent[0] = points[point_index][0] / length;
+      entry_tangent[1] = points[point_index][1] / length;
+      break;
+    }
+  }
+  for(int8_t point_index = 2; point_index >= 0; point_index--){
+    float32_t delta_x = end_point[0] - points[point_index][0];
+    float32_t delta_y = end_point[1] - points[point_index][1];
+    float32_t length = std::sqrt(delta_x * delta_x + delta_y * delta_y);
+    if(length > 0){
+      exit_tangent[0] = delta_x / length;
+      exit_tangent[1] = delta_y / length;
+      break;
+    }
+  }
+
+  // Estimate the tightest radius from how sharply the curve turns between samples
+  *min_radius = TBI_UNLIMITED_ACCELERATION;
+  float32_t last_point[2] = {0, 0};
+  float32_t last_angle = 0;
+  float32_t last_length = 0;
+  for(uint8_t segment_index = 1; segment_index <= TBI_BEZIER_TABLE_SIZE; segment_index++){
+    float32_t point[2];
+    evaluate_bezier(curve_values, end_point, (float32_t)segment_index / TBI_BEZIER_TABLE_SIZE, point);
+    float32_t length = bezier_table[segment_index] - bezier_table[segment_index - 1];
+    float32_t angle = std::atan2(point[1] - last_point[1], point[0] - last_point[0]);
+    if((segment_index > 1) && (length > 0) && (last_length > 0)){
+      float32_t turn = std::fabs(std::remainder(angle - last_angle, (float32_t)(2 * M_PI)));
+      if(turn > 0){
+        *min_radius = std::min(*min_radius, 0.5f * (length + last_length) / turn);
+      }
+    }
+    last_point[0] = point[0];
+    last_point[1] = point[1];
+    if(length > 0){
+      last_angle = angle;
+      last_length = length;
+    }
+  }
+}
+
+void TimeBasedInterpolatorBase::evaluate_active_curve(float32_t planar_distance, float32_t* point){
+  if(active_curve_type == BLOCK_TYPE_ARC){
+    float32_t angle = active_arc_start_angle + active_curve_values[2] * (planar_distance / active_planar_length);
+    point[0] = active_curve_values[0] + active_arc_radius * std::cos(angle);
+    point[1] = active_curve_values[1] + active_arc_radius * std::sin(angle);
+    return;
+  }
+  // Find where the distance falls in the arc-length table. The curve only moves forwards, so we pick up from the last segment.
+  while((active_bezier_segment < (TBI_BEZIER_TABLE_SIZE - 1)) && (active_bezier_table[active_bezier_segment + 1] < planar_distance)){
+    active_bezier_segment++;
+  }
+  float32_t segment_start = active_bezier_table[active_bezier_segment];
+  float32_t segment_length = active_bezier_table[active_bezier_segment + 1] - segment_start;
+  float32_t segment_fraction = (segment_length > 0) ? (planar_distance - segment_start) / segment_length : 0;
+  segment_fraction = std::min(std::max(segment_fraction, 0.0f), 1.0f);
+  evaluate_bezier(active_curve_values, active_curve_end, (active_bezier_segment + segment_fraction) / TBI_BEZIER_TABLE_SIZE, point);
 }
 
-void TimeBasedInterpolator::begin(){
-  output_x.begin(&output_position_x, BLOCKPORT_OUTPUT);
-  output_y.begin(&output_position_y, BLOCKPORT_OUTPUT);
-  output_z.begin(&output_position_z, BLOCKPORT_OUTPUT);
-  output_e.begin(&output_position_e, BLOCKPORT_OUTPUT);
-  output_r.begin(&output_position_r, BLOCKPORT_OUTPUT);
-  output_t.begin(&output_position_t, BLOCKPORT_OUTPUT);
+// -- LOOKAHEAD PLANNER --
+
+void TimeBasedInterpolatorBase::set_acceleration(uint8_t axis_index, float32_t acceleration_per_s2){
+  if(axis_index >= num_axes){
+    return;
+  }
+  axes[axis_index].acceleration_per_s2 = acceleration_per_s2;
+  planner_enabled = false;
+  for(uint8_t index = 0; index < num_axes; index++){
+    if(axes[index].acceleration_per_s2 > 0){
+      planner_enabled = true;
+    }
+  }
+}
+
+void TimeBasedInterpolatorBase::set_junction_deviation(float32_t junction_deviation){
+  this->junction_deviation = junction_deviation;
+}
+
+float32_t TimeBasedInterpolatorBase::path_acceleration(float64_t* axis_distances, float32_t path_length){
+  // The path acceleration is limited by whichever axis would reach its own limit first.
+  float32_t acceleration_per_s2 = TBI_UNLIMITED_ACCELERATION;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    if((axes[axis_index].acceleration_per_s2 > 0) && (axis_distances[axis_index] != 0)){
+      float32_t axis_limited_acceleration = axes[axis_index].acceleration_per_s2 * path_length / std::fabs(axis_distances[axis_index]);
+      if(axis_limited_acceleration < acceleration_per_s2){
+        acceleration_per_s2 = axis_limited_acceleration;
+      }
+    }
+  }
+  return acceleration_per_s2;
+}
+
+void TimeBasedInterpolatorBase::plan_block(struct queued_block_header* block, const float32_t* bezier_table){
+  // Calculates the planner state of a block as it is added to the queue.
+  // Absolute moves and dwells are planned to start and end at rest, because their direction isn't known yet.
+  block->path_length = 0;
+  block->nominal_speed_per_s = 0;
+  block->acceleration_per_s2 = 0;
+  block->max_entry_speed_per_s = 0;
+  block->entry_speed_per_s = 0;
+
+  // Blocks with exact timing run as given, so the planner leaves them alone, and plans the blocks around them to stop there.
+  if((block->block_type == BLOCK_TYPE_ABSOLUTE) || (block->block_type == BLOCK_TYPE_GLOBAL) || (block->block_flags & TBI_BLOCK_EXACT_TIMING)){
+    last_block_plannable = false;
+    return;
+  }
+
+  // Curves start and end in different directions, and are only as fast as their tightest radius allows.
+  float32_t planar_length = 0;
+  float32_t entry_tangent[2];
+  float32_t exit_tangent[2];
+  float32_t min_radius = TBI_UNLIMITED_ACCELERATION;
+  if((block->block_type == BLOCK_TYPE_ARC) || (block->block_type == BLOCK_TYPE_BEZIER)){
+    describe_curve(block, bezier_table, &planar_length, entry_tangent, exit_tangent, &min_radius);
+  }
+
+  float32_t* axis_values = block_axis_values(block);
+  float64_t axis_distances[TBI_MAX_AXES];
+  float64_t path_length = planar_length * planar_length;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    axis_distances[axis_index] = axis_values[axis_index];
+    if((planar_length > 0) && (axis_index < 2)){ //TBI_AXIS_X or TBI_AXIS_Y
+      axis_distances[axis_index] = planar_length; //either axis could take the full length of the curve
+      continue;
+    }
+    path_length += axis_distances[axis_index] * axis_distances[axis_index];
+  }
+  path_length = std::sqrt(path_length);
+  if(path_length == 0){
+    last_block_plannable = false;
+    return;
+  }
+
+  block->path_length = path_length;
+  if(block->block_time_s > 0){
+    block->nominal_speed_per_s = path_length / block->block_time_s;
+  }else{
+    block->nominal_speed_per_s = block->block_velocity_per_s;
+  }
+  block->acceleration_per_s2 = path_acceleration(axis_distances, path_length);
+  block->nominal_speed_per_s = std::min(block->nominal_speed_per_s, (float32_t)std::sqrt(block->acceleration_per_s2 * min_radius)); //centripetal limit
+
+  // calculate the fastest speed at which we can take the junction with the previous block.
+  // This uses the junction deviation method: we imagine a circle tangent to both blocks, deviating from the corner by
+  // junction_deviation, and limit the speed so that the centripetal acceleration around that circle is within the limit.
+  float32_t unit_vector[TBI_MAX_AXES]; //entry direction
+  float32_t exit_unit_vector[TBI_MAX_AXES];
+  float32_t cos_theta = 0;
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    unit_vector[axis_index] = axis_distances[axis_index] / path_length;
+    exit_unit_vector[axis_index] = unit_vector[axis_index];
+    if((planar_length > 0) && (axis_index < 2)){
+      unit_vector[axis_index] = entry_tangent[axis_index] * planar_length / path_length;
+      exit_unit_vector[axis_index] = exit_tangent[axis_index] * planar_length / path_length;
+    }
+    cos_theta -= axes[axis_index].last_block_unit_vector * unit_vector[axis_index];
+  }
+  if(last_block_plannable){
+    float32_t junction_speed_per_s;
+    if(cos_theta < -0.999999){ //straight through
+      junction_speed_per_s = TBI_UNLIMITED_ACCELERATION;
+    }else if(cos_theta > 0.999999){ //full reversal
+      junction_speed_per_s = 0;
+    }else{
+      float32_t junction_acceleration_per_s2 = std::min(block->acceleration_per_s2, last_block_acceleration_per_s2);
+      float32_t sin_theta_d2 = std::sqrt(0.5 * (1.0 - cos_theta));
+      junction_speed_per_s = std::sqrt(junction_acceleration_per_s2 * junction_deviation * sin_theta_d2 / (1.0 - sin_theta_d2));
+    }
+    block->max_entry_speed_per_s = std::min(junction_speed_per_s, std::min(block->nominal_speed_per_s, last_block_nominal_speed_per_s));
+  }
+  block->entry_speed_per_s = std::min(block->max_entry_speed_per_s, std::sqrt(2 * block->acceleration_per_s2 * block->path_length));
+
+  // store for the next junction
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    axes[axis_index].last_block_unit_vector = exit_unit_vector[axis_index];
+  }
+  last_block_nominal_speed_per_s = block->nominal_speed_per_s;
+  last_block_acceleration_per_s2 = block->acceleration_per_s2;
+  last_block_plannable = true;
+}
+
+void TimeBasedInterpolatorBase::plan_reverse_pass(){
+  // Walks back from the newest block, raising entry speeds as far as each block can still decelerate to the entry speed of the
+  // block after it. The newest block always plans to come to rest. Stops early once an entry speed doesn't change, because
+  // nothing before it can change either.
+  //
+  // This runs in the main loop, while the frame may pull the oldest blocks out from under it. Each entry speed is written
+  // with interrupts off, and only if its block is still queued, so the frame never sees a half-planned block.
+  if(!planner_enabled){
+    return;
+  }
+  noInterrupts();
+  uint16_t num_queued_blocks = block_queue_depth - slots_remaining;
+  interrupts();
+  uint16_t block_index = next_write_index;
+  float32_t exit_speed_per_s = 0;
+  for(uint16_t queue_position = 0; queue_position < num_queued_blocks; queue_position++){
+    block_index = (block_index == 0) ? (block_queue_depth - 1) : (block_index - 1);
+    struct queued_block_header* block = queued_block_at(block_index);
+    float32_t entry_speed_per_s = 0;
+    if(block->path_length > 0){
+      entry_speed_per_s = std::min(block->max_entry_speed_per_s, std::sqrt(exit_speed_per_s * exit_speed_per_s + 2 * block->acceleration_per_s2 * block->path_length));
+    }
+    if((queue_position > 0) && (entry_speed_per_s == block->entry_speed_per_s)){
+      break;
+    }
+    noInterrupts();
+    bool block_is_queued = (uint16_t)(block_queue_depth - slots_remaining) > queue_position;
+    if(block_is_queued){
+      block->entry_speed_per_s = entry_speed_per_s;
+    }
+    interrupts();
+    if(!block_is_queued){ //already pulled, along with everything older
+      break;
+    }
+    exit_speed_per_s = entry_speed_per_s;
+  }
+}
+
+float32_t TimeBasedInterpolatorBase::read_exit_speed_per_s(){
+  // The active block should end at the planned entry speed of the next block, or at rest if there isn't one yet.
+  if(slots_remaining < block_queue_depth){
+    return queued_block_at(next_read_index)->entry_speed_per_s;
+  }
+  return 0;
+}
+
+void TimeBasedInterpolatorBase::begin(){
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    axis_ports[axis_index].begin(&axes[axis_index].output_position, BLOCKPORT_OUTPUT);
+  }
 
   output_parameter.begin(&output_position_parameter, BLOCKPORT_OUTPUT);
   output_duration.begin(&output_value_duration, BLOCKPORT_OUTPUT);
 
   reset_block_queue();
+  reset_statistics();
   register_plugin();
 }
 
-void TimeBasedInterpolator::enroll(RPC *rpc, const String& instance_name){
-  rpc->enroll(instance_name, "add_move", *this, &TimeBasedInterpolator::add_move);
-  rpc->enroll(instance_name, "add_timed_move", *this, &TimeBasedInterpolator::add_timed_move);
-  rpc->enroll(instance_name, "is_idle", *this, &TimeBasedInterpolator::is_idle);
-  rpc->enroll(instance_name, "queue_is_full", *this, &TimeBasedInterpolator::queue_is_full);
+void TimeBasedInterpolatorBase::set_block_queue(struct queued_block_header* block_storage, uint16_t queue_depth){
+  if((block_storage != nullptr) && (queue_depth > 0)){
+    block_queue = block_storage;
+    block_queue_depth = queue_depth;
+  }
+}
+
+void TimeBasedInterpolatorBase::enroll(RPC *rpc, const String& instance_name){
+  rpc->enroll(instance_name, "add_move", *this, &TimeBasedInterpolatorBase::add_move);
+  rpc->enroll(instance_name, "add_timed_move", *this, &TimeBasedInterpolatorBase::add_timed_move);
+  rpc->enroll(instance_name, "add_arc", *this, &TimeBasedInterpolatorBase::add_arc);
+  rpc->enroll(instance_name, "add_bezier", *this, &TimeBasedInterpolatorBase::add_bezier);
+  rpc->enroll(instance_name, "is_idle", *this, &TimeBasedInterpolatorBase::is_idle);
+  rpc->enroll(instance_name, "queue_is_full", *this, &TimeBasedInterpolatorBase::queue_is_full);
+  rpc->enroll(instance_name, "set_acceleration", *this, &TimeBasedInterpolatorBase::set_acceleration);
+  rpc->enroll(instance_name, "set_junction_deviation", *this, &TimeBasedInterpolatorBase::set_junction_deviation);
   rpc->enroll(instance_name + ".speed_override", speed_overide);
+  rpc->enroll(instance_name, "set_override_ramp_rate", *this, &TimeBasedInterpolatorBase::set_override_ramp_rate);
+  rpc->enroll(instance_name, "feed_hold", *this, &TimeBasedInterpolatorBase::feed_hold);
+  rpc->enroll(instance_name, "resume", *this, &TimeBasedInterpolatorBase::resume);
+  rpc->enroll(instance_name, "is_held", *this, &TimeBasedInterpolatorBase::is_held);
   rpc->enroll(instance_name + ".slots_remaining", slots_remaining);
-  output_x.enroll(rpc, instance_name + ".output_x");
-  output_y.enroll(rpc, instance_name + ".output_y");
-  output_r.enroll(rpc, instance_name + ".output_r");
-  output_t.enroll(rpc, instance_name + ".output_t");
-  output_z.enroll(rpc, instance_name + ".output_z");
-  output_e.enroll(rpc, instance_name + ".output_e");
+  rpc->enroll(instance_name, "read_queue_depth", *this, &TimeBasedInterpolatorBase::read_queue_depth);
+  rpc->enroll(instance_name, "read_starved_frame_count", *this, &TimeBasedInterpolatorBase::read_starved_frame_count);
+  rpc->enroll(instance_name, "read_starvation_count", *this, &TimeBasedInterpolatorBase::read_starvation_count);
+  rpc->enroll(instance_name, "read_min_queue_fill", *this, &TimeBasedInterpolatorBase::read_min_queue_fill);
+  rpc->enroll(instance_name, "read_skipped_block_count", *this, &TimeBasedInterpolatorBase::read_skipped_block_count);
+  rpc->enroll(instance_name, "read_lost_time_s", *this, &TimeBasedInterpolatorBase::read_lost_time_s);
+  rpc->enroll(instance_name, "read_duration_histogram_bin", *this, &TimeBasedInterpolatorBase::read_duration_histogram_bin);
+  rpc->enroll(instance_name, "read_fill_histogram_bin", *this, &TimeBasedInterpolatorBase::read_fill_histogram_bin);
+  rpc->enroll(instance_name, "reset_statistics", *this, &TimeBasedInterpolatorBase::reset_statistics);
+  rpc->enroll(instance_name + ".max_pull_block_cycles", max_pull_block_cycles);
+  rpc->enroll(instance_name, "read_num_axes", *this, &TimeBasedInterpolatorBase::read_num_axes);
+  const char* axis_names = "xyzert"; //named axes, in axis order. Any further axes are enrolled by number.
+  for(uint8_t axis_index = 0; axis_index < num_axes; axis_index++){
+    if(axis_index < strlen(axis_names)){
+      axis_ports[axis_index].enroll(rpc, instance_name + ".output_" + axis_names[axis_index]);
+    }else{
+      axis_ports[axis_index].enroll(rpc, instance_name + ".output_" + String(axis_index));
+    }
+  }
 }
\ No newline at end of file
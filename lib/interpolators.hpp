@@ -17,8 +17,8 @@ A part of the Mixing Metaphors Project
 #define interpolators_h
 
 // TBI stands for "TIME_BASED_INTERPRETER"
-#define TBI_BLOCK_QUEUE_SIZE   100 //we'll start here. Each block currently requires 33 bytes of RAM
-#define TBI_NUM_AXES  7 //number of axes to support in the interpolator
+#define TBI_BLOCK_QUEUE_SIZE   100 //default queue depth. Each queued block requires 52 bytes of RAM, plus 4 bytes per axis. Larger queues can be provided to begin().
+#define TBI_MAX_AXES  16 //most axes an interpolator can have. Limited by the axis mask in each queued block.
 
 #define TBI_AXIS_INACTIVE 0
 #define TBI_AXIS_ACTIVE 1
@@ -29,19 +29,32 @@ A part of the Mixing Metaphors Project
 #define TBI_AXIS_E 3
 #define TBI_AXIS_R 4
 #define TBI_AXIS_T 5
-#define TBI_AXIS_V 6 //virtual axis. we use this for detecting the end of a move
+
+#define TBI_BLOCK_EXACT_TIMING 0x01 //block flag: the block runs at a constant speed in exactly its block time, bypassing the planner
+
+#define TBI_ARC_CW -1 //clockwise arc, as in G2
+#define TBI_ARC_CCW 1 //counterclockwise arc, as in G3
+#define TBI_BEZIER_TABLE_SIZE 32 //number of segments in the arc-length table of a Bezier curve
+#define TBI_BEZIER_TABLE_SLOTS 16 //most Bezier curves that can be queued at once, each with its arc-length table. A power of two.
+
+#define TBI_MAX_BLOCKS_PER_FRAME 4 //most blocks that can start within one frame. Any time left over carries into the next frame, up to a frame. See read_lost_time_s().
+#define TBI_MAX_CARRY_PER_FRAME 0.125 //most carried-over time added to a frame, so carried time speeds a frame up by at most 12.5%
+#define TBI_JOB_IDLE_TIMEOUT_FRAMES 12500 //after this many idle frames (0.5s), we consider a job finished rather than starved
+#define TBI_DURATION_HISTOGRAM_NUM_BINS 20 //bin n counts blocks lasting from 2^n up to 2^(n+1) frames
+#define TBI_FILL_HISTOGRAM_NUM_BINS 16 //queue fill as a fraction of the queue depth, sampled as each block is pulled
+
+#define TBI_DEFAULT_OVERRIDE_RAMP_PER_S 2.0 //how quickly the speed override follows changes when no acceleration limits are set
+
+#define TBI_UNLIMITED_ACCELERATION 1.0e20 //acceleration used when no axis limit applies. Finite, to keep the planner math well-behaved.
+#define TBI_DEFAULT_JUNCTION_DEVIATION 0.05 //default cornering tolerance, in output units
 
 
 /**
- * @brief Enables scheduling a sequence of pre-planned motions towards given coordinate points, the system will create linearly interpolating motion between the input points
- * 
- * For an example of how to use this class, see:
- * @snippet snippets.cpp TimeBasedInterpolator
+ * @brief Shared implementation of the time-based interpolators, for any number of axes.
+ * Use TimeBasedInterpolator, or TimeBasedInterpolatorN to choose the number of axes.
  */
-class TimeBasedInterpolator : public Plugin{
+class TimeBasedInterpolatorBase : public Plugin{
   public:
-    TimeBasedInterpolator();
-    
     /** \cond
      * hidden from Doxygen. Currently we don't expose the option for users to create their own motion blocks and add them, they can use add_move and add_timed_move
      */
@@ -59,14 +72,52 @@ class TimeBasedInterpolator : public Plugin{
       uint32_t block_id; //an ID # for the motion block
       float32_t block_time_s; //total time for the block, in seconds. We'll later convert this to frames, but keep it in seconds here for legibility.
       float32_t block_velocity_per_s;
-      struct position block_position;
+      struct position block_position; //axes beyond the interpolator's axis count are ignored
+      float32_t curve_values[4]; //arc: center x, center y, sweep in radians. bezier: control points 1 and 2. All relative to the start of the block.
+      uint8_t block_flags; //e.g. TBI_BLOCK_EXACT_TIMING, for hosts that plan their own acceleration
     };
 
     int16_t add_block(struct motion_block* block_to_add); //adds a block to the queue
+
+    // Everything about a queued block except its axis values, which follow it in memory. See TimeBasedInterpolatorN::queued_block.
+    struct queued_block_header{
+      uint8_t block_type;
+      uint8_t block_flags; //see motion_block
+      uint16_t block_id;
+      uint16_t axis_mask; //bit n is set if axis n is part of the block
+      float32_t block_time_s;
+      float32_t block_velocity_per_s;
+      float32_t curve_values[4]; //see motion_block
+
+      // Planner state, filled in as the block is added.
+      float32_t path_length; //length of the move across all axes. 0 if not known until the block is pulled.
+      float32_t nominal_speed_per_s; //speed along the path
+      float32_t acceleration_per_s2; //maximum acceleration along the path, limited by the axis accelerations
+      float32_t max_entry_speed_per_s; //limited by the junction with the previous block
+      float32_t entry_speed_per_s; //planned entry speed, calculated by the reverse pass
+    };
+
+    // Per-axis state, stored by TimeBasedInterpolatorN
+    struct axis_state{
+      DecimalPosition output_position;
+      volatile uint8_t active; //TBI_AXIS_ACTIVE or TBI_AXIS_INACTIVE
+      volatile float64_t remaining_distance_mm; //distance left to move in the active block
+      volatile float32_t distance_per_path_unit; //how far the axis moves per unit of path
+      float32_t acceleration_per_s2; //0 means unlimited
+      float32_t last_block_unit_vector; //exit direction of the last block added, for calculating junction speeds
+
+      // Queued axis values are float32, each relative to where the queue's previous value left the axis, so that absolute
+      // targets keep their precision far from the origin. These running sums are kept at full precision on both ends of the
+      // queue, and match as long as each end adds the same values in the same order.
+      float64_t queued_end_position; //sum of the values queued so far. Re-synced to output_position whenever the queue is empty.
+      float64_t pulled_end_position; //queued_end_position as of the last block pulled
+      float64_t rounding_carry; //what the last incremental value lost to float32, carried into the next so that it doesn't accumulate
+    };
     /** \endcond */
 
     /**
      * @brief Add a move to the list of moves the interpolator will perform (indicate target velocity).
+     * Axes beyond the interpolator's axis count are ignored.
      * @param mode The mode of operation: INCREMENTAL, ABSOLUTE or GLOBAL.
      * @param velocity_per_s The velocity of motion
      * @param x Target x position for the move
@@ -80,6 +131,7 @@ class TimeBasedInterpolator : public Plugin{
 
     /**
      * @brief Add a move to the list of moves the interpolator will perform (indicate motion time).
+     * Axes beyond the interpolator's axis count are ignored.
      * @param mode The mode of operation: INCREMENTAL, ABSOLUTE or GLOBAL.
      * @param time_s The duration of the move
      * @param x Target x position for the move
@@ -91,16 +143,124 @@ class TimeBasedInterpolator : public Plugin{
      */
     int16_t add_timed_move(uint8_t mode, float32_t time_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t);
 
+    /**
+     * @brief Add a move on any number of axes to the list of moves (indicate target velocity).
+     * @param mode The mode of operation: INCREMENTAL, ABSOLUTE or GLOBAL.
+     * @param velocity_per_s The velocity of motion
+     * @param axis_positions Target position of each axis, with one entry per axis of the interpolator.
+     */
+    int16_t add_axes_move(uint8_t mode, float32_t velocity_per_s, const float64_t* axis_positions);
+
+    /**
+     * @brief Add a move on any number of axes to the list of moves (indicate motion time).
+     * @param mode The mode of operation: INCREMENTAL, ABSOLUTE or GLOBAL.
+     * @param time_s The duration of the move
+     * @param axis_positions Target position of each axis, with one entry per axis of the interpolator.
+     */
+    int16_t add_timed_axes_move(uint8_t mode, float32_t time_s, const float64_t* axis_positions);
+
+    /**
+     * @brief Add an arc in the XY plane to the list of moves. The arc runs at a constant speed along its length, and is
+     * evaluated every frame rather than broken into line segments. Z and E move linearly alongside, to make helices.
+     * All positions are relative to the end of the previous move. Requires at least two axes.
+     * @param velocity_per_s The velocity along the path.
+     * @param x End of the arc in X.
+     * @param y End of the arc in Y.
+     * @param center_x Center of the arc in X.
+     * @param center_y Center of the arc in Y.
+     * @param direction TBI_ARC_CW or TBI_ARC_CCW. If the end is the same as the start, a full circle is made.
+     * @param z Distance to move in Z over the arc.
+     * @param e Distance to move in E over the arc.
+     */
+    int16_t add_arc(float32_t velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition center_x, DecimalPosition center_y, int8_t direction, DecimalPosition z, DecimalPosition e);
+
+    /**
+     * @brief Add a cubic Bezier curve in the XY plane to the list of moves. The curve runs at a constant speed along its length.
+     * All positions are relative to the end of the previous move, which is the first point of the curve. Requires at least two axes.
+     * @param velocity_per_s The velocity along the path.
+     * @param control_1_x First control point in X.
+     * @param control_1_y First control point in Y.
+     * @param control_2_x Second control point in X.
+     * @param control_2_y Second control point in Y.
+     * @param x End of the curve in X.
+     * @param y End of the curve in Y.
+     * @param z Distance to move in Z over the curve.
+     * @param e Distance to move in E over the curve.
+     */
+    int16_t add_bezier(float32_t velocity_per_s, DecimalPosition control_1_x, DecimalPosition control_1_y, DecimalPosition control_2_x, DecimalPosition control_2_y, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e);
+
     /**
      * @brief ControlParameter specifying a multiplicative modifier for the interpolator speed
      */
     volatile ControlParameter speed_overide = 1; //modifier for the interpolator speed.
 
+    /**
+     * @brief Sets how quickly the interpolator follows changes to speed_overide, and slows for a feed hold.
+     * If any axis has an acceleration limit, the override instead ramps at the acceleration of the active move.
+     * @param ramp_rate_per_s Change in the override per second. Default is TBI_DEFAULT_OVERRIDE_RAMP_PER_S.
+     */
+    void set_override_ramp_rate(float32_t ramp_rate_per_s);
+
+    /**
+     * @brief Decelerates to a stop, wherever the machine is within the active move. The queue is kept, and motion picks up
+     * from the same point on resume().
+     */
+    void feed_hold();
+
+    /**
+     * @brief Resumes motion after a feed hold, accelerating back up to speed.
+     */
+    void resume();
+
+    /**
+     * @brief Returns true if a feed hold has been requested, and the machine has come to a stop.
+     */
+    bool is_held();
+
+    /**
+     * @brief Returns true if a feed hold has been requested, whether or not the machine has stopped yet.
+     */
+    bool feed_hold_requested();
+
+    /**
+     * @brief Returns the current speed along the path in output units per second, including any speed override and acceleration.
+     * Returns 0 when stopped, or while running a block without motion.
+     */
+    float32_t read_speed_per_s();
+
     /**
      * @brief Initialize the time-based interpolator. This must be called to set up the interpolator.
      */
     void begin();
 
+    /**
+     * @brief Returns the depth of the block queue.
+     */
+    inline uint16_t read_queue_depth(){
+      return block_queue_depth;
+    }
+
+    /**
+     * @brief Returns the number of axes the interpolator drives.
+     */
+    inline uint8_t read_num_axes(){
+      return num_axes;
+    }
+
+    /**
+     * @brief Sets the acceleration limit of an axis. Setting any limit turns on the lookahead planner, which ramps speed up and
+     * down across queued moves instead of jumping between them. By default all axes are unlimited, and every move runs at a constant speed.
+     * @param axis_index The axis to limit, e.g. TBI_AXIS_X, TBI_AXIS_Y, TBI_AXIS_Z, TBI_AXIS_E, TBI_AXIS_R, or TBI_AXIS_T.
+     * @param acceleration_per_s2 Maximum acceleration in output units per second squared. 0 removes the limit.
+     */
+    void set_acceleration(uint8_t axis_index, float32_t acceleration_per_s2);
+
+    /**
+     * @brief Sets how far the path may deviate from a sharp corner when taking it at speed. Larger values corner faster.
+     * @param junction_deviation Deviation in output units. Default is TBI_DEFAULT_JUNCTION_DEVIATION.
+     */
+    void set_junction_deviation(float32_t junction_deviation);
+
     /** \cond
      * hidden from Doxygen.
      */
@@ -108,52 +268,59 @@ class TimeBasedInterpolator : public Plugin{
     /** \endcond */
 
     bool is_idle(); //returns true if the interpolator is idle
-    bool queue_is_full();
+    bool queue_is_full(); //also true while every Bezier table slot is taken, so that a waiting curve is never dropped
 
+    // Queue Health
+    // A job is considered to be running from the first block until the interpolator has been idle for TBI_JOB_IDLE_TIMEOUT_FRAMES.
     /**
-     * \cond
-     * Hidden from Doxygen: enrollment for RPC exposure.
+     * @brief Returns the number of frames during a job in which the queue was empty, and the machine waited on the host.
      */
-    void enroll(RPC *rpc, const String& instance_name);
-    /** \endcond */
-    
-    // BlockPorts
+    uint32_t read_starved_frame_count();
     /**
-     * @brief Output BlockPort for the generated position signal on axis X.
-     * @code
-     * tbi.output_x.map(&kinematics.input_x); // Control the X axis of a machine
-     * @endcode
+     * @brief Returns the number of times the queue ran empty during a job, and then received another block.
      */
-    BlockPort output_x;
-
+    uint32_t read_starvation_count();
     /**
-     * @brief Output BlockPort for the generated position signal on axis Y.
-     * @code
-     * tbi.output_y.map(&kinematics.input_y); // Control the Y axis of a machine
-     * @endcode
+     * @brief Returns the fewest blocks left in the queue when a block was pulled during a job.
      */
-    BlockPort output_y;
-
+    uint16_t read_min_queue_fill();
     /**
-     * @brief Output BlockPort for the generated position signal on axis Z.
+     * @brief Returns the number of blocks skipped because they had neither a time nor a velocity.
      */
-    BlockPort output_z;
-
+    uint32_t read_skipped_block_count();
     /**
-     * @brief Output BlockPort for the generated position signal on axis E.
+     * @brief Returns the block time, in seconds, that was never run because blocks came faster than TBI_MAX_BLOCKS_PER_FRAME
+     * per frame. While that happens, the blocks run slower than their block times, and fall behind by this much.
      */
-    BlockPort output_e;
-
+    float32_t read_lost_time_s();
     /**
-     * @brief Output BlockPort for the generated position signal on axis R.
+     * @brief Returns the number of blocks in a bin of the block duration histogram. Bin n counts blocks that ran for
+     * 2^n up to 2^(n+1) frames, so short-block streams show up in the low bins.
+     * @param bin_index Index of the bin, from 0 to TBI_DURATION_HISTOGRAM_NUM_BINS - 1.
+     */
+    uint32_t read_duration_histogram_bin(uint8_t bin_index);
+    /**
+     * @brief Returns the number of blocks pulled while the queue fill was in a bin of the fill histogram. The bins evenly divide
+     * the queue depth, from empty in bin 0 to full in bin TBI_FILL_HISTOGRAM_NUM_BINS - 1.
+     * @param bin_index Index of the bin, from 0 to TBI_FILL_HISTOGRAM_NUM_BINS - 1.
      */
-    BlockPort output_r;
+    uint32_t read_fill_histogram_bin(uint8_t bin_index);
+    /**
+     * @brief Resets all queue health statistics.
+     */
+    void reset_statistics();
+    /** \cond */
+    volatile uint32_t max_pull_block_cycles = 0; //longest time spent pulling a block from the queue, in CPU cycles
+    /** \endcond */
 
     /**
-     * @brief Output BlockPort for the generated position signal on axis T.
+     * \cond
+     * Hidden from Doxygen: enrollment for RPC exposure.
      */
-    BlockPort output_t;
+    void enroll(RPC *rpc, const String& instance_name);
+    /** \endcond */
 
+    // BlockPorts
     /**
      * @brief Output BlockPort for the generated position signal of a parameter in [0, 1] range.
      * The parameter varies from 0 to 1 along each linear segment corresponding to a single move.
@@ -172,43 +339,221 @@ class TimeBasedInterpolator : public Plugin{
      */
     void reset_block_queue();
 
+  protected:
+    // Per-axis storage and the default queue are sized by TimeBasedInterpolatorN, and handed over here.
+    TimeBasedInterpolatorBase(uint8_t num_axes, BlockPort* axis_ports, struct axis_state* axes, struct queued_block_header* default_block_queue, uint16_t block_stride);
+    void set_block_queue(struct queued_block_header* block_storage, uint16_t queue_depth); //swaps in a queue provided by the sketch
+    void run();
 
   private:
     // BlockPort State Variables
-    DecimalPosition output_position_x;
-    DecimalPosition output_position_y;
-    DecimalPosition output_position_z;
-    DecimalPosition output_position_e;
-    DecimalPosition output_position_r;
-    DecimalPosition output_position_t;
-
     DecimalPosition output_position_parameter;
     DecimalPosition output_value_duration;
 
-    struct motion_block block_queue[TBI_BLOCK_QUEUE_SIZE]; // stores all pending motion blocks
+    // Axes
+    uint8_t num_axes;
+    BlockPort* axis_ports; //output BlockPort of each axis
+    struct axis_state* axes;
+
+    // Each queued block is a header followed by a float32 value per axis, block_stride bytes apart. See axis_state.queued_end_position.
+    struct queued_block_header* block_queue; // stores all pending motion blocks
+    uint16_t block_stride;
+    uint16_t block_queue_depth = TBI_BLOCK_QUEUE_SIZE;
     volatile uint16_t next_write_index; //next write index in the block queue
     volatile uint16_t next_read_index; //next read index in the block queue 
+    inline struct queued_block_header* queued_block_at(uint16_t queue_index){
+      return reinterpret_cast<struct queued_block_header*>(reinterpret_cast<uint8_t*>(block_queue) + queue_index * block_stride);
+    }
+    static inline float32_t* block_axis_values(struct queued_block_header* block){
+      return reinterpret_cast<float32_t*>(block + 1);
+    }
 
     void advance_head(volatile uint16_t* target_head); //handles roll-overs etc
     void pull_block(); //pulls a block from the queue and into the active buffer
     volatile uint8_t in_block = 0; //1 if actively reading a block
     volatile uint16_t active_block_id; //stores the current active block
     volatile uint8_t active_block_type; //we don't use this for now
-    volatile uint8_t active_axes[TBI_NUM_AXES]; //indexed by axis #, 0 if axis inactive, 1 if active
-    volatile float64_t active_axes_remaining_distance_mm[TBI_NUM_AXES];
-    volatile float32_t active_axes_velocity_mm_per_frame[TBI_NUM_AXES];
-    BlockPort* output_BlockPorts[TBI_NUM_AXES - 1] = {&output_x, &output_y, &output_z, &output_e, &output_r, &output_t};
-    void run_frame_on_active_block(); //run a frame of the currently active block
+    volatile float64_t active_remaining_path_length; //path left to run in the active block. Detects the end of a move.
+    volatile float32_t active_speed_per_frame = 0; //current speed along the path. This carries across blocks.
+    volatile float32_t active_nominal_speed_per_frame; //speed to cruise at within the active block
+    volatile float32_t active_acceleration_per_frame2; //acceleration along the path within the active block
+    volatile float64_t active_path_length = 1; //total path length of the active block, used to calculate the parameter
+    volatile bool active_block_is_dwell = false; //true if the active block has no motion, and only takes time
+    volatile bool active_block_is_exact = false; //true if the active block runs in exactly its block time, without the planner
+    // Curves
+    volatile uint8_t active_curve_type = 0; //BLOCK_TYPE_ARC or BLOCK_TYPE_BEZIER if the active block is a curve, otherwise 0
+    float32_t active_curve_values[4]; //copied from the active block
+    float32_t active_curve_end[2]; //end of the curve in X and Y, relative to its start
+    float32_t active_curve_position[2]; //where the curve has been evaluated up to, relative to its start
+    float32_t active_planar_length; //length of the curve in the XY plane
+    float32_t active_arc_radius;
+    float32_t active_arc_start_angle;
+    float32_t active_bezier_table[TBI_BEZIER_TABLE_SIZE + 1]; //length along the curve at each step of the curve parameter
+    uint8_t active_bezier_segment; //index into the table where the curve was last evaluated
+    // Arc-length tables of queued Bezier curves, built as each curve is added. Curves are pulled in order, so this is a ring.
+    float32_t bezier_tables[TBI_BEZIER_TABLE_SLOTS][TBI_BEZIER_TABLE_SIZE + 1];
+    volatile uint16_t bezier_tables_queued = 0; //total tables filled, counted by the main loop
+    volatile uint16_t bezier_tables_released = 0; //total tables copied into the active curve, counted by the frame
+    static void build_bezier_table(struct queued_block_header* block, float32_t* bezier_table); //fills in the arc-length table of a Bezier curve
+    static float32_t curve_planar_length(struct queued_block_header* block, const float32_t* bezier_table); //bezier_table is only used by Bezier curves
+    void describe_curve(struct queued_block_header* block, const float32_t* bezier_table, float32_t* planar_length, float32_t* entry_tangent, float32_t* exit_tangent, float32_t* min_radius);
+    void evaluate_active_curve(float32_t planar_distance, float32_t* point); //evaluates the XY point at a distance along the active curve
+
+    volatile bool feed_hold_active = false;
+    volatile float32_t active_override = 1; //speed override in effect, which ramps towards speed_overide, or 0 when held
+    float32_t override_ramp_rate_per_s = TBI_DEFAULT_OVERRIDE_RAMP_PER_S;
+    void ramp_override(); //moves the active override one frame towards its target
+    float32_t run_frame_on_active_block(float32_t frame_fraction); //run a fraction of a frame of the active block, returns any fraction left over
+    volatile float32_t carried_frame_fraction = 0; //time left over from the last frame that hasn't been used by a block yet
     int16_t _add_move(uint8_t mode, float32_t move_time_s, float32_t velocity_per_s, DecimalPosition x, DecimalPosition y, DecimalPosition z, DecimalPosition e, DecimalPosition r, DecimalPosition t);
+    int16_t _add_axes_move(uint8_t mode, float32_t move_time_s, float32_t velocity_per_s, const float64_t* axis_positions);
+    int16_t queue_block(uint8_t block_type, uint32_t block_id, float32_t block_time_s, float32_t block_velocity_per_s, const float64_t* axis_values, const float32_t* curve_values, uint8_t block_flags = 0); //encodes, plans, and queues a block
+
+    // Queue Health
+    volatile bool job_running = false;
+    volatile uint32_t idle_frames = 0; //consecutive frames without an active block
+    volatile uint32_t active_block_frames = 0; //frames spent in the active block so far
+    volatile uint32_t starved_frame_count = 0;
+    volatile uint32_t starvation_count = 0;
+    volatile uint16_t min_queue_fill;
+    volatile uint32_t skipped_block_count = 0;
+    volatile float64_t lost_frame_time = 0; //frames of block time dropped by the cap on carried time. float64, so it can sum small amounts over a long job.
+    volatile uint32_t duration_histogram[TBI_DURATION_HISTOGRAM_NUM_BINS];
+    volatile uint32_t fill_histogram[TBI_FILL_HISTOGRAM_NUM_BINS];
+    void record_block_pulled(); //updates statistics as a block becomes active
+    void record_block_finished(); //updates statistics as the active block ends
+
+    // Lookahead Planner
+    float32_t junction_deviation = TBI_DEFAULT_JUNCTION_DEVIATION;
+    bool planner_enabled = false; //true when any axis has an acceleration limit
+    float32_t last_block_nominal_speed_per_s = 0;
+    float32_t last_block_acceleration_per_s2 = 0;
+    bool last_block_plannable = false; //false if the direction of the last block isn't known (e.g. an absolute move)
+    void encode_block(uint8_t block_type, uint32_t block_id, float32_t block_time_s, float32_t block_velocity_per_s, const float64_t* axis_values, const float32_t* curve_values, uint8_t block_flags, struct queued_block_header* encoded_block); //packs a block into its queued form
+    void plan_block(struct queued_block_header* block, const float32_t* bezier_table); //calculates the planner state of a new block
+    void plan_reverse_pass(); //updates entry speeds across the queue, from the newest block back
+    float32_t path_acceleration(float64_t* axis_distances, float32_t path_length); //acceleration along a path, limited by all axes
+    float32_t read_exit_speed_per_s(); //planned exit speed of the active block
     
     enum{
       BLOCK_TYPE_INCREMENTAL,
       BLOCK_TYPE_ABSOLUTE,
-      BLOCK_TYPE_GLOBAL
+      BLOCK_TYPE_GLOBAL,
+      BLOCK_TYPE_ARC, //always incremental
+      BLOCK_TYPE_BEZIER //always incremental
     };
+};
 
-  protected:
-    void run();
+/**
+ * @brief A time-based interpolator with NUM_AXES axes. Storage and the per-frame work grow with the number of axes,
+ * so a plotter can use two axes, and larger machines up to TBI_MAX_AXES.
+ * @code
+ * TimeBasedInterpolatorN<2> plotter_tbi; // drives plotter_tbi.output_axes[TBI_AXIS_X] and [TBI_AXIS_Y]
+ * @endcode
+ * Axes 0 and 1 are X and Y, which are the plane of arcs and Bezier curves.
+ */
+template<uint8_t NUM_AXES>
+class TimeBasedInterpolatorN : public TimeBasedInterpolatorBase{
+  static_assert((NUM_AXES > 0) && (NUM_AXES <= TBI_MAX_AXES), "TimeBasedInterpolatorN supports 1 to TBI_MAX_AXES axes");
+
+  public:
+    TimeBasedInterpolatorN() : TimeBasedInterpolatorBase(NUM_AXES, output_axes, axis_states, &default_block_queue[0].header, sizeof(queued_block)){};
+
+    /**
+     * @brief The compact form in which motion blocks are stored in the queue.
+     * Declare an array of these to give the interpolator a deeper queue than the default. See begin(queued_block*, uint16_t).
+     */
+    struct queued_block{
+      /** \cond */
+      struct queued_block_header header;
+      float32_t axis_values[NUM_AXES]; //distances for incremental blocks, otherwise target positions relative to the last queued end position
+      /** \endcond */
+    };
+    static_assert(sizeof(queued_block) == sizeof(queued_block_header) + NUM_AXES * sizeof(float32_t), "axis values must directly follow the block header");
+
+    using TimeBasedInterpolatorBase::begin;
+
+    /**
+     * @brief Initialize the time-based interpolator with a block queue provided by the sketch.
+     * Dense paths (e.g. polylines from a slicer) can drain the default queue faster than a host can refill it. A deeper queue
+     * smooths over host jitter, and can be placed in RAM2 with DMAMEM, or in PSRAM on a Teensy 4.1 with EXTMEM.
+     * @code
+     * DMAMEM TimeBasedInterpolator::queued_block tbi_blocks[4000];
+     * 
+     * void setup(){
+     *   tbi.begin(tbi_blocks, 4000);
+     * }
+     * @endcode
+     * @param block_storage Array of queued blocks, which must remain valid for the life of the interpolator.
+     * @param queue_depth Number of blocks in the array.
+     */
+    void begin(struct queued_block* block_storage, uint16_t queue_depth){
+      if(block_storage != nullptr){
+        set_block_queue(&block_storage[0].header, queue_depth);
+      }
+      begin();
+    }
+
+    /**
+     * @brief Output BlockPorts for the generated position signal on each axis, indexed by axis (e.g. TBI_AXIS_X).
+     * @code
+     * tbi.output_axes[TBI_AXIS_X].map(&kinematics.input_x); // Control the X axis of a machine
+     * @endcode
+     */
+    BlockPort output_axes[NUM_AXES];
+
+  private:
+    struct axis_state axis_states[NUM_AXES] = {};
+    struct queued_block default_block_queue[TBI_BLOCK_QUEUE_SIZE]; // used unless a queue is provided to begin()
+};
+
+/**
+ * @brief Enables scheduling a sequence of pre-planned motions towards given coordinate points, the system will create linearly interpolating motion between the input points
+ * 
+ * This is the six-axis TimeBasedInterpolatorN, with a named output for each axis.
+ * 
+ * For an example of how to use this class, see:
+ * @snippet snippets.cpp TimeBasedInterpolator
+ */
+class TimeBasedInterpolator : public TimeBasedInterpolatorN<6>{
+  public:
+    TimeBasedInterpolator();
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis X.
+     * @code
+     * tbi.output_x.map(&kinematics.input_x); // Control the X axis of a machine
+     * @endcode
+     */
+    BlockPort& output_x = output_axes[TBI_AXIS_X];
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis Y.
+     * @code
+     * tbi.output_y.map(&kinematics.input_y); // Control the Y axis of a machine
+     * @endcode
+     */
+    BlockPort& output_y = output_axes[TBI_AXIS_Y];
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis Z.
+     */
+    BlockPort& output_z = output_axes[TBI_AXIS_Z];
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis E.
+     */
+    BlockPort& output_e = output_axes[TBI_AXIS_E];
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis R.
+     */
+    BlockPort& output_r = output_axes[TBI_AXIS_R];
+
+    /**
+     * @brief Output BlockPort for the generated position signal on axis T.
+     */
+    BlockPort& output_t = output_axes[TBI_AXIS_T];
 };
 
-#endif
\ No newline at end of file
+#endif
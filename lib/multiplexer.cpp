@@ -0,0 +1,249 @@
+#include "Arduino.h"
+#include <algorithm>
+/*
+Stream Multiplexer Module of the StepDance Control System
+
+This module carries several independent streams over a single serial link.
+
+A part of the Mixing Metaphors Project
+(c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include "multiplexer.hpp"
+
+// ---- MULTIPLEXED STREAM ----
+MultiplexedStream::MultiplexedStream(){};
+
+int MultiplexedStream::available(){
+  return receive_count;
+}
+
+int MultiplexedStream::read(){
+  if(receive_count == 0){
+    return -1;
+  }
+  uint8_t character = receive_buffer[receive_read_index];
+  receive_read_index = (receive_read_index + 1) % MUX_RECEIVE_BUFFER_SIZE;
+  receive_count --;
+  total_bytes_read ++;
+  return character;
+}
+
+int MultiplexedStream::peek(){
+  if(receive_count == 0){
+    return -1;
+  }
+  return receive_buffer[receive_read_index];
+}
+
+size_t MultiplexedStream::write(uint8_t character){
+  return write(&character, 1);
+}
+
+size_t MultiplexedStream::write(const uint8_t *buffer, size_t size){
+  for(size_t byte_index = 0; byte_index < size; byte_index++){
+    while(transmit_count == MUX_TRANSMIT_BUFFER_SIZE){ //full, so we wait on the link just as we would writing to it directly
+      multiplexer->transmit_packet(this);
+    }
+    transmit_buffer[(transmit_read_index + transmit_count) % MUX_TRANSMIT_BUFFER_SIZE] = buffer[byte_index];
+    transmit_count ++;
+  }
+  return size;
+}
+
+int MultiplexedStream::availableForWrite(){
+  return MUX_TRANSMIT_BUFFER_SIZE - transmit_count;
+}
+
+void MultiplexedStream::reset(){
+  receive_read_index = 0;
+  receive_count = 0;
+  total_bytes_read = 0;
+  reported_bytes_read = 0;
+  transmit_read_index = 0;
+  transmit_count = 0;
+}
+
+bool MultiplexedStream::receive(uint8_t character){
+  if(receive_count == MUX_RECEIVE_BUFFER_SIZE){
+    return false;
+  }
+  receive_buffer[(receive_read_index + receive_count) % MUX_RECEIVE_BUFFER_SIZE] = character;
+  receive_count ++;
+  return true;
+}
+
+// ---- STREAM MULTIPLEXER ----
+StreamMultiplexer::StreamMultiplexer(){};
+
+void StreamMultiplexer::begin(Stream *link_stream){
+  link = link_stream;
+  for(uint8_t channel_index = 0; channel_index < MUX_MAX_CHANNELS; channel_index++){
+    channels[channel_index].multiplexer = this;
+    channels[channel_index].channel_index = channel_index;
+  }
+  reset_channels();
+  register_plugin(PLUGIN_LOOP); //this runs in the main program loop
+}
+
+void StreamMultiplexer::begin(usb_serial_class *link_usb_serial){
+  link_usb_serial -> begin(115200); //baud rate is unused
+  begin((Stream*)link_usb_serial);
+}
+
+MultiplexedStream* StreamMultiplexer::channel(uint8_t channel_index){
+  if(channel_index >= MUX_MAX_CHANNELS){
+    return nullptr;
+  }
+  return &channels[channel_index];
+}
+
+uint32_t StreamMultiplexer::read_overrun_count(){
+  return overrun_count;
+}
+
+void StreamMultiplexer::loop(){
+  receive_link();
+  send_credits();
+  transmit_link();
+}
+
+void StreamMultiplexer::reset_channels(){
+  for(uint8_t channel_index = 0; channel_index < MUX_MAX_CHANNELS; channel_index++){
+    channels[channel_index].reset();
+  }
+}
+
+// -- RECEIVING --
+
+void StreamMultiplexer::receive_link(){
+  // Every frame fits in its channel, because the host keeps within its credit, so reading never waits on an interface.
+  uint8_t receive_chunk[RECEIVE_CHUNK_SIZE];
+  for(uint8_t chunk_count = 0; chunk_count < 8; chunk_count++){
+    int bytes_available = link->available();
+    if(bytes_available <= 0){
+      return;
+    }
+    if(bytes_available > RECEIVE_CHUNK_SIZE){
+      bytes_available = RECEIVE_CHUNK_SIZE;
+    }
+    size_t bytes_read = link->readBytes((char*)receive_chunk, bytes_available);
+    for(size_t byte_index = 0; byte_index < bytes_read; byte_index++){
+      process_link_byte(receive_chunk[byte_index]);
+    }
+  }
+}
+
+void StreamMultiplexer::process_link_byte(uint8_t character){
+  switch(link_state){
+    case LINK_WAIT_SYNC:
+      if(character == MUX_SYNC){
+        link_state = LINK_READ_CHANNEL;
+      }
+      break;
+
+    case LINK_READ_CHANNEL:
+      frame_channel = character;
+      link_state = LINK_READ_LENGTH;
+      break;
+
+    case LINK_READ_LENGTH:
+      frame_payload_remaining = character;
+      control_payload_length = 0;
+      link_state = (frame_payload_remaining > 0) ? LINK_READ_PAYLOAD : LINK_WAIT_SYNC;
+      break;
+
+    case LINK_READ_PAYLOAD:
+      if(frame_channel == MUX_CONTROL_CHANNEL){
+        if(control_payload_length < sizeof(control_payload)){
+          control_payload[control_payload_length++] = character;
+        }
+      }else if((frame_channel >= MUX_MAX_CHANNELS) || !channels[frame_channel].receive(character)){
+        overrun_count ++;
+      }
+      frame_payload_remaining --;
+      if(frame_payload_remaining == 0){
+        if(frame_channel == MUX_CONTROL_CHANNEL){
+          process_control();
+        }
+        link_state = LINK_WAIT_SYNC;
+      }
+      break;
+  }
+}
+
+void StreamMultiplexer::process_control(){
+  if(control_payload[0] == MUX_CONTROL_RESET){
+    reset_channels();
+    uint8_t ready_payload[4] = {MUX_CONTROL_READY, MUX_MAX_CHANNELS, (uint8_t)MUX_RECEIVE_BUFFER_SIZE, (uint8_t)(MUX_RECEIVE_BUFFER_SIZE >> 8)};
+    link->write(MUX_SYNC);
+    link->write(MUX_CONTROL_CHANNEL);
+    link->write(sizeof(ready_payload));
+    link->write(ready_payload, sizeof(ready_payload)); //the host waits on this, so it's sent even if the link is busy
+  }
+}
+
+// -- TRANSMITTING --
+
+void StreamMultiplexer::send_credits(){
+  // Report once a quarter of a buffer has been read, or once it's been read empty, so the host never waits on a stale credit.
+  for(uint8_t channel_index = 0; channel_index < MUX_MAX_CHANNELS; channel_index++){
+    MultiplexedStream *target_channel = &channels[channel_index];
+    uint32_t unreported_bytes = target_channel->total_bytes_read - target_channel->reported_bytes_read;
+    if((unreported_bytes >= MUX_RECEIVE_BUFFER_SIZE / 4) || ((unreported_bytes > 0) && (target_channel->receive_count == 0))){
+      uint32_t total_bytes_read = target_channel->total_bytes_read;
+      uint8_t credit_payload[6] = {MUX_CONTROL_CREDIT, channel_index, (uint8_t)total_bytes_read, (uint8_t)(total_bytes_read >> 8),
+                                   (uint8_t)(total_bytes_read >> 16), (uint8_t)(total_bytes_read >> 24)};
+      if(!send_control(credit_payload, sizeof(credit_payload))){
+        return;
+      }
+      target_channel->reported_bytes_read = total_bytes_read;
+    }
+  }
+}
+
+bool StreamMultiplexer::send_control(const uint8_t *payload, uint8_t payload_length){
+  if(link->availableForWrite() < MUX_HEADER_SIZE + payload_length){
+    return false;
+  }
+  uint8_t header[MUX_HEADER_SIZE] = {MUX_SYNC, MUX_CONTROL_CHANNEL, payload_length};
+  link->write(header, MUX_HEADER_SIZE);
+  link->write(payload, payload_length);
+  return true;
+}
+
+void StreamMultiplexer::transmit_link(){
+  // Always serve the lowest-numbered channel with something to send, one packet at a time, so a busy channel can delay
+  // a higher-priority one by at most a packet.
+  while(true){
+    MultiplexedStream *source_channel = nullptr;
+    for(uint8_t channel_index = 0; channel_index < MUX_MAX_CHANNELS; channel_index++){
+      if(channels[channel_index].transmit_count > 0){
+        source_channel = &channels[channel_index];
+        break;
+      }
+    }
+    if(source_channel == nullptr){ //nothing to send
+      return;
+    }
+    uint16_t packet_size = std::min(source_channel->transmit_count, (uint16_t)MUX_TRANSMIT_PACKET_SIZE);
+    if(link->availableForWrite() < MUX_HEADER_SIZE + packet_size){ //link is busy, try again next loop
+      return;
+    }
+    transmit_packet(source_channel);
+  }
+}
+
+void StreamMultiplexer::transmit_packet(MultiplexedStream *source_channel){
+  uint8_t packet[MUX_HEADER_SIZE + MUX_TRANSMIT_PACKET_SIZE];
+  uint16_t packet_size = std::min(source_channel->transmit_count, (uint16_t)MUX_TRANSMIT_PACKET_SIZE);
+  packet[0] = MUX_SYNC;
+  packet[1] = source_channel->channel_index;
+  packet[2] = packet_size;
+  for(uint16_t byte_index = 0; byte_index < packet_size; byte_index++){
+    packet[MUX_HEADER_SIZE + byte_index] = source_channel->transmit_buffer[source_channel->transmit_read_index];
+    source_channel->transmit_read_index = (source_channel->transmit_read_index + 1) % MUX_TRANSMIT_BUFFER_SIZE;
+  }
+  source_channel->transmit_count -= packet_size;
+  link->write(packet, MUX_HEADER_SIZE + packet_size);
+}
@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include "Stream.h"
+#include "usb_serial.h"
+/*
+Stream Multiplexer Module of the StepDance Control System
+
+This module carries several independent streams over a single serial link, so that e.g. a G-code sender and an RPC
+control panel can talk to the same device over one USB connection at the same time.
+
+Frames on the link are SYNC, channel, payload length, payload (1 to 255 bytes). Each channel looks like an ordinary
+Stream to the interface that uses it, with its own receive and transmit buffers.
+
+Flow control is per channel, so that one busy channel can't hold up another. The host may only send a channel as many
+bytes as it has room for: on a RESET control frame the device clears every channel and answers with READY, carrying the
+receive buffer size, and as interfaces read from a channel the device reports the total read in CREDIT frames. Channels
+transmit in priority order, lowest number first, a packet at a time.
+
+See rpc/stream_mux.py for a host-side implementation.
+
+A part of the Mixing Metaphors Project
+(c) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost
+*/
+
+#include "core.hpp"
+
+#ifndef multiplexer_h //prevent importing twice
+#define multiplexer_h
+
+#define MUX_SYNC  0xA5
+#define MUX_HEADER_SIZE 3 //sync, channel, payload length
+#define MUX_MAX_CHANNELS  4
+#define MUX_RECEIVE_BUFFER_SIZE 1024 //per channel
+#define MUX_TRANSMIT_BUFFER_SIZE  1024 //per channel
+#define MUX_TRANSMIT_PACKET_SIZE  64 //most bytes sent from one channel before a higher-priority channel gets another turn
+
+#define MUX_CONTROL_CHANNEL 0x7F
+#define MUX_CONTROL_RESET   0x01 //host to device: clears every channel
+#define MUX_CONTROL_READY   0x02 //device to host: number of channels, and receive buffer size (uint16)
+#define MUX_CONTROL_CREDIT  0x03 //device to host: channel, and total bytes read from it since the reset (uint32)
+
+class StreamMultiplexer;
+
+/**
+ * @brief One channel of a StreamMultiplexer. Pass it to an interface's begin() in place of a serial port.
+ * @ingroup interfaces
+ */
+class MultiplexedStream : public Stream{
+  public:
+    MultiplexedStream();
+    /**
+     * @brief Returns the number of bytes waiting to be read.
+     */
+    int available();
+    /**
+     * @brief Reads a byte, or returns -1 if none are waiting.
+     */
+    int read();
+    /**
+     * @brief Returns the next byte without reading it, or -1 if none are waiting.
+     */
+    int peek();
+    /**
+     * @brief Writes a byte to the channel. If the transmit buffer is full, waits on the link to make room.
+     */
+    size_t write(uint8_t character);
+    /**
+     * @brief Writes bytes to the channel. If the transmit buffer is full, waits on the link to make room.
+     */
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    /**
+     * @brief Returns the number of bytes that can be written without waiting.
+     */
+    int availableForWrite();
+
+  private:
+    friend class StreamMultiplexer;
+    StreamMultiplexer *multiplexer = nullptr;
+    uint8_t channel_index = 0;
+
+    uint8_t receive_buffer[MUX_RECEIVE_BUFFER_SIZE];
+    uint16_t receive_read_index = 0;
+    uint16_t receive_count = 0;
+    uint32_t total_bytes_read = 0; //since the last reset, reported to the host as credit
+    uint32_t reported_bytes_read = 0;
+
+    uint8_t transmit_buffer[MUX_TRANSMIT_BUFFER_SIZE];
+    uint16_t transmit_read_index = 0;
+    uint16_t transmit_count = 0;
+
+    void reset();
+    bool receive(uint8_t character); //called by the multiplexer. Returns false if the host sent more than it had credit for.
+};
+
+/**
+ * @brief Carries several independent streams over one serial link, each with its own buffering and flow control.
+ * @ingroup interfaces
+ *
+ * Each channel is a Stream that can be handed to an interface (e.g. GCodeInterface, Eibotboard, BlockStreamInterface, or RPC)
+ * in place of a serial port. Lower-numbered channels are sent first, so put control traffic on channel 0.
+ * See rpc/stream_mux.py for the host side.
+ * @code
+ * StreamMultiplexer multiplexer;
+ * RPC rpc;
+ * GCodeInterface gcode;
+ *
+ * void setup(){
+ *   multiplexer.begin(&Serial);
+ *   rpc.begin(multiplexer.channel(0));
+ *   gcode.begin(multiplexer.channel(1));
+ * }
+ * @endcode
+ */
+class StreamMultiplexer : public Plugin{
+  public:
+    StreamMultiplexer();
+    /**
+     * @brief Initialize the multiplexer on a link. The link should report availableForWrite(), as USB and hardware serial ports do.
+     * @param link_stream The stream that carries the channels, e.g. &Serial.
+     */
+    void begin(Stream *link_stream);
+    /**
+     * @brief Initialize the multiplexer on a USB serial port.
+     * @param link_usb_serial A pointer to the USB serial port, e.g. &Serial or &SerialUSB1.
+     */
+    void begin(usb_serial_class *link_usb_serial);
+    /**
+     * @brief Returns a channel, to pass to an interface's begin().
+     * @param channel_index Channel number, from 0 to MUX_MAX_CHANNELS - 1. Lower numbers are sent first.
+     */
+    MultiplexedStream* channel(uint8_t channel_index);
+    /**
+     * @brief Returns the number of bytes dropped because the host sent more than a channel had room for, or sent to a channel
+     * that doesn't exist.
+     */
+    uint32_t read_overrun_count();
+
+  protected:
+    void loop();
+
+  private:
+    friend class MultiplexedStream;
+    Stream *link;
+    MultiplexedStream channels[MUX_MAX_CHANNELS];
+
+    // Receiving
+    enum{
+      LINK_WAIT_SYNC,
+      LINK_READ_CHANNEL,
+      LINK_READ_LENGTH,
+      LINK_READ_PAYLOAD
+    };
+    static const uint8_t RECEIVE_CHUNK_SIZE = 64; //most bytes read from the link at once
+    uint8_t link_state = LINK_WAIT_SYNC;
+    uint8_t frame_channel;
+    uint8_t frame_payload_remaining;
+    uint8_t control_payload[8];
+    uint8_t control_payload_length;
+    uint32_t overrun_count = 0;
+    void receive_link();
+    void process_link_byte(uint8_t character);
+    void process_control();
+    void reset_channels();
+
+    // Transmitting
+    void transmit_link(); //sends packets from the channels in priority order, while the link has room
+    void transmit_packet(MultiplexedStream *source_channel); //sends up to one packet from a channel
+    void send_credits(); //tells the host about room that's opened up in the receive buffers
+    bool send_control(const uint8_t *payload, uint8_t payload_length); //returns false if the link doesn't have room
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "imxrt.h"
 #include "output_ports.hpp"
 #include "rpc.hpp"
+#include "recording.hpp"
 
 /*
 Output Ports Module of the StepDance Control System
@@ -191,6 +192,8 @@ void OutputPort::begin(uint8_t port_number, uint8_t output_format, uint8_t trans
   // -- Store Parameters for Later --
   strcpy(this->port_name, port_info[port_number].PORT_NAME);
   this->port_number = port_number;
+  this->step_shiftbuf = port_info[port_number].STEP_SHIFTBUF;
+  this->dir_shiftbuf = port_info[port_number].DIR_SHIFTBUF;
   this->format_index = output_format;
   this->transmit_mode = transmit_mode;
   this->FRAME_LENGTH_US = output_formats[format_index].FRAME_LENGTH_US;
@@ -199,6 +202,7 @@ void OutputPort::begin(uint8_t port_number, uint8_t output_format, uint8_t trans
   this->SIGNAL_MIN_WIDTH_US = output_formats[format_index].SIGNAL_MIN_WIDTH_US;
   this->SIGNAL_GAP_US = output_formats[format_index].SIGNAL_GAP_US;
   this->RATE_SHIFT = output_formats[format_index].RATE_SHIFT;
+  configure_signal_packing();
 
   // -- Configure Teensy Output Pins --
   pinMode(port_info[port_number].STEP_TEENSY_PIN, OUTPUT);
@@ -306,26 +310,129 @@ void OutputPort::begin(uint8_t port_number, uint8_t output_format, uint8_t trans
 }
 
 void OutputPort::transmit_frame(){
+  if(stage_frame()){
+    transmit(staged_frame_step, staged_frame_dir);
+  }
+  if(transmit_mode == OUTPUT_TRANSMIT_MANUAL){
+    // Manually transmitted ports send whatever is in the frame and start fresh, as they always have. Steps are only
+    // carried between frames on ports that transmit every frame.
+    clear_all_signals();
+  }
+}
+
+void OutputPort::clear_all_signals(){
+  // Clears all pending steps. We only bother clearing the step counts, because direction doesn't matter without a step.
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index++){
+    active_signals[signal_index] = 0;
+  }
+  carried_signals = 0;
+}
+
+bool OutputPort::stage_frame(){
+  // Encodes the active frame. Returns true if the frame should be transmitted now, or false if it went into the lookahead ring.
   encode();
-  transmit();
-  clear_all_signals();
+  if(lookahead_frames){
+    queue_frame();
+    return false;
+  }
+  staged_frame_step = active_encoded_frame_step;
+  staged_frame_dir = active_encoded_frame_dir;
+  return true;
 }
 
 void OutputPort::transmit(){
+  transmit(active_encoded_frame_step, active_encoded_frame_dir);
+}
+
+void OutputPort::transmit(uint32_t encoded_frame_step, uint32_t encoded_frame_dir){
   // Transmits raw step and direction sequences over the output pins
-  *port_info[port_number].DIR_SHIFTBUF = active_encoded_frame_dir;
-  *port_info[port_number].STEP_SHIFTBUF = active_encoded_frame_step; //writing to the step shift buffer triggers transmission, so we do it last.
+  *dir_shiftbuf = encoded_frame_dir;
+  *step_shiftbuf = encoded_frame_step; //writing to the step shift buffer triggers transmission, so we do it last.
+  tap_frame(encoded_frame_step, encoded_frame_dir);
 }
 
-void OutputPort::clear_all_signals(){
-  // Clears all active signal flags
-  // We only bother clearing the step signal flags, because direction doesn't matter if the step flag is clear.
+void OutputPort::attach_tap(OutputFrameTap* frame_tap){
+  this->frame_tap = frame_tap;
+}
+
+void OutputPort::tap_frame(uint32_t encoded_frame_step, uint32_t encoded_frame_dir){
+  if(frame_tap != nullptr){
+    frame_tap->record(encoded_frame_step, encoded_frame_dir);
+  }
+}
+
+// -- LOOKAHEAD --
+
+bool OutputPort::set_lookahead(uint8_t num_frames){
+  // Sets the number of frames by which transmission lags encoding.
+  //
+  // num_frames -- 0 (OUTPUT_LOOKAHEAD_OFF) transmits each frame as soon as it is encoded, at the end of the frame interrupt.
+  //               Any other value holds encoded frames in a ring, which is drained at the start of the frame interrupt.
+  //               This moves transmission ahead of the plugins, so their varying execution time doesn't shift the pulses.
+  //               Each frame adds CORE_FRAME_PERIOD_US of latency.
+  //
+  // Resizing the ring discards the frames in it, so the change is refused while any of them still carry steps (i.e. while
+  // the port is moving). Manually transmitted ports are never released from the ring, so they can't use lookahead.
+  if(transmit_mode != OUTPUT_TRANSMIT_ON_FRAME){
+    return false;
+  }
+  if(num_frames > OUTPUT_LOOKAHEAD_MAX_FRAMES){
+    num_frames = OUTPUT_LOOKAHEAD_MAX_FRAMES;
+  }
+  noInterrupts();
+  for(uint8_t ring_index = lookahead_read_index; ring_index != lookahead_write_index; ring_index = (ring_index + 1) & (OUTPUT_LOOKAHEAD_RING_SIZE - 1)){
+    if(lookahead_ring[ring_index].step){
+      interrupts();
+      return false;
+    }
+  }
+  // prime the ring with empty frames, so that the first real frame goes out num_frames later
+  for(uint8_t ring_index = 0; ring_index < OUTPUT_LOOKAHEAD_RING_SIZE; ring_index++){
+    lookahead_ring[ring_index].step = 0;
+    lookahead_ring[ring_index].dir = 0;
+  }
+  lookahead_read_index = 0;
+  lookahead_write_index = num_frames;
+  lookahead_frames = num_frames;
+  interrupts();
+  return true;
+}
+
+void OutputPort::queue_frame(){
+  // Frames are encoded at the end of each frame interrupt and released at the start of the next, so the ring normally holds
+  // lookahead_frames frames here and has room for one more. It only fills if frames are encoded out of turn, e.g. by
+  // calling transmit_frame() from the loop.
+  uint8_t next_write_index = (lookahead_write_index + 1) & (OUTPUT_LOOKAHEAD_RING_SIZE - 1);
+  if(next_write_index == lookahead_read_index){ //ring is full
+    lookahead_overruns ++;
+    return;
+  }
+  lookahead_ring[lookahead_write_index].step = active_encoded_frame_step;
+  lookahead_ring[lookahead_write_index].dir = active_encoded_frame_dir;
+  lookahead_write_index = next_write_index;
+}
 
-  for(uint8_t i = 0; i < NUM_SIGNALS; i++){
-    active_signals[i] = 0;
+void OutputPort::release_frame(){
+  if(stage_release()){
+    transmit(staged_frame_step, staged_frame_dir);
   }
 }
 
+bool OutputPort::stage_release(){
+  // Takes the oldest frame from the lookahead ring. Returns true if there is a frame to transmit.
+  if(lookahead_frames == OUTPUT_LOOKAHEAD_OFF){ //frames are transmitted directly by transmit_frame()
+    return false;
+  }
+  if(lookahead_read_index == lookahead_write_index){ //ring is empty. Nothing was encoded for this frame, so nothing is sent.
+    lookahead_underruns ++;
+    return false;
+  }
+  staged_frame_step = lookahead_ring[lookahead_read_index].step;
+  staged_frame_dir = lookahead_ring[lookahead_read_index].dir;
+  lookahead_read_index = (lookahead_read_index + 1) & (OUTPUT_LOOKAHEAD_RING_SIZE - 1);
+  return true;
+}
+
 void OutputPort::add_signal(uint8_t signal_index, uint8_t signal_direction){
   // Adds a specific signal within the frame.
   // When the signal is added, a corresponding width pulse will be generated on transmit
@@ -333,12 +440,34 @@ void OutputPort::add_signal(uint8_t signal_index, uint8_t signal_direction){
   // signal_index -- the index of the target signal within active_signals. We provide a bunch of defines to make it
   //                  easier to keep track of these... i.e. SIGNAL_X, SIGNAL_Y, etc...
   // signal_direction -- 0 for reverse, 1 for forward
-  active_signals[signal_index] = 1;
+  //
+  // Steps that don't fit in the current frame are carried over to later frames, so a signal may have several steps pending.
+  if(active_signals[signal_index] && (active_signal_directions[signal_index] != signal_direction)){
+    // a step in the opposite direction hasn't been sent yet. The two cancel out.
+    active_signals[signal_index] --;
+    return;
+  }
+  if((output_format == OUTPUT_FORMAT_DRIVER) && (driver_signal_index == OUTPUT_DRIVER_NO_SIGNAL)){
+    // the first signal added to a driver port claims it. Any other signal is dropped, since a driver has only one axis.
+    driver_signal_index = signal_index;
+    transmittable_signals = (1 << signal_index);
+  }
+  if(!((transmittable_signals >> signal_index) & 1) || (active_signals[signal_index] >= max_pending_steps)){
+    signal_drop_counts[signal_index] ++;
+    return;
+  }
+  active_signals[signal_index] ++;
   active_signal_directions[signal_index] = signal_direction;
 }
 
 void OutputPort::encode(){
   // Encodes the active_signals and _directions arrays into active_encoded_frame_step and _dir
+  // One step is encoded for each signal with pending steps. Signals that don't fit in the frame stay pending,
+  // and are packed first in the next frame so that busy short signals can't starve the longer ones.
+  if(output_format == OUTPUT_FORMAT_DRIVER){
+    encode_driver();
+    return;
+  }
 
   // First, initialize the active_encoded_frame registers
   active_encoded_frame_step = 0;
@@ -353,16 +482,27 @@ void OutputPort::encode(){
   uint32_t dir_pulse;
   uint8_t dir_pulse_length_us;
 
-  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index ++){
-    if(active_signals[signal_index]){ //only bother to process active signals
+  uint8_t last_carried_signals = carried_signals;
+  carried_signals = 0;
+
+  for(uint8_t pass = 0; pass < 2; pass ++){ // pass 0 packs signals carried over from the last frame, pass 1 packs everything else
+    for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index ++){
+      if(active_signals[signal_index] == 0){ //only bother to process active signals
+        continue;
+      }
+      if(((last_carried_signals >> signal_index) & 1) != (pass == 0)){
+        continue;
+      }
 
       // calculate step and dir pulse lengths
       step_pulse_length_us = signal_index + SIGNAL_MIN_WIDTH_US;
       dir_pulse_length_us = step_pulse_length_us + SIGNAL_GAP_US;
 
-      // check that we don't overrun the frame
+      // check that we don't overrun the frame. If we would, defer the signal to the next frame.
       if((step_pulse_us_position + step_pulse_length_us) > (FRAME_LENGTH_US-1)){
-        return;
+        carried_signals |= (1 << signal_index);
+        signal_carry_counts[signal_index] += active_signals[signal_index];
+        continue;
       }
 
       // encode step and dir pulses
@@ -381,21 +521,227 @@ void OutputPort::encode(){
       // update bit positions
       step_pulse_us_position += step_pulse_length_us + SIGNAL_GAP_US;
       dir_pulse_us_position += dir_pulse_length_us;
+
+      // consume the step
+      active_signals[signal_index] --;
+      if(active_signals[signal_index]){ //more steps are waiting on this signal
+        carried_signals |= (1 << signal_index);
+        signal_carry_counts[signal_index] += active_signals[signal_index];
+      }
+    }
+  }
+}
+
+void OutputPort::encode_driver(){
+  // Encodes pending steps as a native step/dir stream, for connecting directly to a stepper driver.
+  // A driver port carries a single axis, the one signal that add_signal() accepts. DIR is held at a constant level for the
+  // whole frame, and up to max_steps_per_frame step pulses are spaced evenly between the setup and hold times.
+  active_encoded_frame_step = 0;
+
+  uint8_t num_pending_steps = (driver_signal_index < NUM_SIGNALS) ? active_signals[driver_signal_index] : 0;
+  if(num_pending_steps > 0){
+    uint8_t num_steps = num_pending_steps;
+    if(num_steps > max_steps_per_frame){
+      num_steps = max_steps_per_frame;
+      signal_carry_counts[driver_signal_index] += num_pending_steps - num_steps;
+    }
+    driver_direction = active_signal_directions[driver_signal_index];
+
+    uint32_t step_pulse = (1 << driver_pulse_high_bits) - 1;
+    uint8_t step_spacing_bits = driver_available_bits / num_steps;
+    for(uint8_t step_index = 0; step_index < num_steps; step_index ++){
+      active_encoded_frame_step |= step_pulse << (driver_setup_bits + step_index * step_spacing_bits);
+    }
+    active_signals[driver_signal_index] = num_pending_steps - num_steps;
+  }
+
+  if(driver_direction){
+    active_encoded_frame_dir = 0xFFFFFFFF;
+  }else{
+    active_encoded_frame_dir = 0;
+  }
+}
+
+void OutputPort::set_output_format(uint8_t output_format){
+  // Selects how steps are encoded on the output port.
+  //
+  // output_format -- OUTPUT_FORMAT_STEPDANCE encodes up to six signals using pulse lengths, for connecting to other stepdance modules.
+  //                  OUTPUT_FORMAT_DRIVER outputs standard step and direction signals, for connecting directly to a stepper driver.
+  //                  In this format, several steps can be output per frame.
+  this->output_format = output_format;
+  driver_signal_index = OUTPUT_DRIVER_NO_SIGNAL;
+  configure_signal_packing();
+}
+
+void OutputPort::set_driver_timing(float32_t setup_us, float32_t pulse_high_us, float32_t pulse_low_us, float32_t hold_us){
+  // Sets the step and direction timing used in OUTPUT_FORMAT_DRIVER. Check these against the datasheet for your driver.
+  //
+  // setup_us -- minimum time between a change of direction and the next step edge
+  // pulse_high_us -- minimum step high time
+  // pulse_low_us -- minimum step low time
+  // hold_us -- minimum time the direction is held after a step edge
+  driver_setup_us = setup_us;
+  driver_pulse_high_us = pulse_high_us;
+  driver_pulse_low_us = pulse_low_us;
+  driver_hold_us = hold_us;
+  configure_signal_packing();
+}
+
+static uint8_t convert_us_to_bits(float32_t time_us, uint8_t rate_shift){
+  // converts a time into a number of shift register bits, rounding up. Returns between one bit and half a frame.
+  uint8_t bits = static_cast<uint8_t>(ceilf(time_us * (1 << rate_shift)));
+  if(bits == 0){
+    bits = 1;
+  }else if(bits > OUTPUT_FRAME_BITS / 2){
+    bits = OUTPUT_FRAME_BITS / 2;
+  }
+  return bits;
+}
+
+void OutputPort::configure_signal_packing(){
+  // Works out which signals can be carried by the current output format, both individually and together.
+  if(output_format == OUTPUT_FORMAT_DRIVER){
+    driver_setup_bits = convert_us_to_bits(driver_setup_us, RATE_SHIFT);
+    driver_pulse_high_bits = convert_us_to_bits(driver_pulse_high_us, RATE_SHIFT);
+    uint8_t driver_pulse_low_bits = convert_us_to_bits(driver_pulse_low_us, RATE_SHIFT);
+    uint8_t driver_hold_bits = convert_us_to_bits(driver_hold_us, RATE_SHIFT);
+    uint8_t step_period_bits = driver_pulse_high_bits + driver_pulse_low_bits;
+    if(driver_setup_bits + driver_hold_bits + step_period_bits > OUTPUT_FRAME_BITS){
+      // timing can't be met within a frame. Fall back to a single step per frame, and accept a shorter hold time.
+      driver_setup_bits = OUTPUT_FRAME_BITS - step_period_bits;
+      driver_available_bits = step_period_bits;
+    }else{
+      driver_available_bits = OUTPUT_FRAME_BITS - driver_setup_bits - driver_hold_bits;
+    }
+    max_steps_per_frame = driver_available_bits / step_period_bits;
+    max_pending_steps = 2 * max_steps_per_frame;
+    if(max_pending_steps < OUTPUT_MAX_PENDING_STEPS){
+      max_pending_steps = OUTPUT_MAX_PENDING_STEPS;
+    }
+    signal_capacity = 1;
+    if(driver_signal_index == OUTPUT_DRIVER_NO_SIGNAL){ //any signal can claim the port
+      transmittable_signals = (1 << NUM_SIGNALS) - 1;
+    }else{
+      transmittable_signals = (1 << driver_signal_index);
+    }
+    return;
+  }
+
+  max_steps_per_frame = 1;
+  max_pending_steps = OUTPUT_MAX_PENDING_STEPS;
+  signal_capacity = 0;
+  transmittable_signals = 0;
+  uint8_t step_pulse_us_position = STEP_PULSE_START_TIME_US;
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index ++){
+    uint8_t step_pulse_length_us = signal_index + SIGNAL_MIN_WIDTH_US;
+    if((STEP_PULSE_START_TIME_US + step_pulse_length_us) <= (FRAME_LENGTH_US-1)){ //fits on its own
+      transmittable_signals |= (1 << signal_index);
+    }
+    if((step_pulse_us_position + step_pulse_length_us) <= (FRAME_LENGTH_US-1)){ //fits alongside all shorter signals
+      signal_capacity ++;
+      step_pulse_us_position += step_pulse_length_us + SIGNAL_GAP_US;
     }
   }
 }
 
+uint8_t OutputPort::read_signal_capacity(){
+  return signal_capacity;
+}
+
+bool OutputPort::signal_fits_in_frame(uint8_t signal_index){
+  return (signal_index < NUM_SIGNALS) && ((transmittable_signals >> signal_index) & 1);
+}
+
+uint32_t OutputPort::read_carry_count(uint8_t signal_index){
+  if(signal_index >= NUM_SIGNALS){
+    return 0;
+  }
+  return signal_carry_counts[signal_index];
+}
+
+uint32_t OutputPort::read_drop_count(uint8_t signal_index){
+  if(signal_index >= NUM_SIGNALS){
+    return 0;
+  }
+  return signal_drop_counts[signal_index];
+}
+
+void OutputPort::reset_signal_counters(){
+  for(uint8_t signal_index = 0; signal_index < NUM_SIGNALS; signal_index ++){
+    signal_carry_counts[signal_index] = 0;
+    signal_drop_counts[signal_index] = 0;
+  }
+}
+
 void OutputPort::register_output_port(){
+  // Registered ports are kept sorted by port number, so that they are always transmitted in the same order.
   if(num_registered_output_ports < NUM_AVAILABLE_OUTPUT_PORTS){
-    registered_output_ports[num_registered_output_ports] = this;
+    uint8_t insert_index = num_registered_output_ports;
+    while(insert_index > 0 && registered_output_ports[insert_index - 1]->port_number > port_number){
+      registered_output_ports[insert_index] = registered_output_ports[insert_index - 1];
+      insert_index --;
+    }
+    registered_output_ports[insert_index] = this;
     num_registered_output_ports ++;
   } // NOTE: should add a return value if it works
 }
 
+static volatile uint32_t output_transmit_max_skew_cycles = 0; //longest time between the first and last step shift buffer writes
+
+static void transmit_staged_frames(OutputPort** staged_ports, uint8_t num_staged_ports){
+  // Writes the staged frames of several ports back to back. All DIR buffers are written first, and then all STEP buffers,
+  // which start the transmissions. Interrupts are held off during the STEP writes so that the skew between ports is bounded.
+  if(num_staged_ports == 0){
+    return;
+  }
+  for(uint8_t staged_index = 0; staged_index < num_staged_ports; staged_index++){
+    staged_ports[staged_index]->write_staged_dir();
+  }
+  noInterrupts();
+  uint32_t start_cycle_count = ARM_DWT_CYCCNT;
+  for(uint8_t staged_index = 0; staged_index < num_staged_ports; staged_index++){
+    staged_ports[staged_index]->write_staged_step();
+  }
+  uint32_t skew_cycles = ARM_DWT_CYCCNT - start_cycle_count;
+  interrupts();
+  if(skew_cycles > output_transmit_max_skew_cycles){
+    output_transmit_max_skew_cycles = skew_cycles;
+  }
+  for(uint8_t staged_index = 0; staged_index < num_staged_ports; staged_index++){
+    staged_ports[staged_index]->tap_staged();
+  }
+}
+
 void transmit_frames_on_all_output_ports(){
+  // Encodes every registered port first, and then transmits them all together.
+  OutputPort* staged_ports[NUM_AVAILABLE_OUTPUT_PORTS];
+  uint8_t num_staged_ports = 0;
+  for(uint8_t output_port_index = 0; output_port_index < num_registered_output_ports; output_port_index++){
+    if(registered_output_ports[output_port_index]->stage_frame()){
+      staged_ports[num_staged_ports++] = registered_output_ports[output_port_index];
+    }
+  }
+  transmit_staged_frames(staged_ports, num_staged_ports);
+}
+
+void release_frames_on_all_output_ports(){
+  OutputPort* staged_ports[NUM_AVAILABLE_OUTPUT_PORTS];
+  uint8_t num_staged_ports = 0;
   for(uint8_t output_port_index = 0; output_port_index < num_registered_output_ports; output_port_index++){
-    registered_output_ports[output_port_index]->transmit_frame();
+    if(registered_output_ports[output_port_index]->stage_release()){
+      staged_ports[num_staged_ports++] = registered_output_ports[output_port_index];
+    }
   }
+  transmit_staged_frames(staged_ports, num_staged_ports);
+}
+
+float32_t output_ports_get_max_transmit_skew_us(){
+  // Returns the longest time, in microseconds, between the start of transmission on the first and last output ports in a frame.
+  return static_cast<float32_t>(output_transmit_max_skew_cycles) * 1000000.0f / static_cast<float32_t>(F_CPU);
+}
+
+void output_ports_reset_transmit_skew(){
+  output_transmit_max_skew_cycles = 0;
 }
 
 void OutputPort::step_now(uint8_t direction){
@@ -403,6 +749,12 @@ void OutputPort::step_now(uint8_t direction){
 }
 
 void OutputPort::step_now(uint8_t direction, uint8_t signal_index){
+  if(output_format == OUTPUT_FORMAT_DRIVER){ //a single step pulse, after the setup time
+    uint32_t step_pulse = (1 << driver_pulse_high_bits) - 1;
+    transmit(step_pulse << driver_setup_bits, direction ? 0xFFFFFFFF : 0);
+    return;
+  }
+
   uint8_t step_pulse_length_us = signal_index + SIGNAL_MIN_WIDTH_US;
   uint8_t dir_pulse_length_us = step_pulse_length_us + SIGNAL_GAP_US;
 
@@ -425,8 +777,7 @@ void OutputPort::step_now(uint8_t direction, uint8_t signal_index){
   uint32_t active_encoded_frame_dir = (dir_pulse << (DIR_PULSE_START_TIME_US<<RATE_SHIFT));
 
   // transmit
-  *port_info[port_number].DIR_SHIFTBUF = active_encoded_frame_dir;
-  *port_info[port_number].STEP_SHIFTBUF = active_encoded_frame_step; //writing to the step shift buffer triggers transmission, so we do it last.
+  transmit(active_encoded_frame_step, active_encoded_frame_dir);
 
 }
 
@@ -500,4 +851,14 @@ void OutputPort::enroll(RPC *rpc, const String& instance_name){
   rpc->enroll(instance_name, "disable_driver", *this, &OutputPort::disable_driver);
   rpc->enroll(instance_name, "read_limit_switch", *this, &OutputPort::read_limit_switch);
   rpc->enroll(instance_name, "step_now", *this, static_cast<void(OutputPort::*)(uint8_t, uint8_t)>(&OutputPort::step_now));
+  rpc->enroll(instance_name, "set_output_format", *this, &OutputPort::set_output_format);
+  rpc->enroll(instance_name, "set_driver_timing", *this, &OutputPort::set_driver_timing);
+  rpc->enroll(instance_name, "read_max_steps_per_frame", *this, &OutputPort::read_max_steps_per_frame);
+  rpc->enroll(instance_name, "read_signal_capacity", *this, &OutputPort::read_signal_capacity);
+  rpc->enroll(instance_name, "read_carry_count", *this, &OutputPort::read_carry_count);
+  rpc->enroll(instance_name, "read_drop_count", *this, &OutputPort::read_drop_count);
+  rpc->enroll(instance_name, "reset_signal_counters", *this, &OutputPort::reset_signal_counters);
+  rpc->enroll(instance_name, "set_lookahead", *this, &OutputPort::set_lookahead);
+  rpc->enroll(instance_name + ".lookahead_underruns", lookahead_underruns);
+  rpc->enroll(instance_name + ".lookahead_overruns", lookahead_overruns);
 }
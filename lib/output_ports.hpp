@@ -19,6 +19,8 @@ A part of the Mixing Metaphors Project
 
 #ifndef output_ports_h // prevent importing twice
 #define output_ports_h
+
+class OutputFrameTap; // defined in recording.hpp
 /** \cond */
 /**
  * This function will be hidden from Doxygen documentation.
@@ -66,8 +68,12 @@ struct output_format_struct
   uint8_t RATE_SHIFT;               // 2^N bits per microsecond
 };
 
-// #define OUTPUT_FORMAT_STEPDANCE 0 //outputting a pulse-length encoded step stream, which supports multiple signals over a single stream
-// #define OUTPUT_FORMAT_DRIVER    1 //outputting a standard stepper driver stream.
+#define OUTPUT_FORMAT_STEPDANCE 0 //outputting a pulse-length encoded step stream, which supports multiple signals over a single stream
+#define OUTPUT_FORMAT_DRIVER    1 //outputting a standard stepper driver stream.
+
+#define OUTPUT_FRAME_BITS 32 // every output format shifts out 32 bits per frame
+#define OUTPUT_DRIVER_MAX_STEPS_PER_FRAME (OUTPUT_FRAME_BITS / 2) // a driver step needs at least one high and one low bit
+#define OUTPUT_DRIVER_NO_SIGNAL 0xFF // a driver port that hasn't been claimed by a signal yet
 
 // OUTPUT SPEED SETTINGS
 #define OUTPUT_FRAME_32US 0 // frame is 32us long. This is the standard stepdance output frame, for a 25KHz framerate.
@@ -87,11 +93,23 @@ struct output_format_struct
 #define OUTPUT_B_LEGACY 1
 
 #define NUM_SIGNALS 6 // total number of signal types
+#define OUTPUT_MAX_PENDING_STEPS 8 // max number of steps per signal that can be deferred to later frames before steps are dropped
 
 #define DIRECTION_FORWARD 1
 #define DIRECTION_REVERSE 0
 
 #define NUM_AVAILABLE_OUTPUT_PORTS 4 // max available output ports. NOTE: Should make this dynamic based on TEENSY version
+
+// OUTPUT LOOKAHEAD
+#define OUTPUT_LOOKAHEAD_OFF 0 // frames are transmitted as soon as they are encoded
+#define OUTPUT_LOOKAHEAD_RING_SIZE 16 // size of the per-port ring of encoded frames. Must be a power of two.
+#define OUTPUT_LOOKAHEAD_MAX_FRAMES (OUTPUT_LOOKAHEAD_RING_SIZE - 1) // maximum number of frames that transmission can lag encoding
+
+struct encoded_frame_struct
+{ // a single encoded frame, ready to be loaded into the FlexIO shift buffers
+  uint32_t step;
+  uint32_t dir;
+};
 /** \endcond */
 
 /**
@@ -125,9 +143,47 @@ class OutputPort : public Plugin{
     void begin(uint8_t port_number, uint8_t output_format, uint8_t transmit_mode); //complete initializer
     
     void add_signal(uint8_t signal_index, uint8_t signal_direction); //adds a signal to the current active frame
-    void transmit_frame(); //encodes and transmits the active frame
+    void transmit_frame(); //encodes and transmits the active frame. With OUTPUT_TRANSMIT_MANUAL, steps that didn't fit are then cleared.
     void step_now(uint8_t direction); //shortcut to immediately output a step at the minimum signal size
     void step_now(uint8_t direction, uint8_t signal_index);
+
+    // -- DRIVER FORMAT --
+    void set_output_format(uint8_t output_format); // OUTPUT_FORMAT_STEPDANCE (default) or OUTPUT_FORMAT_DRIVER
+    void set_driver_timing(float32_t setup_us, float32_t pulse_high_us, float32_t pulse_low_us, float32_t hold_us); // step/dir timing for OUTPUT_FORMAT_DRIVER
+    inline uint8_t read_max_steps_per_frame(){ // returns the number of steps a single signal can make in one frame
+      return max_steps_per_frame;
+    }
+
+    // -- SIGNAL PACKING --
+    uint8_t read_signal_capacity(); // returns the number of signals that fit together in a single frame in the current format
+    bool signal_fits_in_frame(uint8_t signal_index); // returns true if the signal can be transmitted at all in the current format
+    uint32_t read_carry_count(uint8_t signal_index); // returns the steps on this signal left waiting at the end of each frame, summed over frames
+    uint32_t read_drop_count(uint8_t signal_index); // returns the number of steps on this signal that could not be transmitted
+    void reset_signal_counters(); // resets all carry and drop counters
+
+    // -- LOOKAHEAD FUNCTIONS --
+    bool set_lookahead(uint8_t num_frames); // encoded frames are held in a ring and transmitted num_frames later. 0 disables. Returns false if steps are still waiting in the ring, or the port transmits manually.
+    void release_frame(); // transmits the oldest frame in the lookahead ring. Called at the start of each frame.
+
+    // -- STAGED TRANSMISSION --
+    // transmit_frames_on_all_output_ports() and release_frames_on_all_output_ports() stage a frame on every port first,
+    // and then write all of the shift buffers back to back so that the ports start together.
+    bool stage_frame(); // encodes the active frame. Returns true if it should be transmitted now.
+    bool stage_release(); // takes the oldest frame from the lookahead ring. Returns true if there is one to transmit.
+    inline void write_staged_dir(){
+      *dir_shiftbuf = staged_frame_dir;
+    }
+    inline void write_staged_step(){
+      *step_shiftbuf = staged_frame_step; //writing to the step shift buffer triggers transmission
+    }
+    inline void tap_staged(){
+      tap_frame(staged_frame_step, staged_frame_dir);
+    }
+    volatile uint32_t lookahead_underruns = 0; // number of frames where the ring was empty when it was time to transmit, so nothing was sent
+    volatile uint32_t lookahead_overruns = 0; // number of encoded frames that were discarded because the ring was full
+
+    // -- FRAME TAP --
+    void attach_tap(OutputFrameTap* frame_tap); // every transmitted frame is also passed to frame_tap. nullptr detaches.
     
     // -- DRIVER FUNCTIONS --
     float32_t read_drive_current_amps(); // returns the last drive current reading
@@ -152,16 +208,54 @@ private:
   uint8_t SIGNAL_MIN_WIDTH_US;                               // pulse width in microseconds of shortest signal (index = 0)
   uint8_t SIGNAL_GAP_US;                                     // gap in microseconds between signals
   uint8_t RATE_SHIFT;                                        // 2^N bits per microsecond
+  uint8_t output_format = OUTPUT_FORMAT_STEPDANCE;           // pulse-length encoded stream, or native step/dir
+  volatile uint32_t *step_shiftbuf;                          // step shift output buffer, from port_info
+  volatile uint32_t *dir_shiftbuf;                           // dir shift output buffer, from port_info
   static const struct output_port_info_struct port_info[];   // stores setup information for all four output ports
   static const struct output_format_struct output_formats[]; // output formats for different frame sizes
 
   // -- STATE VARIABLES --
-  volatile uint8_t active_signals[NUM_SIGNALS];
+  volatile uint8_t active_signals[NUM_SIGNALS]; // number of steps pending on each signal
   volatile uint8_t active_signal_directions[NUM_SIGNALS];
+  volatile uint8_t carried_signals = 0; // bit mask of signals that were deferred from the last frame. These get packed first.
   volatile uint32_t active_encoded_frame_step; // these get populated by the encode function
   volatile uint32_t active_encoded_frame_dir;
+  uint32_t staged_frame_step = 0; // the next frame to be written to the shift buffers
+  uint32_t staged_frame_dir = 0;
   volatile float32_t last_drive_current_reading_amps;
 
+  // DRIVER FORMAT STATE
+  float32_t driver_setup_us = 1; // time from the start of the frame (when DIR may change) to the first step edge
+  float32_t driver_pulse_high_us = 1; // minimum step pulse high time
+  float32_t driver_pulse_low_us = 1; // minimum step pulse low time
+  float32_t driver_hold_us = 1; // time that DIR is held after the last step pulse ends
+  uint8_t driver_setup_bits = 0; // timing in shift register bits, calculated by configure_signal_packing()
+  uint8_t driver_pulse_high_bits = 0;
+  uint8_t driver_available_bits = 0; // bits available for step pulses, between the setup and hold times
+  volatile uint8_t driver_direction = DIRECTION_FORWARD; // DIR level is held between frames
+  uint8_t driver_signal_index = OUTPUT_DRIVER_NO_SIGNAL; // the one signal a driver port carries, claimed by the first add_signal()
+
+  // SIGNAL PACKING STATE
+  uint8_t max_steps_per_frame = 1; // max steps on a single signal per frame. This is always 1 for the stepdance format.
+  uint8_t max_pending_steps = OUTPUT_MAX_PENDING_STEPS; // max steps per signal waiting to be transmitted
+  uint8_t signal_capacity = 0; // number of signals that fit in a frame simultaneously
+  uint8_t transmittable_signals = 0; // bit mask of signals that fit in a frame on their own
+  volatile uint32_t signal_carry_counts[NUM_SIGNALS]; // steps left waiting at the end of a frame, summed over frames, by signal
+  volatile uint32_t signal_drop_counts[NUM_SIGNALS]; // steps that were never transmitted, by signal
+
+  // LOOKAHEAD STATE
+  // When lookahead is enabled, encoded frames are not transmitted immediately but are placed in a ring. The ring is drained
+  // at the very start of the frame interrupt, before any plugins run, so that the timing of the transmission is not affected by
+  // the variable execution time of plugins.
+  volatile struct encoded_frame_struct lookahead_ring[OUTPUT_LOOKAHEAD_RING_SIZE];
+  volatile uint8_t lookahead_frames = OUTPUT_LOOKAHEAD_OFF; // number of frames between encoding and transmission
+  volatile uint8_t lookahead_read_index = 0; // next frame to transmit
+  volatile uint8_t lookahead_write_index = 0; // next slot to encode into
+
+  // FRAME TAP
+  OutputFrameTap* volatile frame_tap = nullptr;
+  friend class OutputFrameTap; // reads the format configuration to describe captures
+
   // DRIVER CONFIG AND STATE
   // for reading driver-related peripherals
   // storing this state allows us to configure on-the-fly when relevant functions get called.
@@ -172,8 +266,13 @@ private:
 
   // -- METHODS --
   void encode();               // encodes the active_signal arrays into the active_encoded_frames
+  void encode_driver();        // encodes the active_signal arrays as a native step/dir pulse train
+  void configure_signal_packing(); // calculates the signal capacity of the current format
   void transmit();             // transmits the active encoded frame
-  void clear_all_signals();    // clears all signals in the current active frame
+  void clear_all_signals();    // clears all pending steps
+  void transmit(uint32_t encoded_frame_step, uint32_t encoded_frame_dir); // transmits a raw encoded frame
+  void queue_frame();          // places the active encoded frame in the lookahead ring
+  void tap_frame(uint32_t encoded_frame_step, uint32_t encoded_frame_dir); // passes a transmitted frame to the frame tap, if attached
   void register_output_port(); // registers the output port
 
   // -- ADC --
@@ -181,6 +280,9 @@ private:
 };
 
 void transmit_frames_on_all_output_ports(); // transmits across all output ports
+void release_frames_on_all_output_ports(); // transmits the oldest lookahead frame on all output ports that use lookahead
+float32_t output_ports_get_max_transmit_skew_us(); // returns the longest delay between the first and last port starting a frame
+void output_ports_reset_transmit_skew(); // resets the transmit skew measurement
 
 void iterate_across_all_output_ports(void (*target_function)(OutputPort *)); // allows user code to iterate across all output ports
 
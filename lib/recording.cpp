@@ -264,4 +264,124 @@ void initialize_sd_card(){
     Serial1.println("initialization failed!");
     return;
   }
-}
\ No newline at end of file
+}
+
+// ---- OUTPUT FRAME TAP ----
+
+OutputFrameTap::OutputFrameTap(){};
+
+void OutputFrameTap::begin(OutputPort* target_output_port, Stream* target_stream){
+  this->target_output_port = target_output_port;
+  this->target_stream = target_stream;
+  target_output_port->attach_tap(this);
+  register_plugin(PLUGIN_LOOP);
+}
+
+void OutputFrameTap::start(){
+  // The frame interrupt reads tap_read_index to check for room, so the ring is reset with it held off.
+  noInterrupts();
+  tap_read_index = tap_write_index; // discard anything left over from a previous capture
+  frames_captured = 0;
+  frames_lost = 0;
+  frames_lost_reported = 0;
+  header_pending = true;
+  tap_active = true;
+  interrupts();
+}
+
+void OutputFrameTap::stop(){
+  tap_active = false;
+}
+
+bool OutputFrameTap::write_header(){
+  // A marker record, and then 16 bytes describing how to decode the records that follow
+  if(target_stream->availableForWrite() < static_cast<int>(sizeof(output_tap_record_struct) + OUTPUT_TAP_HEADER_SIZE)){
+    return false;
+  }
+  struct output_tap_record_struct marker = {OUTPUT_TAP_HEADER_MARKER, 0, 0};
+  uint8_t header[OUTPUT_TAP_HEADER_SIZE] = {'S', 'D', 'T', 'P', OUTPUT_TAP_VERSION,
+    target_output_port->port_number,
+    target_output_port->output_format,
+    target_output_port->RATE_SHIFT,
+    target_output_port->FRAME_LENGTH_US,
+    target_output_port->STEP_PULSE_START_TIME_US,
+    target_output_port->DIR_PULSE_START_TIME_US,
+    target_output_port->SIGNAL_MIN_WIDTH_US,
+    target_output_port->SIGNAL_GAP_US,
+    target_output_port->driver_setup_bits,
+    target_output_port->driver_pulse_high_bits,
+    0};
+  target_stream->write(reinterpret_cast<const uint8_t*>(&marker), sizeof(marker));
+  target_stream->write(header, sizeof(header));
+  header_pending = false;
+  records_since_header = 0;
+  return true;
+}
+
+void OutputFrameTap::record(uint32_t step, uint32_t dir){
+  // Runs in the frame interrupt. Empty frames aren't recorded; the frame index keeps the timeline intact.
+  if(!tap_active || step == 0){
+    return;
+  }
+  uint16_t next_write_index = (tap_write_index + 1) & (OUTPUT_TAP_RING_SIZE - 1);
+  if(next_write_index == tap_read_index){
+    frames_lost ++;
+    return;
+  }
+  tap_ring[tap_write_index].frame_index = stepdance_get_frame_count();
+  tap_ring[tap_write_index].step = step;
+  tap_ring[tap_write_index].dir = dir;
+  tap_write_index = next_write_index;
+  frames_captured ++;
+}
+
+void OutputFrameTap::loop(){
+  // Drains the ring to the stream in contiguous chunks, without blocking on a full stream.
+  if(frames_lost != frames_lost_reported){
+    if(target_stream->availableForWrite() < static_cast<int>(sizeof(output_tap_record_struct))){
+      return;
+    }
+    uint32_t lost = frames_lost;
+    struct output_tap_record_struct marker = {OUTPUT_TAP_OVERFLOW_MARKER, lost - frames_lost_reported, 0};
+    target_stream->write(reinterpret_cast<const uint8_t*>(&marker), sizeof(marker));
+    frames_lost_reported = lost;
+    header_pending = true; //a host that lost sync here can pick up again at the header
+  }
+  if(header_pending && tap_active && !write_header()){ //a new capture starts with a header, even before any steps
+    return;
+  }
+
+  uint16_t write_index = tap_write_index;
+  uint16_t read_index = tap_read_index;
+  while(read_index != write_index){
+    if(header_pending && !write_header()){
+      break;
+    }
+    uint16_t chunk_end = (write_index > read_index) ? write_index : OUTPUT_TAP_RING_SIZE;
+    uint16_t num_records = chunk_end - read_index;
+    uint16_t writable_records = target_stream->availableForWrite() / sizeof(output_tap_record_struct);
+    if(writable_records == 0){
+      break;
+    }
+    if(num_records > writable_records){
+      num_records = writable_records;
+    }
+    if(num_records > OUTPUT_TAP_HEADER_INTERVAL - records_since_header){
+      num_records = OUTPUT_TAP_HEADER_INTERVAL - records_since_header;
+    }
+    target_stream->write(const_cast<const uint8_t*>(reinterpret_cast<volatile uint8_t*>(&tap_ring[read_index])), num_records * sizeof(output_tap_record_struct));
+    read_index = (read_index + num_records) & (OUTPUT_TAP_RING_SIZE - 1);
+    tap_read_index = read_index;
+    records_since_header += num_records;
+    if(records_since_header >= OUTPUT_TAP_HEADER_INTERVAL){
+      header_pending = true;
+    }
+  }
+}
+
+void OutputFrameTap::enroll(RPC *rpc, const String& instance_name){
+  rpc->enroll(instance_name, "start", *this, &OutputFrameTap::start);
+  rpc->enroll(instance_name, "stop", *this, &OutputFrameTap::stop);
+  rpc->enroll(instance_name + ".frames_captured", frames_captured);
+  rpc->enroll(instance_name + ".frames_lost", frames_lost);
+}
@@ -12,6 +12,7 @@ A part of the Mixing Metaphors Project
 */
 
 #include "core.hpp"
+#include "output_ports.hpp"
 #include <SD.h>
 #include <string>
 
@@ -214,6 +215,93 @@ class FourTrackPlayer : public Plugin{
     void run();
 };
 
+#define OUTPUT_TAP_RING_SIZE 256 // number of frames buffered between the frame interrupt and the loop. Must be a power of 2.
+#define OUTPUT_TAP_VERSION 1 // version of the capture format, written in the header
+#define OUTPUT_TAP_OVERFLOW_MARKER 0xFFFFFFFF // frame index of a record that reports lost frames
+#define OUTPUT_TAP_HEADER_MARKER 0xFFFFFFFE // frame index of a record that is followed by a header
+#define OUTPUT_TAP_HEADER_SIZE 16
+#define OUTPUT_TAP_HEADER_INTERVAL 1024 // records between repeated headers, so a host can attach to a capture that's under way
+
+/** \cond */
+struct output_tap_record_struct{
+  uint32_t frame_index; // stepdance_get_frame_count() when the frame was transmitted
+  uint32_t step; // encoded step word, as written to the shift buffer
+  uint32_t dir; // encoded dir word
+};
+/** \endcond */
+
+/**
+ * @brief OutputFrameTap captures the exact frames transmitted by an OutputPort and streams them to a host.
+ * @ingroup recording
+ * @details The tap records the encoded step and direction words of every non-empty frame, along with the frame index,
+ * into a RAM ring from within the frame interrupt. The ring is drained in bulk from the main loop to a Stream, typically a
+ * second USB serial port. The host-side decoder in rpc/frame_tap.py turns a capture back into per-signal step and direction
+ * timelines, validates pulse widths against the output format, and can diff two captures to regression-test a sketch.
+ *
+ * The stream is made of 12-byte little-endian records (frame index, step word, dir word). A record with a frame index of
+ * 0xFFFFFFFE is followed by a 16-byte header describing the port's format. A header is sent when a capture starts, after
+ * every 1024 records, and after frames are lost, so a host that attaches mid-stream can find one and decode from there.
+ * If the ring overflows, a record with a frame index of 0xFFFFFFFF is sent whose step word holds the number of frames
+ * that were lost.
+ * Here's an example of how to tap an output port:
+ * \code{.cpp}
+ * OutputFrameTap tap_a;
+ * 
+ * void setup() {
+ *   output_a.begin(OUTPUT_A);
+ *   SerialUSB1.begin(115200);
+ *   tap_a.begin(&output_a, &SerialUSB1);
+ *   tap_a.start();
+ *   dance_start();
+ * }
+ * \endcode
+ */
+class OutputFrameTap : public Plugin{
+  public:
+    OutputFrameTap();
+    /**
+     * @brief Initializes the tap and attaches it to an output port.
+     * @param target_output_port Pointer to the OutputPort to capture.
+     * @param target_stream Pointer to the Stream that captures are written to.
+     */
+    void begin(OutputPort* target_output_port, Stream* target_stream);
+    /**
+     * @brief Starts a new capture. Writes the header and then streams frames as they are transmitted.
+     */
+    void start();
+    /**
+     * @brief Stops capturing. Frames already in the ring are still written out.
+     */
+    void stop();
+    /**
+     * @brief Number of frames captured since start() was called.
+     */
+    volatile uint32_t frames_captured = 0;
+    /**
+     * @brief Number of frames lost because the ring was full.
+     */
+    volatile uint32_t frames_lost = 0;
+    /** \cond */
+    void record(uint32_t step, uint32_t dir); // called by the output port on every transmitted frame
+    void enroll(RPC *rpc, const String& instance_name);
+    /** \endcond */
+
+  private:
+    OutputPort* target_output_port = nullptr;
+    Stream* target_stream = nullptr;
+    volatile bool tap_active = false;
+    volatile struct output_tap_record_struct tap_ring[OUTPUT_TAP_RING_SIZE];
+    volatile uint16_t tap_write_index = 0; // written by the frame interrupt
+    volatile uint16_t tap_read_index = 0; // written by the loop
+    uint32_t frames_lost_reported = 0; // value of frames_lost when the last overflow marker was sent
+    bool header_pending = false; // a header goes out before the next record
+    uint16_t records_since_header = 0;
+    bool write_header(); // returns false if the stream doesn't have room for it yet
+
+  protected:
+    void loop();
+};
+
 // --- SD CARD UTILITIES ---
 void initialize_sd_card();
 
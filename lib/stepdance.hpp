@@ -10,6 +10,7 @@
 #include "interfaces.hpp"
 #include "interpolators.hpp"
 #include "kinematics.hpp"
+#include "multiplexer.hpp"
 #include "output_ports.hpp"
 #include "recording.hpp"
 #include "rpc.hpp"
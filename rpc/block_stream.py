@@ -0,0 +1,322 @@
+# Block Stream Host
+# Stepdance
+# A creative motion control platform
+#
+# (C) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost, Emilie Yu
+#
+# Encodes motion blocks into frames for a BlockStreamInterface, and streams them with credit-based flow control.
+#
+# Usage:
+#   python block_stream.py selftest                   -- streams through a simulated device that corrupts and drops frames
+#   python block_stream.py benchmark PORT NUM_BLOCKS  -- streams small incremental moves to a device and reports blocks/s
+
+import random
+import struct
+import sys
+import time
+
+SYNC = 0x7E
+HEADER_LENGTH = 4
+CRC_LENGTH = 2
+MAX_PAYLOAD_LENGTH = 255
+NUM_AXES = 6
+
+FRAME_BLOCKS = 0x01
+FRAME_RESET = 0x02
+FRAME_STATUS = 0x81
+FRAME_NAK = 0x82
+
+NAK_CRC = 1
+NAK_SEQUENCE = 2
+NAK_NO_CREDIT = 3
+NAK_FORMAT = 4
+
+INCREMENTAL = 0
+ABSOLUTE = 1
+GLOBAL = 2
+BLOCK_VELOCITY = 0x80
+
+RESEND_TIMEOUT_S = 0.25
+
+
+def crc16(data, crc=0xFFFF):
+    '''CRC16-CCITT, matching BlockStreamInterface::crc16().'''
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def encode_block(mode, time_or_velocity, axis_values):
+    '''Encodes one block. axis_values is a dictionary of axis index -> value; axes that are left out don't move.
+
+    Use mode | BLOCK_VELOCITY to give a velocity instead of a duration. Absolute and global blocks must include every axis.
+    '''
+    axis_mask = 0
+    values = []
+    for axis_index in sorted(axis_values):
+        axis_mask |= 1 << axis_index
+        values.append(axis_values[axis_index])
+    return struct.pack('<BBf' + 'f' * len(values), mode, axis_mask, time_or_velocity, *values)
+
+
+def encode_frame(frame_type, sequence, payload):
+    body = struct.pack('<BBB', frame_type, sequence & 0xFF, len(payload)) + payload
+    return bytes([SYNC]) + body + struct.pack('<H', crc16(body))
+
+
+class decoder(object):
+    '''Splits a byte stream into (frame_type, sequence, payload) tuples, dropping anything that fails the CRC.'''
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+        while True:
+            sync_index = self.buffer.find(bytes([SYNC]))
+            if sync_index < 0:
+                self.buffer.clear()
+                return frames
+            del self.buffer[:sync_index]
+            if len(self.buffer) < HEADER_LENGTH:
+                return frames
+            frame_length = HEADER_LENGTH + self.buffer[3] + CRC_LENGTH
+            if len(self.buffer) < frame_length:
+                return frames
+            frame = bytes(self.buffer[:frame_length])
+            if crc16(frame[1:-CRC_LENGTH]) == struct.unpack('<H', frame[-CRC_LENGTH:])[0]:
+                frames.append((frame[1], frame[2], frame[HEADER_LENGTH:-CRC_LENGTH]))
+                del self.buffer[:frame_length]
+            else:
+                self.crc_errors += 1
+                del self.buffer[:1]
+
+
+class streamer(object):
+    '''Streams encoded blocks to a device over a connection with write(data) and read() -> bytes.
+
+    Blocks are packed into frames as they're sent. The device's STATUS frames report the next sequence it expects along
+    with its free slots, so the credit available is those slots less the blocks in frames sent since. Frames are kept
+    until acknowledged, and a NAK or a quiet link sends everything again from the sequence the device expects.
+    '''
+    def __init__(self, connection, blocks_per_frame=16):
+        self.connection = connection
+        self.blocks_per_frame = blocks_per_frame
+        self.decoder = decoder()
+        self.sequence = 0
+        self.unacknowledged = []  # (sequence, num_blocks, frame) in send order
+        self.reported_sequence = 0
+        self.reported_slots = 0
+        self.last_progress_time = time.time()
+        self.frames_sent = 0
+        self.frames_resent = 0
+        self.naks = 0
+
+    def reset(self):
+        self.unacknowledged = []
+        self.connection.write(encode_frame(FRAME_RESET, self.sequence, b''))
+        self.sequence = (self.sequence + 1) & 0xFF
+        while not self.poll():
+            pass
+
+    def credit(self):
+        in_flight = sum(num_blocks for sequence, num_blocks, _ in self.unacknowledged
+                        if ((sequence - self.reported_sequence) & 0xFF) < 128)
+        return self.reported_slots - in_flight
+
+    def poll(self):
+        '''Handles anything the device has sent. Returns True if a frame was received.'''
+        received = False
+        for frame_type, sequence, payload in self.decoder.feed(self.connection.read()):
+            received = True
+            if frame_type == FRAME_STATUS:
+                self.acknowledge(sequence, struct.unpack_from('<H', payload)[0])
+            elif frame_type == FRAME_NAK:
+                self.naks += 1
+                self.acknowledge(sequence, struct.unpack_from('<H', payload, 1)[0])
+                self.resend()
+        if self.unacknowledged and time.time() - self.last_progress_time > RESEND_TIMEOUT_S:
+            self.resend()
+        return received
+
+    def acknowledge(self, next_sequence, slots):
+        self.reported_sequence = next_sequence
+        self.reported_slots = slots
+        num_unacknowledged = len(self.unacknowledged)
+        self.unacknowledged = [entry for entry in self.unacknowledged if ((entry[0] - next_sequence) & 0xFF) < 128]
+        if len(self.unacknowledged) < num_unacknowledged:
+            self.last_progress_time = time.time()
+
+    def resend(self):
+        self.last_progress_time = time.time()
+        for _, _, frame in self.unacknowledged:
+            self.connection.write(frame)
+            self.frames_resent += 1
+
+    def send(self, blocks):
+        '''Streams a list of encoded blocks, waiting on credit as needed, and returns once the device has them all.'''
+        block_index = 0
+        while block_index < len(blocks) or self.unacknowledged:
+            self.poll()
+            num_blocks = min(self.blocks_per_frame, self.credit(), len(blocks) - block_index)
+            if num_blocks <= 0:
+                continue
+            payload = b''
+            num_packed = 0
+            while num_packed < num_blocks and len(payload) + len(blocks[block_index]) <= MAX_PAYLOAD_LENGTH:
+                payload += blocks[block_index]
+                block_index += 1
+                num_packed += 1
+            frame = encode_frame(FRAME_BLOCKS, self.sequence, payload)
+            if not self.unacknowledged:
+                self.last_progress_time = time.time()
+            self.unacknowledged.append((self.sequence, num_packed, frame))
+            self.sequence = (self.sequence + 1) & 0xFF
+            self.connection.write(frame)
+            self.frames_sent += 1
+
+
+def payload_block_count(payload):
+    num_blocks = 0
+    index = 0
+    while index < len(payload):
+        index += 6 + 4 * bin(payload[index + 1]).count('1')
+        num_blocks += 1
+    return num_blocks
+
+
+class simulated_device(object):
+    '''Behaves like a BlockStreamInterface whose queue drains a few blocks per read, over a link that garbles frames.'''
+    def __init__(self, queue_depth=100, drain_per_read=8, corruption_rate=0.02):
+        self.queue_depth = queue_depth
+        self.drain_per_read = drain_per_read
+        self.corruption_rate = corruption_rate
+        self.queued = 0
+        self.expected_sequence = 0
+        self.resend_requested = False
+        self.positions = [0.0] * NUM_AXES
+        self.outbox = b''
+        self.decoder = decoder()
+
+    def write(self, data):
+        if random.random() < self.corruption_rate:
+            data = bytearray(data)
+            data[random.randrange(len(data))] ^= 0xFF
+        frames = self.decoder.feed(data)
+        if self.decoder.crc_errors:
+            self.decoder.crc_errors = 0
+            if not self.resend_requested:
+                self.send(FRAME_NAK, struct.pack('<BH', NAK_CRC, self.slots()))
+                self.resend_requested = True
+        for frame_type, sequence, payload in frames:
+            if frame_type == FRAME_RESET:
+                self.expected_sequence = (sequence + 1) & 0xFF
+                self.resend_requested = False
+                self.send(FRAME_STATUS, struct.pack('<HH', self.slots(), self.queue_depth))
+            elif sequence != self.expected_sequence:
+                if not self.resend_requested:
+                    self.send(FRAME_NAK, struct.pack('<BH', NAK_SEQUENCE, self.slots()))
+                    self.resend_requested = True
+            else:
+                self.resend_requested = False
+                num_blocks = payload_block_count(payload)
+                if num_blocks > self.slots():
+                    self.send(FRAME_NAK, struct.pack('<BH', NAK_NO_CREDIT, self.slots()))
+                    self.resend_requested = True
+                    continue
+                self.apply(payload)
+                self.queued += num_blocks
+                self.expected_sequence = (self.expected_sequence + 1) & 0xFF
+                self.send(FRAME_STATUS, struct.pack('<HH', self.slots(), self.queue_depth))
+
+    def read(self):
+        if self.queued:
+            self.queued = max(0, self.queued - self.drain_per_read)
+            self.send(FRAME_STATUS, struct.pack('<HH', self.slots(), self.queue_depth))
+        outbox, self.outbox = self.outbox, b''
+        return outbox
+
+    def slots(self):
+        return self.queue_depth - self.queued
+
+    def send(self, frame_type, payload):
+        self.outbox += encode_frame(frame_type, self.expected_sequence, payload)
+
+    def apply(self, payload):
+        index = 0
+        while index < len(payload):
+            mode, axis_mask = payload[index], payload[index + 1]
+            index += 6
+            for axis_index in range(NUM_AXES):
+                if axis_mask & (1 << axis_index):
+                    value = struct.unpack_from('<f', payload, index)[0]
+                    index += 4
+                    if mode & ~BLOCK_VELOCITY == INCREMENTAL:
+                        self.positions[axis_index] += value
+                    else:
+                        self.positions[axis_index] = value
+
+
+def spiral_blocks(num_blocks):
+    '''Small incremental XY moves around a spiral, like dense CAM output.'''
+    import math
+    blocks = []
+    for block_index in range(num_blocks):
+        angle = block_index * 0.05
+        blocks.append(encode_block(INCREMENTAL, 0.0005, {0: 0.01 * math.cos(angle), 1: 0.01 * math.sin(angle)}))
+    return blocks
+
+
+def selftest(num_blocks=20000):
+    random.seed(1)
+    device = simulated_device()
+    blocks = spiral_blocks(num_blocks)
+    expected = [0.0] * NUM_AXES
+    for block in blocks:
+        expected[0] += struct.unpack_from('<f', block, 6)[0]
+        expected[1] += struct.unpack_from('<f', block, 10)[0]
+    stream = streamer(device)
+    stream.reset()
+    start_time = time.time()
+    stream.send(blocks)
+    elapsed_s = time.time() - start_time
+    error = max(abs(a - b) for a, b in zip(device.positions, expected))
+    print('{} blocks in {} frames, {} resent after {} NAKs, {:.0f} blocks/s, final position error {:.2e}'.format(
+        num_blocks, stream.frames_sent, stream.frames_resent, stream.naks, num_blocks / elapsed_s, error))
+    return error < 1e-6
+
+
+class serial_connection(object):
+    def __init__(self, port_name):
+        import serial
+        self.serial_port = serial.Serial(port_name, 4000000, timeout=0)
+
+    def write(self, data):
+        self.serial_port.write(data)
+
+    def read(self):
+        return self.serial_port.read(4096)
+
+
+def benchmark(port_name, num_blocks):
+    stream = streamer(serial_connection(port_name))
+    stream.reset()
+    start_time = time.time()
+    stream.send(spiral_blocks(num_blocks))
+    elapsed_s = time.time() - start_time
+    print('{} blocks in {:.2f}s, {:.0f} blocks/s, {} frames resent'.format(
+        num_blocks, elapsed_s, num_blocks / elapsed_s, stream.frames_resent))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 2 and sys.argv[1] == 'selftest':
+        sys.exit(0 if selftest() else 1)
+    elif len(sys.argv) == 4 and sys.argv[1] == 'benchmark':
+        benchmark(sys.argv[2], int(sys.argv[3]))
+    else:
+        print('usage: block_stream.py selftest | benchmark PORT NUM_BLOCKS')
+        sys.exit(2)
@@ -0,0 +1,233 @@
+# Output Frame Tap Decoder
+# Stepdance
+# A creative motion control platform
+#
+# (C) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost, Emilie Yu
+#
+# Decodes captures streamed by an OutputFrameTap back into per-signal step and direction timelines.
+#
+# Usage:
+#   python frame_tap.py capture PORT FILE SECONDS   -- records a capture from a serial port into a file
+#   python frame_tap.py decode FILE                 -- validates a capture and prints a per-signal summary
+#   python frame_tap.py diff FILE_A FILE_B          -- compares the step streams of two captures
+
+import struct
+import sys
+import time
+
+HEADER_FORMAT = '<4sBBBBBBBBBBBB'
+HEADER_LENGTH = 16
+RECORD_FORMAT = '<III'
+RECORD_LENGTH = 12
+OVERFLOW_MARKER = 0xFFFFFFFF
+HEADER_MARKER = 0xFFFFFFFE
+FRAME_BITS = 32
+
+OUTPUT_FORMAT_STEPDANCE = 0
+OUTPUT_FORMAT_DRIVER = 1
+
+SIGNAL_NAMES = ['X', 'Y', 'R', 'T', 'Z', 'E']
+DRIVER_SIGNAL_NAME = 'STEP'
+
+
+class capture(object):
+    '''A decoded capture from an OutputFrameTap.
+
+    After construction, steps holds a list of (frame_index, signal_name, direction) tuples in transmission order,
+    where direction is +1 or -1. errors holds a list of (frame_index, message) tuples for any frame that broke the
+    output format rules, and frames_lost counts frames that the tap couldn't buffer.
+    '''
+    def __init__(self, data):
+        self.steps = []
+        self.errors = []
+        self.frames_lost = 0
+        self.num_frames = 0
+        offset = self.find_header(data)
+        while offset + RECORD_LENGTH <= len(data):
+            frame_index, step, direction = struct.unpack_from(RECORD_FORMAT, data, offset)
+            offset += RECORD_LENGTH
+            if frame_index == HEADER_MARKER:  # repeated so that a capture can start mid-stream; the format doesn't change
+                offset += HEADER_LENGTH
+                continue
+            if frame_index == OVERFLOW_MARKER:
+                self.frames_lost += step
+                continue
+            self.num_frames += 1
+            if self.output_format == OUTPUT_FORMAT_DRIVER:
+                self.decode_driver_frame(frame_index, step, direction)
+            else:
+                self.decode_stepdance_frame(frame_index, step, direction)
+
+    def find_header(self, data):
+        '''Parses the first header in the capture, skipping anything before it, and returns the offset of the first record after it.
+
+        Headers follow a marker record. Captures from before headers were repeated start with a bare header instead.
+        '''
+        if data[:4] == b'SDTP':
+            self.parse_header(data[:HEADER_LENGTH])
+            return HEADER_LENGTH
+        marker = struct.pack('<I', HEADER_MARKER)
+        search_offset = 0
+        while True:
+            marker_offset = data.find(marker, search_offset)
+            if marker_offset < 0:
+                raise ValueError('capture does not contain an output tap header')
+            header_offset = marker_offset + RECORD_LENGTH
+            if data[header_offset:header_offset + 4] == b'SDTP':
+                self.parse_header(data[header_offset:header_offset + HEADER_LENGTH])
+                return header_offset + HEADER_LENGTH
+            search_offset = marker_offset + 1
+
+    @classmethod
+    def from_file(cls, filename):
+        with open(filename, 'rb') as capture_file:
+            return cls(capture_file.read())
+
+    def parse_header(self, header):
+        if len(header) < HEADER_LENGTH:
+            raise ValueError('capture is too short to contain a header')
+        fields = struct.unpack(HEADER_FORMAT, header)
+        if fields[0] != b'SDTP':
+            raise ValueError('capture does not start with an output tap header')
+        (self.version, self.port_number, self.output_format, self.rate_shift, self.frame_length_us,
+         self.step_start_us, self.dir_start_us, self.min_width_us, self.gap_us,
+         self.driver_setup_bits, self.driver_pulse_high_bits, _) = fields[1:]
+        self.bits_per_us = 1 << self.rate_shift
+
+    def decode_stepdance_frame(self, frame_index, step, direction):
+        '''Walks the pulse-length encoded frame in the same order that OutputPort::encode() builds it.'''
+        pulses = find_pulses(step)
+        step_position_us = self.step_start_us
+        dir_position_us = self.dir_start_us
+        seen_signals = set()
+        for start_bit, width_bits in pulses:
+            if (start_bit % self.bits_per_us) or (width_bits % self.bits_per_us):
+                self.errors.append((frame_index, 'step pulse at bit {} is not aligned to whole microseconds'.format(start_bit)))
+                return
+            start_us = start_bit // self.bits_per_us
+            width_us = width_bits // self.bits_per_us
+            if start_us != step_position_us:
+                self.errors.append((frame_index, 'step pulse starts at {}us, expected {}us'.format(start_us, step_position_us)))
+                return
+            signal_index = width_us - self.min_width_us
+            if signal_index < 0 or signal_index >= len(SIGNAL_NAMES):
+                self.errors.append((frame_index, 'step pulse width of {}us does not match any signal'.format(width_us)))
+                return
+            if signal_index in seen_signals:
+                self.errors.append((frame_index, 'signal {} appears twice'.format(SIGNAL_NAMES[signal_index])))
+                return
+            if start_us + width_us > self.frame_length_us - 1:
+                self.errors.append((frame_index, 'step pulse for {} overruns the frame'.format(SIGNAL_NAMES[signal_index])))
+                return
+            seen_signals.add(signal_index)
+
+            dir_width_bits = (width_us + self.gap_us) * self.bits_per_us
+            dir_window = (direction >> (dir_position_us * self.bits_per_us)) & ((1 << dir_width_bits) - 1)
+            if dir_window == (1 << dir_width_bits) - 1:
+                step_direction = 1
+            elif dir_window == 0:
+                step_direction = -1
+            else:
+                self.errors.append((frame_index, 'dir pulse for {} is not a whole pulse'.format(SIGNAL_NAMES[signal_index])))
+                return
+            self.steps.append((frame_index, SIGNAL_NAMES[signal_index], step_direction))
+
+            step_position_us += width_us + self.gap_us
+            dir_position_us += width_us + self.gap_us
+
+    def decode_driver_frame(self, frame_index, step, direction):
+        '''Each pulse in a driver frame is one step, and DIR is a constant level across the frame.'''
+        if direction == 0xFFFFFFFF:
+            step_direction = 1
+        elif direction == 0:
+            step_direction = -1
+        else:
+            self.errors.append((frame_index, 'DIR changes within the frame'))
+            return
+        for start_bit, width_bits in find_pulses(step):
+            if start_bit < self.driver_setup_bits:
+                self.errors.append((frame_index, 'step edge at bit {} violates the setup time'.format(start_bit)))
+            if width_bits < self.driver_pulse_high_bits:
+                self.errors.append((frame_index, 'step pulse at bit {} is too short'.format(start_bit)))
+            if start_bit + width_bits >= FRAME_BITS:
+                self.errors.append((frame_index, 'step pulse at bit {} runs to the end of the frame'.format(start_bit)))
+            self.steps.append((frame_index, DRIVER_SIGNAL_NAME, step_direction))
+
+    def timelines(self):
+        '''Returns a dictionary of signal name -> list of (frame offset, direction), relative to the first captured step.'''
+        timelines = {}
+        if not self.steps:
+            return timelines
+        first_frame_index = self.steps[0][0]
+        for frame_index, signal_name, step_direction in self.steps:
+            timelines.setdefault(signal_name, []).append(((frame_index - first_frame_index) & 0xFFFFFFFF, step_direction))
+        return timelines
+
+    def summary(self):
+        lines = ['port {}, {} format, {} frames, {} lost, {} errors'.format(
+            self.port_number, 'driver' if self.output_format == OUTPUT_FORMAT_DRIVER else 'stepdance',
+            self.num_frames, self.frames_lost, len(self.errors))]
+        for signal_name, timeline in sorted(self.timelines().items()):
+            net_steps = sum(step_direction for _, step_direction in timeline)
+            lines.append('  {}: {} steps, net {:+d}'.format(signal_name, len(timeline), net_steps))
+        for frame_index, message in self.errors[:20]:
+            lines.append('  frame {}: {}'.format(frame_index, message))
+        return '\n'.join(lines)
+
+
+def find_pulses(word):
+    '''Returns a list of (start bit, width in bits) for each run of ones in a 32-bit word, LSB first.'''
+    pulses = []
+    bit = 0
+    while bit < FRAME_BITS:
+        if (word >> bit) & 1:
+            start_bit = bit
+            while bit < FRAME_BITS and (word >> bit) & 1:
+                bit += 1
+            pulses.append((start_bit, bit - start_bit))
+        else:
+            bit += 1
+    return pulses
+
+
+def diff(capture_a, capture_b):
+    '''Compares the step timelines of two captures. Returns a list of differences, which is empty if they match.'''
+    differences = []
+    timelines_a = capture_a.timelines()
+    timelines_b = capture_b.timelines()
+    for signal_name in sorted(set(timelines_a) | set(timelines_b)):
+        timeline_a = timelines_a.get(signal_name, [])
+        timeline_b = timelines_b.get(signal_name, [])
+        for step_index, (step_a, step_b) in enumerate(zip(timeline_a, timeline_b)):
+            if step_a != step_b:
+                differences.append('{}: step {} differs, frame {:+d} dir {:+d} vs frame {:+d} dir {:+d}'.format(
+                    signal_name, step_index, step_a[0], step_a[1], step_b[0], step_b[1]))
+                break
+        if len(timeline_a) != len(timeline_b):
+            differences.append('{}: {} steps vs {} steps'.format(signal_name, len(timeline_a), len(timeline_b)))
+    return differences
+
+
+def record(port_name, filename, seconds):
+    '''Records the raw stream from a serial port into a file. Start the tap (e.g. over RPC) before or during the capture.'''
+    import serial
+    serial_port = serial.Serial(port_name, 4000000, timeout=0.1)
+    end_time = time.time() + seconds
+    with open(filename, 'wb') as capture_file:
+        while time.time() < end_time:
+            capture_file.write(serial_port.read(4096))
+    serial_port.close()
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 5 and sys.argv[1] == 'capture':
+        record(sys.argv[2], sys.argv[3], float(sys.argv[4]))
+    elif len(sys.argv) == 3 and sys.argv[1] == 'decode':
+        print(capture.from_file(sys.argv[2]).summary())
+    elif len(sys.argv) == 4 and sys.argv[1] == 'diff':
+        differences = diff(capture.from_file(sys.argv[2]), capture.from_file(sys.argv[3]))
+        print('\n'.join(differences) if differences else 'captures match')
+        sys.exit(1 if differences else 0)
+    else:
+        print(__doc__ if __doc__ else 'usage: frame_tap.py capture PORT FILE SECONDS | decode FILE | diff FILE_A FILE_B')
+        sys.exit(2)
@@ -0,0 +1,223 @@
+# Stream Multiplexer Host
+# Stepdance
+# A creative motion control platform
+#
+# (C) 2025 Ilan Moyer, Jennifer Jacobs, Devon Frost, Emilie Yu
+#
+# Carries several streams over one serial link to a StreamMultiplexer, e.g. RPC on channel 0 and G-code on channel 1.
+#
+# Usage:
+#   python stream_mux.py selftest                   -- streams bulk and control traffic through a simulated device
+#   python stream_mux.py send PORT CHANNEL FILE     -- sends a file line by line on a channel, printing replies
+
+import sys
+import struct
+import time
+
+SYNC = 0xA5
+HEADER_LENGTH = 3
+MAX_PAYLOAD_LENGTH = 255
+
+CONTROL_CHANNEL = 0x7F
+CONTROL_RESET = 0x01
+CONTROL_READY = 0x02
+CONTROL_CREDIT = 0x03
+
+
+def encode_frame(channel_index, payload):
+    return bytes([SYNC, channel_index, len(payload)]) + payload
+
+
+class decoder(object):
+    '''Splits a byte stream into (channel, payload) tuples.'''
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+        while True:
+            sync_index = self.buffer.find(bytes([SYNC]))
+            if sync_index < 0:
+                self.buffer.clear()
+                return frames
+            del self.buffer[:sync_index]
+            if len(self.buffer) < HEADER_LENGTH:
+                return frames
+            frame_length = HEADER_LENGTH + self.buffer[2]
+            if len(self.buffer) < frame_length:
+                return frames
+            frames.append((self.buffer[1], bytes(self.buffer[HEADER_LENGTH:frame_length])))
+            del self.buffer[:frame_length]
+
+
+class channel(object):
+    '''One stream of a multiplexer. Has the write/read/readline of a serial port, so it can stand in for one.'''
+    def __init__(self, multiplexer, channel_index):
+        self.multiplexer = multiplexer
+        self.channel_index = channel_index
+        self.received = bytearray()
+        self.bytes_sent = 0
+        self.bytes_read_by_device = 0
+
+    def credit(self):
+        return self.multiplexer.buffer_size - (self.bytes_sent - self.bytes_read_by_device)
+
+    def write(self, data):
+        '''Sends data, waiting on the device to read from this channel whenever its buffer is full.'''
+        data = bytes(data)
+        while data:
+            self.multiplexer.poll()
+            frame_length = min(len(data), self.credit(), MAX_PAYLOAD_LENGTH)
+            if frame_length <= 0:
+                continue
+            self.multiplexer.connection.write(encode_frame(self.channel_index, data[:frame_length]))
+            self.bytes_sent += frame_length
+            data = data[frame_length:]
+
+    def read(self, size=None):
+        self.multiplexer.poll()
+        size = len(self.received) if size is None else min(size, len(self.received))
+        data = bytes(self.received[:size])
+        del self.received[:size]
+        return data
+
+    def readline(self, timeout_s=1.0):
+        start_time = time.time()
+        while b'\n' not in self.received and time.time() - start_time < timeout_s:
+            self.multiplexer.poll()
+        line_length = self.received.find(b'\n') + 1
+        if line_length == 0:
+            return b''
+        return self.read(line_length)
+
+
+class multiplexer(object):
+    '''Talks to a StreamMultiplexer over a connection with write(data) and read() -> bytes.'''
+    def __init__(self, connection):
+        self.connection = connection
+        self.decoder = decoder()
+        self.buffer_size = 0
+        self.channels = []
+
+    def reset(self, timeout_s=1.0):
+        '''Clears every channel on the device, and waits for it to report its channels and buffer size.'''
+        self.buffer_size = 0
+        self.connection.write(encode_frame(CONTROL_CHANNEL, bytes([CONTROL_RESET])))
+        start_time = time.time()
+        while not self.buffer_size:
+            if time.time() - start_time > timeout_s:
+                raise IOError('no reply from the stream multiplexer')
+            self.poll()
+
+    def channel(self, channel_index):
+        return self.channels[channel_index]
+
+    def poll(self):
+        for channel_index, payload in self.decoder.feed(self.connection.read()):
+            if channel_index == CONTROL_CHANNEL:
+                if payload[0] == CONTROL_READY:
+                    num_channels, self.buffer_size = struct.unpack_from('<BH', payload, 1)
+                    self.channels = [channel(self, index) for index in range(num_channels)]
+                elif payload[0] == CONTROL_CREDIT:
+                    credit_channel, bytes_read = struct.unpack_from('<BI', payload, 1)
+                    self.channels[credit_channel].bytes_read_by_device = bytes_read
+            elif channel_index < len(self.channels):
+                self.channels[channel_index].received.extend(payload)
+
+
+class simulated_device(object):
+    '''Behaves like a StreamMultiplexer on a Stepdance board, with each channel read slowly and echoed back.'''
+    def __init__(self, num_channels=4, buffer_size=1024, read_per_poll=32):
+        self.num_channels = num_channels
+        self.buffer_size = buffer_size
+        self.read_per_poll = read_per_poll
+        self.decoder = decoder()
+        self.outbox = b''
+        self.reset()
+
+    def reset(self):
+        self.buffers = [bytearray() for _ in range(self.num_channels)]
+        self.bytes_read = [0] * self.num_channels
+        self.reported_bytes_read = [0] * self.num_channels
+        self.overruns = 0
+
+    def write(self, data):
+        for channel_index, payload in self.decoder.feed(data):
+            if channel_index == CONTROL_CHANNEL and payload[0] == CONTROL_RESET:
+                self.reset()
+                self.outbox += encode_frame(CONTROL_CHANNEL, struct.pack('<BBH', CONTROL_READY, self.num_channels, self.buffer_size))
+            elif channel_index < self.num_channels:
+                room = self.buffer_size - len(self.buffers[channel_index])
+                self.overruns += max(0, len(payload) - room)
+                self.buffers[channel_index].extend(payload[:room])
+
+    def read(self):
+        for channel_index in range(self.num_channels):
+            data = bytes(self.buffers[channel_index][:self.read_per_poll])
+            del self.buffers[channel_index][:len(data)]
+            self.bytes_read[channel_index] += len(data)
+            if data:
+                self.outbox += encode_frame(channel_index, data)
+            unreported = self.bytes_read[channel_index] - self.reported_bytes_read[channel_index]
+            if unreported >= self.buffer_size // 4 or (unreported and not self.buffers[channel_index]):
+                self.outbox += encode_frame(CONTROL_CHANNEL, struct.pack('<BBI', CONTROL_CREDIT, channel_index, self.bytes_read[channel_index]))
+                self.reported_bytes_read[channel_index] = self.bytes_read[channel_index]
+        outbox, self.outbox = self.outbox, b''
+        return outbox
+
+
+def selftest():
+    '''Fills the bulk channel well past its buffer, checking that control messages still get through and nothing overruns.'''
+    device = simulated_device()
+    link = multiplexer(device)
+    link.reset()
+    control = link.channel(0)
+    bulk = link.channel(1)
+    bulk_data = b''.join('G1 X{:.3f} Y{:.3f}\n'.format(index * 0.01, index * 0.02).encode() for index in range(2000))
+    control_replies = 0
+    for chunk_index in range(0, len(bulk_data), 512):
+        bulk.write(bulk_data[chunk_index:chunk_index + 512])
+        control.write(b'{"name":"ping"}\n')
+        if control.readline():
+            control_replies += 1
+    while len(bulk.received) < len(bulk_data):
+        link.poll()
+    passed = bytes(bulk.received) == bulk_data and device.overruns == 0 and control_replies > 0
+    print('{} bulk bytes echoed intact: {}, {} control replies, {} overruns'.format(
+        len(bulk_data), bytes(bulk.received) == bulk_data, control_replies, device.overruns))
+    return passed
+
+
+class serial_connection(object):
+    def __init__(self, port_name):
+        import serial
+        self.serial_port = serial.Serial(port_name, 4000000, timeout=0)
+
+    def write(self, data):
+        self.serial_port.write(data)
+
+    def read(self):
+        return self.serial_port.read(4096)
+
+
+def send(port_name, channel_index, file_name):
+    link = multiplexer(serial_connection(port_name))
+    link.reset()
+    target_channel = link.channel(channel_index)
+    with open(file_name, 'rb') as input_file:
+        for line in input_file:
+            target_channel.write(line)
+            reply = target_channel.readline()
+            if reply:
+                print(reply.decode(errors='replace').rstrip())
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 2 and sys.argv[1] == 'selftest':
+        sys.exit(0 if selftest() else 1)
+    elif len(sys.argv) == 5 and sys.argv[1] == 'send':
+        send(sys.argv[2], int(sys.argv[3]), sys.argv[4])
+    else:
+        print('usage: stream_mux.py selftest | send PORT CHANNEL FILE')
+        sys.exit(2)